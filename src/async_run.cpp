@@ -0,0 +1,73 @@
+//
+// Created by antares on 5/6/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "async_run.h"
+#include "cpu_topology.h"
+#include <algorithm>
+
+namespace OnnxBenchmarks {
+    CompletionExecutor::CompletionExecutor(size_t threadCount) {
+        threads.reserve(threadCount);
+        for (size_t i = 0; i < std::max<size_t>(threadCount, 1); ++i) {
+            threads.emplace_back(&CompletionExecutor::_worker_loop, this, i);
+        }
+    }
+
+    CompletionExecutor::~CompletionExecutor() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        for (auto &thread: threads) {
+            thread.join();
+        }
+    }
+
+    void CompletionExecutor::Post(std::function<void()> task) {
+        {
+            std::lock_guard lock(mutex);
+            queue.emplace_back(std::move(task));
+        }
+        condition.notify_one();
+    }
+
+    void CompletionExecutor::_worker_loop(size_t index) {
+        GetThreadPlacement().PinCurrentThread(index);
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(mutex);
+                condition.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (queue.empty()) {
+                    return;
+                }
+                task = std::move(queue.front());
+                queue.pop_front();
+            }
+            task();
+        }
+    }
+}
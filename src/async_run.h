@@ -0,0 +1,113 @@
+//
+// Created by antares on 5/6/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_ASYNC_RUN_H
+#define TESTPROJECT_ASYNC_RUN_H
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "model_wrapper.h"
+
+namespace OnnxBenchmarks {
+    /// A few threads that run posted tasks in order, e.g. coroutines resumed after their run completed
+    class CompletionExecutor {
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<std::function<void()>> queue;
+        bool stopping = false;
+        std::vector<std::thread> threads;
+
+        void _worker_loop(size_t index);
+
+    public:
+        /// Thread `i` is pinned to slot `i` of the placement
+        explicit CompletionExecutor(size_t threadCount);
+
+        CompletionExecutor(const CompletionExecutor &) = delete;
+
+        CompletionExecutor &operator=(const CompletionExecutor &) = delete;
+
+        /// Runs the tasks still queued, then stops the threads
+        ~CompletionExecutor();
+
+        void Post(std::function<void()> task);
+    };
+
+    /// `co_await RunAwaitable{model, in, out, batch, executor}` suspends the coroutine until the run is done
+    /// and resumes it on the executor, never on the ORT thread that finished the run. Failed runs rethrow.
+    class RunAwaitable {
+        OnnxModel &model;
+        void *inBuffer;
+        void *outBuffer;
+        int64_t batch;
+        CompletionExecutor &executor;
+        std::exception_ptr error;
+
+    public:
+        RunAwaitable(OnnxModel &inModel, void *inInBuffer, void *inOutBuffer, int64_t inBatch,
+                     CompletionExecutor &inExecutor)
+                : model(inModel), inBuffer(inInBuffer), outBuffer(inOutBuffer), batch(inBatch), executor(inExecutor) {}
+
+        [[nodiscard]] bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            // the coroutine may be resumed before this returns, nothing of this object is touched after the call
+            model.RunAsync(inBuffer, outBuffer, batch, [this, handle](std::exception_ptr e) {
+                error = std::move(e);
+                executor.Post([handle] { handle.resume(); });
+            });
+        }
+
+        void await_resume() const {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    };
+
+    /// Coroutine type of a fire-and-forget client: it starts at once and frees itself when it returns, so it
+    /// must signal its completion itself and catch its exceptions.
+    struct DetachedTask {
+        struct promise_type {
+            DetachedTask get_return_object() noexcept { return {}; }
+
+            std::suspend_never initial_suspend() noexcept { return {}; }
+
+            std::suspend_never final_suspend() noexcept { return {}; }
+
+            void return_void() noexcept {}
+
+            void unhandled_exception() noexcept { std::terminate(); }
+        };
+    };
+}
+
+#endif //TESTPROJECT_ASYNC_RUN_H
@@ -0,0 +1,153 @@
+//
+// Created by antares on 5/6/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "async_run.h"
+#include "model_wrapper.h"
+#include "tensor_utils.h"
+#include <iomanip>
+
+namespace OnnxBenchmarks {
+    void BenchMark::Run_AsyncRunBenchmark() {
+        const size_t cores = std::thread::hardware_concurrency();
+        size_t batch = options.sweepBatch;
+        if (batch > 1 && !model->IsBatchSupported()) {
+            Warning("Model does not support batching, async uses batch 1");
+            batch = 1;
+        }
+        auto inFlightCounts = options.asyncInFlight;
+        if (inFlightCounts.empty()) {
+            inFlightCounts = {cores, 4 * cores, 16 * cores};
+        }
+        const size_t executorThreads = std::max<size_t>(options.asyncExecutorThreads, 1);
+
+        TensorBuffer testArray(model->GetInputBufferSize() * batch);
+        FillInput(testArray.Data(), batch);
+        const size_t outArraySize = model->GetOutputBufferSize() * batch;
+
+        struct Row {
+            const char *mode;
+            size_t inFlight;
+            size_t threads;
+            double throughput;
+            uint64_t p50;
+            uint64_t p99;
+        };
+        std::vector<Row> rows;
+
+        Logging("Async vs thread-per-request, batchNum = ", batch, ", ", options.sweepSeconds, "s per point");
+
+        for (auto inFlight: inFlightCounts) {
+            std::vector<TensorBuffer> outArrays;
+            for (size_t i = 0; i < inFlight; ++i) {
+                outArrays.emplace_back(outArraySize);
+            }
+
+            // one blocked caller thread per request in flight
+            {
+                auto result = RunClosedLoop(inFlight, options.sweepSeconds, [&](size_t index) {
+                    model->Run(testArray.Data(), outArrays[index].Data(), static_cast<int64_t>(batch));
+                });
+                auto throughput = result.CallsPerSecond() * static_cast<double>(batch);
+                Logging("thread-per-request, ", inFlight, " in flight: ", throughput, " inputs/s");
+                LogLatency(result.latency);
+                report.Add({"async", {{"mode", "threads"}, {"in_flight", std::to_string(inFlight)},
+                                      {"batch", std::to_string(batch)}},
+                            "latency per call", result.latency, throughput});
+                rows.emplace_back(Row{"threads", inFlight, inFlight, throughput, result.latency.Percentile(50),
+                                      result.latency.Percentile(99)});
+            }
+
+            // one coroutine per request in flight, resumed by a few executor threads
+            {
+                ConcurrentLatencyHistogram histograms;
+                std::atomic<size_t> calls{0};
+                std::mutex errorMutex;
+                std::exception_ptr firstError;
+                Async async;
+                async.counter = inFlight;
+                CompletionExecutor executor(executorThreads);
+
+                auto start = Clock::now();
+                auto deadline = start + std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(options.sweepSeconds));
+                auto client = [&](size_t index) -> DetachedTask {
+                    try {
+                        auto last = Clock::now();
+                        while (last < deadline) {
+                            co_await RunAwaitable(*model, testArray.Data(), outArrays[index].Data(),
+                                                  static_cast<int64_t>(batch), executor);
+                            auto now = Clock::now();
+                            histograms.Local().Record(DurationToNanoseconds(now - last));
+                            last = now;
+                            ++calls;
+                        }
+                    } catch (...) {
+                        std::lock_guard lock(errorMutex);
+                        if (!firstError) {
+                            firstError = std::current_exception();
+                        }
+                    }
+                    async.finish_one();
+                };
+                for (size_t i = 0; i < inFlight; ++i) {
+                    client(i);
+                }
+                async.promise.get_future().wait();
+                auto elapsed = Clock::now() - start;
+
+                if (firstError) {
+                    try {
+                        std::rethrow_exception(firstError);
+                    } catch (const std::exception &e) {
+                        Warning("Async runs failed, skip the async mode: ", e.what());
+                    }
+                    break;
+                }
+                auto latency = histograms.Merge();
+                auto throughput = static_cast<double>(calls.load() * batch) /
+                                  std::chrono::duration<double>(elapsed).count();
+                Logging("coroutines on ", executorThreads, " executor threads, ", inFlight, " in flight: ",
+                        throughput, " inputs/s");
+                LogLatency(latency);
+                report.Add({"async", {{"mode", "coroutines"}, {"in_flight", std::to_string(inFlight)},
+                                      {"batch", std::to_string(batch)}},
+                            "latency per call", latency, throughput});
+                rows.emplace_back(Row{"coroutines", inFlight, executorThreads, throughput, latency.Percentile(50),
+                                      latency.Percentile(99)});
+            }
+        }
+
+        Logging("Async vs thread-per-request:");
+        Logging("  ", std::setw(12), "mode", std::setw(11), "in flight", std::setw(14), "caller threads",
+                std::setw(14), "inputs/s", std::setw(12), "p50 ms", std::setw(12), "p99 ms");
+        for (const auto &row: rows) {
+            Logging("  ", std::setw(12), row.mode, std::setw(11), row.inFlight, std::setw(14), row.threads,
+                    std::setw(14), row.throughput, std::setw(12), NanosecondsToMilliseconds(row.p50),
+                    std::setw(12), NanosecondsToMilliseconds(row.p99));
+        }
+    }
+}
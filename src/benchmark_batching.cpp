@@ -0,0 +1,113 @@
+//
+// Created by antares on 4/9/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "dynamic_batcher.h"
+#include "model_wrapper.h"
+#include "latency_histogram.h"
+#include "tensor_utils.h"
+
+namespace OnnxBenchmarks {
+    void BenchMark::Run_DynamicBatchingBenchmark() {
+        if (!model->IsBatchSupported()) {
+            Warning("Model does not support batching, skip dynamic batching benchmark");
+            return;
+        }
+
+        size_t inArraySize = model->GetInputBufferSize();
+        size_t outArraySize = model->GetOutputBufferSize();
+        const size_t producers = options.producers == 0 ? std::thread::hardware_concurrency() : options.producers;
+        const size_t requests = options.requestsPerProducer;
+
+        // every producer owns one batch-1 input and output
+        TensorBuffer testArray(inArraySize * producers);
+        for (size_t i = 0; i < producers; i++) {
+            FillInput(testArray.Data(inArraySize * i), 1);
+        }
+        TensorBuffer testOutArray(outArraySize * producers);
+
+        struct Result {
+            double throughput;
+            uint64_t p99;
+        };
+
+        auto measure = [&](const char *name, auto &&runOne) {
+            // every producer until its latency settles, so the arena has grown for the batch sizes that form
+            RunOnThreads(producers, [&](size_t index) {
+                std::byte *inArray = testArray.Data(index * inArraySize);
+                std::byte *outArray = testOutArray.Data(index * outArraySize);
+                WarmUpUntilStable(options.warmupCv, options.warmupMaxSeconds, [&] { runOne(inArray, outArray); });
+            });
+
+            ConcurrentLatencyHistogram histograms;
+            Clock::duration duration;
+            {
+                ClockGuard guard(duration);
+                CountingWindow window;
+                RunOnThreads(producers, [&](size_t index) {
+                    std::byte *inArray = testArray.Data(index * inArraySize);
+                    std::byte *outArray = testOutArray.Data(index * outArraySize);
+                    auto &histogram = histograms.Local();
+                    for (size_t i = 0; i < requests; i++) {
+                        auto start = Clock::now();
+                        runOne(inArray, outArray);
+                        histogram.Record(DurationToNanoseconds(Clock::now() - start));
+                    }
+                });
+            }
+            auto merged = histograms.Merge();
+            auto throughput = static_cast<double>(producers * requests) /
+                              std::chrono::duration<double>(duration).count();
+            Logging(name, ": ", producers, " producers x ", requests, " requests, time elapsed: ",
+                    DurationToMilliseconds(duration), "ms, throughput: ", throughput, " req/s");
+            LogLatency(merged, "request latency");
+            report.Add({"batcher", {{"mode", name}, {"producers", std::to_string(producers)}}, "request latency",
+                        merged, throughput});
+            return Result{throughput, merged.Percentile(99)};
+        };
+
+        auto direct = measure("Per-request Run", [this](std::byte *inArray, std::byte *outArray) {
+            model->Run(inArray, outArray, 1);
+        });
+
+        Result batched{};
+        double averageBatch;
+        {
+            DynamicBatcher batcher(model, options.maxBatch, std::chrono::microseconds(options.maxWaitMicroseconds),
+                                   options.batcherWorkers);
+            batched = measure("Dynamic batching", [&batcher](std::byte *inArray, std::byte *outArray) {
+                batcher.Submit(inArray, outArray).get();
+            });
+            averageBatch = batcher.AverageBatchSize();
+        }
+
+        Logging("Dynamic batching (max batch ", options.maxBatch, ", max wait ", options.maxWaitMicroseconds,
+                "us, ", options.batcherWorkers, " workers): average batch ", averageBatch,
+                ", throughput x", batched.throughput / direct.throughput,
+                ", p99 ", NanosecondsToMilliseconds(batched.p99), "ms vs ", NanosecondsToMilliseconds(direct.p99),
+                "ms");
+    }
+}
@@ -0,0 +1,181 @@
+//
+// Created by antares on 5/14/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "cpu_topology.h"
+#include "model_wrapper.h"
+#include "tensor_utils.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace OnnxBenchmarks {
+    namespace {
+        /// Read and write one byte of every cache line of `buffer`, which evicts whatever the model left in
+        /// the shared last-level cache and in the private caches of the calling thread's core (dirty lines
+        /// are written back). The private caches of the cores that ran ORT's intra-op threads keep their share.
+        void EvictCaches(TensorBuffer &buffer) {
+            static constexpr size_t CacheLine = 64;
+            auto *data = buffer.Data();
+            for (size_t i = 0; i < buffer.Size(); i += CacheLine) {
+                data[i] = static_cast<std::byte>(static_cast<uint8_t>(data[i]) + 1);
+            }
+        }
+    }
+
+    void BenchMark::Run_CacheStateBenchmark() {
+        // the rotating pool and the eviction buffer span this many times the last-level cache
+        static constexpr size_t LlcMultiple = 2;
+        static constexpr size_t MaxPoolBuffers = 4096;
+        static constexpr double MiB = 1024. * 1024.;
+
+        for (const auto &state: options.cacheStates) {
+            if (state != "hot" && state != "rotate" && state != "flush") {
+                throw std::invalid_argument("Unknown cache state: " + state);
+            }
+        }
+        auto batches = options.cacheBatches;
+        if (batches.empty()) {
+            batches = {1};
+        }
+        if (!model->IsBatchSupported() && batches != std::vector<size_t>{1}) {
+            Warning("Model does not support batching, measure batchNum = 1 only");
+            batches = {1};
+        }
+        auto llc = LastLevelCacheBytes();
+        Logging("Last-level cache ", static_cast<double>(llc) / MiB, " MiB, rotating and flushing over ",
+                static_cast<double>(LlcMultiple * llc) / MiB, " MiB");
+
+        TensorBuffer evictionBuffer;
+        if (std::find(options.cacheStates.begin(), options.cacheStates.end(), "flush") != options.cacheStates.end()) {
+            evictionBuffer = TensorBuffer(LlcMultiple * llc);
+            std::fill_n(evictionBuffer.Data(), evictionBuffer.Size(), std::byte{0});
+        }
+
+        struct Row {
+            std::string state;
+            size_t batch;
+            LatencyHistogram latency;
+        };
+        std::vector<Row> rows;
+
+        for (auto batch: batches) {
+            auto inBytes = model->GetInputBufferSize() * batch;
+            auto outBytes = model->GetOutputBufferSize() * batch;
+            std::vector<TensorBuffer> inputs;
+            std::vector<TensorBuffer> outputs;
+            auto addBuffers = [&](size_t count) {
+                while (inputs.size() < count) {
+                    FillInput(inputs.emplace_back(inBytes).Data(), batch);
+                    outputs.emplace_back(outBytes);
+                    // touch the output pages now, not in the first timed call
+                    std::fill_n(outputs.back().Data(), outputs.back().Size(), std::byte{0});
+                }
+            };
+            addBuffers(1);
+            WarmUpBatch(inputs.front().Data(), outputs.front().Data(), batch);
+
+            for (const auto &state: options.cacheStates) {
+                size_t next = 0;
+                auto runOne = [&] {
+                    model->Run(inputs[next].Data(), outputs[next].Data(), static_cast<int64_t>(batch));
+                };
+                PreciseMeasurement measurement;
+                if (state == "hot") {
+                    // what the other scenarios do: the same buffers every call
+                    next = 0;
+                    measurement = MeasureUntilPrecise(MeasurementTarget(), runOne);
+                } else if (state == "rotate") {
+                    auto callBytes = std::max<size_t>(inBytes + outBytes, 1);
+                    auto wanted = (LlcMultiple * llc + callBytes - 1) / callBytes;
+                    auto count = std::clamp<size_t>(wanted, 2, MaxPoolBuffers);
+                    if (count < wanted) {
+                        Warning("Rotating pool capped at ", count, " buffers (",
+                                static_cast<double>(count * callBytes) / MiB, " MiB)");
+                    }
+                    addBuffers(count);
+                    Logging("batchNum = ", batch, ": rotating over ", count, " input/output buffers");
+                    measurement = MeasureUntilPrecise(MeasurementTarget(), runOne,
+                                                      [&] { next = (next + 1) % count; });
+                } else {
+                    next = 0;
+                    // the eviction runs between the samples, outside the timed calls
+                    EvictCaches(evictionBuffer);
+                    measurement = MeasureUntilPrecise(MeasurementTarget(), runOne,
+                                                      [&] { EvictCaches(evictionBuffer); });
+                }
+
+                const auto &latency = measurement.latency;
+                // from the latency, the flushes between the calls do not count
+                auto throughput = latency.Mean() > 0 ? static_cast<double>(batch) * 1e9 / latency.Mean() : 0.;
+                Logging("batchNum = ", batch, ", ", state, ":");
+                LogLatency(latency);
+                LogPrecision(measurement.stats, measurement.converged);
+                report.Add({"cache", {{"state", state}, {"batch", std::to_string(batch)}}, "latency per call",
+                            latency, throughput, measurement.stats.RelativeHalfWidth()});
+                rows.emplace_back(Row{state, batch, latency});
+            }
+        }
+
+        Logging("Cache states side by side (slowdown: p50 against hot at the same batch size):");
+        Logging("  ", std::left, std::setw(8), "state", std::right, std::setw(7), "batch", std::setw(11), "p50 ms",
+                std::setw(11), "p99 ms", std::setw(11), "mean ms", std::setw(13), "inputs/s", std::setw(10),
+                "slowdown");
+        for (const auto &row: rows) {
+            auto hot = std::find_if(rows.begin(), rows.end(), [&row](const Row &other) {
+                return other.state == "hot" && other.batch == row.batch;
+            });
+            std::string slowdown = "-";
+            if (hot != rows.end() && hot->latency.Percentile(50) > 0) {
+                std::ostringstream ratio;
+                ratio << std::fixed << std::setprecision(2)
+                      << static_cast<double>(row.latency.Percentile(50)) /
+                         static_cast<double>(hot->latency.Percentile(50)) << "x";
+                slowdown = ratio.str();
+            }
+            Logging("  ", std::left, std::setw(8), row.state, std::right, std::setw(7), row.batch,
+                    std::setw(11), NanosecondsToMilliseconds(row.latency.Percentile(50)),
+                    std::setw(11), NanosecondsToMilliseconds(row.latency.Percentile(99)),
+                    std::setw(11), row.latency.Mean() / 1e6,
+                    std::setw(13), static_cast<double>(row.batch) * 1e9 / std::max(row.latency.Mean(), 1.),
+                    std::setw(10), slowdown);
+        }
+
+        auto &details = report.Details("cache") = JsonValue::Object{};
+        details["llc_bytes"] = static_cast<uint64_t>(llc);
+        details["pool_bytes"] = static_cast<uint64_t>(LlcMultiple * llc);
+        auto &states = details["states"] = JsonValue::Array{};
+        for (const auto &row: rows) {
+            JsonValue entry;
+            entry["state"] = row.state;
+            entry["batch"] = static_cast<uint64_t>(row.batch);
+            entry["p50_ms"] = NanosecondsToMilliseconds(row.latency.Percentile(50));
+            entry["p99_ms"] = NanosecondsToMilliseconds(row.latency.Percentile(99));
+            entry["mean_ms"] = row.latency.Mean() / 1e6;
+            states.Push(std::move(entry));
+        }
+    }
+}
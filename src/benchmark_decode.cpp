@@ -0,0 +1,208 @@
+//
+// Created by antares on 5/14/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "model_wrapper.h"
+#include "stateful_run.h"
+#include <algorithm>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+
+namespace OnnxBenchmarks {
+    void BenchMark::Run_StatefulDecodeBenchmark() {
+        // per-token latency is also broken down over this many ranges of the sequence length
+        static constexpr size_t LengthBins = 8;
+        static constexpr double MiB = 1024. * 1024.;
+
+        DecoderLayout layout(*model, options.stateMap, options.tokenInput);
+        const auto &names = model->GetInputNames();
+        for (size_t i = 0; i < layout.Inputs().size(); ++i) {
+            if (layout.Inputs()[i].role == DecoderLayout::Role::Other) {
+                Warning("Input ", names[i], " is neither tokens, attention_mask, position_ids nor state, fed zeros");
+            }
+        }
+        auto tokens = options.decodeTokens;
+        auto decodeSteps = tokens - 1;
+        auto bins = std::min(LengthBins, decodeSteps);
+        // decode step k (from 1) runs the sequence at length prompt + k
+        auto binOf = [&](size_t step) { return (step - 1) * bins / decodeSteps; };
+        Logging("Stateful decoding: ", layout.StateCount(), " state tensors fed back, ", tokens,
+                " tokens per sequence, ", options.decodeSeconds, "s per point");
+
+        struct Timings {
+            LatencyHistogram firstToken;
+            LatencyHistogram perToken;
+            std::vector<LatencyHistogram> byLength;
+            size_t tokens = 0;
+        };
+        struct Point {
+            size_t prompt;
+            size_t sequences;
+            LatencyHistogram firstToken;
+            LatencyHistogram perToken;
+            std::vector<LatencyHistogram> byLength;
+            double tokensPerSecond;
+        };
+        std::vector<Point> points;
+
+        for (auto prompt: options.decodePrompts) {
+            // the last generated token is not fed back
+            auto maxLength = prompt + decodeSteps;
+            Logging("Prompt of ", prompt, " tokens: ", static_cast<double>(layout.StateBytes(maxLength)) / MiB,
+                    " MiB of state per sequence at full length");
+
+            for (auto sequences: options.decodeSequences) {
+                std::vector<std::unique_ptr<StatefulRun>> runs;
+                for (size_t i = 0; i < sequences; ++i) {
+                    runs.emplace_back(std::make_unique<StatefulRun>(*model, layout, maxLength, options.intRange));
+                }
+                auto generate = [&](StatefulRun &run, Timings *timings) {
+                    run.Reset();
+                    auto start = Clock::now();
+                    run.Step(prompt);
+                    auto last = Clock::now();
+                    if (timings) {
+                        timings->firstToken.Record(DurationToNanoseconds(last - start));
+                    }
+                    for (size_t step = 1; step <= decodeSteps; ++step) {
+                        run.Step(1);
+                        auto now = Clock::now();
+                        if (timings) {
+                            auto ns = DurationToNanoseconds(now - last);
+                            timings->perToken.Record(ns);
+                            timings->byLength[binOf(step)].Record(ns);
+                        }
+                        last = now;
+                    }
+                    if (timings) {
+                        timings->tokens += tokens;
+                    }
+                };
+                // one untimed sequence each, which also touches every state buffer
+                for (auto &run: runs) {
+                    generate(*run, nullptr);
+                }
+
+                std::vector<Timings> timings(sequences);
+                for (auto &timing: timings) {
+                    timing.byLength.resize(bins);
+                }
+                auto countsBefore = ReadActiveCounts();
+                auto start = Clock::now();
+                auto deadline = start + std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(options.decodeSeconds));
+                {
+                    CountingWindow window;
+                    RunOnThreads(sequences, [&](size_t index) {
+                        do {
+                            generate(*runs[index], &timings[index]);
+                        } while (Clock::now() < deadline);
+                    });
+                }
+                auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+                auto counts = ReadActiveCounts().Since(countsBefore);
+
+                Point point{prompt, sequences, {}, {}, std::vector<LatencyHistogram>(bins), 0};
+                size_t generated = 0;
+                for (const auto &timing: timings) {
+                    point.firstToken.Merge(timing.firstToken);
+                    point.perToken.Merge(timing.perToken);
+                    for (size_t b = 0; b < bins; ++b) {
+                        point.byLength[b].Merge(timing.byLength[b]);
+                    }
+                    generated += timing.tokens;
+                }
+                point.tokensPerSecond = static_cast<double>(generated) / elapsed;
+
+                Logging("prompt = ", prompt, ", sequences = ", sequences, ": ", point.tokensPerSecond, " tokens/s");
+                LogLatency(point.firstToken, "time to first token");
+                LogLatency(point.perToken, "per-token latency");
+                std::vector<std::pair<std::string, std::string>> params{
+                        {"prompt", std::to_string(prompt)}, {"tokens", std::to_string(tokens)},
+                        {"sequences", std::to_string(sequences)}};
+                // hardware counts per generated token (not per sequence), for both metrics
+                auto perToken = counts.PerUnit(static_cast<double>(std::max<size_t>(generated, 1)));
+                report.Add({"decode", params, "time to first token", point.firstToken, point.tokensPerSecond, 0,
+                            MemoryUsage{}, -1, -1, perToken});
+                report.Add({"decode", params, "per-token latency", point.perToken, point.tokensPerSecond, 0,
+                            MemoryUsage{}, -1, -1, perToken});
+                points.emplace_back(std::move(point));
+            }
+        }
+
+        Logging("Decoding summary (tokens/s over all sequences):");
+        Logging("  ", std::setw(7), "prompt", std::setw(10), "sequences", std::setw(13), "ttft p50 ms",
+                std::setw(13), "ttft p99 ms", std::setw(14), "token p50 ms", std::setw(14), "token p99 ms",
+                std::setw(12), "tokens/s");
+        for (const auto &point: points) {
+            Logging("  ", std::setw(7), point.prompt, std::setw(10), point.sequences,
+                    std::setw(13), NanosecondsToMilliseconds(point.firstToken.Percentile(50)),
+                    std::setw(13), NanosecondsToMilliseconds(point.firstToken.Percentile(99)),
+                    std::setw(14), NanosecondsToMilliseconds(point.perToken.Percentile(50)),
+                    std::setw(14), NanosecondsToMilliseconds(point.perToken.Percentile(99)),
+                    std::setw(12), point.tokensPerSecond);
+        }
+
+        auto &details = report.Details("decode") = JsonValue::Object{};
+        details["tokens"] = static_cast<uint64_t>(tokens);
+        details["state_tensors"] = static_cast<uint64_t>(layout.StateCount());
+        auto &entries = details["points"] = JsonValue::Array{};
+        for (const auto &point: points) {
+            JsonValue entry;
+            entry["prompt"] = static_cast<uint64_t>(point.prompt);
+            entry["sequences"] = static_cast<uint64_t>(point.sequences);
+            entry["state_bytes"] = static_cast<uint64_t>(layout.StateBytes(point.prompt + decodeSteps));
+            entry["ttft_p50_ms"] = NanosecondsToMilliseconds(point.firstToken.Percentile(50));
+            entry["token_p50_ms"] = NanosecondsToMilliseconds(point.perToken.Percentile(50));
+            entry["tokens_per_second"] = point.tokensPerSecond;
+            // mean per-token latency by the sequence length the decode step runs at
+            std::string curve;
+            auto &lengths = entry["by_length"] = JsonValue::Array{};
+            for (size_t b = 0; b < bins; ++b) {
+                size_t first = 0, last = 0;
+                for (size_t step = 1; step <= decodeSteps; ++step) {
+                    if (binOf(step) == b) {
+                        first = first == 0 ? step : first;
+                        last = step;
+                    }
+                }
+                JsonValue range;
+                range["from"] = static_cast<uint64_t>(point.prompt + first);
+                range["to"] = static_cast<uint64_t>(point.prompt + last);
+                range["mean_ms"] = point.byLength[b].Mean() / 1e6;
+                lengths.Push(std::move(range));
+                std::ostringstream text;
+                text << std::setprecision(3) << point.prompt + first << "-" << point.prompt + last << ": "
+                     << point.byLength[b].Mean() / 1e6 << "ms";
+                curve += (curve.empty() ? "" : ", ") + text.str();
+            }
+            Logging("  prompt = ", point.prompt, ", sequences = ", point.sequences, ", per-token mean by length: ",
+                    curve);
+            entries.Push(std::move(entry));
+        }
+    }
+}
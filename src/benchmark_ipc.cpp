@@ -0,0 +1,188 @@
+//
+// Created by antares on 5/10/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "ipc_transport.h"
+#include "model_wrapper.h"
+#include "tensor_utils.h"
+#include <csignal>
+#include <exception>
+#include <mutex>
+
+namespace OnnxBenchmarks {
+    namespace {
+        std::atomic<bool> stopServing{false};
+
+        void StopServing(int) {
+            stopServing.store(true);
+        }
+    }
+
+    void BenchMark::Run_IpcServeBenchmark() {
+        IpcServer server(*model, options.ipcSocket);
+        stopServing = false;
+        auto previousInt = std::signal(SIGINT, StopServing);
+        auto previousTerm = std::signal(SIGTERM, StopServing);
+        if (options.serveSeconds > 0) {
+            Logging("Serving on ", options.ipcSocket, " for ", options.serveSeconds, "s");
+        } else {
+            Logging("Serving on ", options.ipcSocket, " until interrupted");
+        }
+        auto start = Clock::now();
+        server.Serve(stopServing, options.serveSeconds);
+        auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        std::signal(SIGINT, previousInt);
+        std::signal(SIGTERM, previousTerm);
+
+        auto latency = server.RunLatency();
+        Logging("Served ", server.Requests(), " requests on ", server.Connections(), " connections in ", elapsed,
+                "s, ", server.Failures(), " failed");
+        if (latency.Count() > 0) {
+            LogLatency(latency, "run latency per request");
+            report.Add({"serve", {{"connections", std::to_string(server.Connections())}}, "server run latency",
+                        latency, static_cast<double>(latency.Count()) / elapsed});
+        }
+    }
+
+    void BenchMark::Run_IpcClientBenchmark() {
+        auto batch = options.clientBatch;
+        if (!model->IsBatchSupported() && batch != 1) {
+            Warning("Model does not support batching, send batchNum = 1 only");
+            batch = 1;
+        }
+        auto depth = options.clientDepth;
+        auto threadCounts = options.clientThreads;
+        if (threadCounts.empty()) {
+            threadCounts = {1};
+        }
+        auto seconds = std::chrono::duration<double>(options.clientSeconds);
+
+        // the same model called in this process, what the transport is compared against
+        TensorBuffer testArray(model->GetInputBufferSize() * batch);
+        FillInput(testArray.Data(), batch);
+        TensorBuffer testOutArray(model->GetOutputBufferSize() * batch);
+        WarmUpBatch(testArray.Data(), testOutArray.Data(), batch);
+        auto inProcess = MeasureUntilPrecise(MeasurementTarget(), [&] {
+            model->Run(testArray.Data(), testOutArray.Data(), static_cast<int64_t>(batch));
+        });
+        auto inProcessP50 = NanosecondsToMilliseconds(inProcess.latency.Percentile(50));
+        Logging("In-process batchNum = ", batch, ": p50 ", inProcessP50, "ms");
+        report.Add({"client", {{"batch", std::to_string(batch)}}, "in-process latency", inProcess.latency,
+                    static_cast<double>(inProcess.latency.Count() * batch) /
+                    std::chrono::duration<double>(inProcess.elapsed).count(),
+                    inProcess.stats.RelativeHalfWidth()});
+
+        for (auto threads: threadCounts) {
+            // one connection per thread; every slot of its ring is filled once, requests copy no tensors
+            std::vector<std::unique_ptr<IpcClient>> clients;
+            for (size_t i = 0; i < threads; ++i) {
+                auto &client = clients.emplace_back(std::make_unique<IpcClient>(
+                        options.ipcSocket, static_cast<uint32_t>(depth), static_cast<uint32_t>(batch)));
+                if (client->InputBytesPerItem() != model->GetInputBufferSize() ||
+                    client->OutputBytesPerItem() != model->GetOutputBufferSize()) {
+                    throw std::runtime_error("The server at " + options.ipcSocket +
+                                             " runs a model with other tensor sizes than " + options.modelPath);
+                }
+                for (uint32_t slot = 0; slot < client->Slots(); ++slot) {
+                    FillInput(client->Input(slot), batch);
+                }
+            }
+
+            auto &first = *clients.front();
+            auto roundTrip = [&first, batch] {
+                first.Submit(0, static_cast<uint32_t>(batch));
+                first.Receive();
+            };
+            WarmUpUntilStable(options.warmupCv, options.warmupMaxSeconds, roundTrip);
+
+            ConcurrentLatencyHistogram endToEndHistograms;
+            ConcurrentLatencyHistogram serverHistograms;
+            std::atomic<size_t> calls{0};
+            // a failed connection stops the others from sending more, its error is thrown after the join
+            std::atomic<bool> failed{false};
+            std::mutex errorMutex;
+            std::exception_ptr firstError;
+            auto start = Clock::now();
+            auto deadline = start + std::chrono::duration_cast<Clock::duration>(seconds);
+            RunOnThreads(threads, [&](size_t index) {
+                try {
+                    auto &client = *clients[index];
+                    auto &endToEnd = endToEndHistograms.Local();
+                    auto &server = serverHistograms.Local();
+                    std::vector<Clock::time_point> sent(client.Slots());
+                    for (uint32_t slot = 0; slot < client.Slots(); ++slot) {
+                        sent[slot] = Clock::now();
+                        client.Submit(slot, static_cast<uint32_t>(batch));
+                    }
+                    size_t localCalls = 0;
+                    for (auto inFlight = client.Slots(); inFlight > 0;) {
+                        auto response = client.Receive();
+                        auto now = Clock::now();
+                        endToEnd.Record(DurationToNanoseconds(now - sent[response.slot]));
+                        server.Record(response.serverNanoseconds);
+                        ++localCalls;
+                        if (now < deadline && !failed.load()) {
+                            sent[response.slot] = now;
+                            client.Submit(response.slot, static_cast<uint32_t>(batch));
+                        } else {
+                            --inFlight;
+                        }
+                    }
+                    calls += localCalls;
+                } catch (...) {
+                    failed = true;
+                    std::lock_guard lock(errorMutex);
+                    if (!firstError) {
+                        firstError = std::current_exception();
+                    }
+                }
+            });
+            if (firstError) {
+                std::rethrow_exception(firstError);
+            }
+            auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+            auto endToEnd = endToEndHistograms.Merge();
+            auto server = serverHistograms.Merge();
+            auto throughput = static_cast<double>(calls.load() * batch) / elapsed;
+            // with more than one request in flight, a request also waits for the ones ahead of it
+            auto overhead = (endToEnd.Mean() - server.Mean()) / 1e6;
+            auto endToEndP50 = NanosecondsToMilliseconds(endToEnd.Percentile(50));
+            Logging("Client threads = ", threads, ", depth = ", depth, ", batchNum = ", batch, ": ", throughput,
+                    " inputs/s, end-to-end p50 ", endToEndP50, "ms (", endToEndP50 - inProcessP50,
+                    "ms over in-process), run p50 ", NanosecondsToMilliseconds(server.Percentile(50)),
+                    "ms, transport and queueing ", overhead, "ms per request on average");
+            LogLatency(endToEnd, "end-to-end latency per request");
+
+            std::vector<std::pair<std::string, std::string>> params{
+                    {"threads", std::to_string(threads)},
+                    {"depth",   std::to_string(depth)},
+                    {"batch",   std::to_string(batch)}};
+            report.Add({"client", params, "end-to-end latency", endToEnd, throughput});
+            report.Add({"client", params, "server run latency", server, throughput});
+        }
+    }
+}
@@ -0,0 +1,127 @@
+//
+// Created by antares on 5/4/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "config_matrix.h"
+#include "model_wrapper.h"
+#include "tensor_utils.h"
+#include <algorithm>
+#include <iomanip>
+
+namespace OnnxBenchmarks {
+    void BenchMark::Run_ConfigMatrixBenchmark() {
+        if (options.configMatrix.empty()) {
+            throw std::invalid_argument("The matrix scenario needs --matrix=FILE.json or --matrix='axis=a,b;...'");
+        }
+        // the axes are applied to the main session's config, so the options they leave out stay as tested
+        auto cells = ExpandConfigMatrix(LoadConfigMatrix(options.configMatrix), model->GetConfig());
+
+        auto batches = options.matrixBatches;
+        if (batches.empty()) {
+            batches = {1};
+        }
+        if (!model->IsBatchSupported() && batches != std::vector<size_t>{1}) {
+            Warning("Model does not support batching, measure batchNum = 1 only");
+            batches = {1};
+        }
+
+        struct Row {
+            std::string cell;
+            size_t batch;
+            double mean;
+            uint64_t p50;
+            uint64_t p99;
+            double throughput;
+        };
+        std::vector<Row> rows;
+
+        Logging("Config matrix, ", cells.size(), " cells");
+        for (auto &cell: cells) {
+            std::string name;
+            for (const auto &[axis, value]: cell.params) {
+                name += (name.empty() ? "" : " ") + axis + "=" + value;
+            }
+            if (!ExecutionProviderAvailable(cell.config.executionProvider)) {
+                Warning("Skip ", name, ": execution provider ", cell.config.executionProvider,
+                        " is not built into this onnxruntime");
+                continue;
+            }
+
+            std::unique_ptr<OnnxModel> configured;
+            try {
+                configured = std::make_unique<OnnxModel>(cell.config);
+                configured->SetDynamicDims(model->GetDynamicDims());
+                // a cached model is optimized already, so cells that vary the optimization level load the original
+                auto varies = [&](const char *axis) {
+                    return std::any_of(cell.params.begin(), cell.params.end(),
+                                       [&](const auto &param) { return param.first == axis; });
+                };
+                configured->Load(varies("optimization") ? options.modelPath.c_str() : model->GetModelPath().c_str());
+            } catch (const std::exception &e) {
+                Warning("Skip ", name, ": ", e.what());
+                continue;
+            }
+
+            for (auto batch: batches) {
+                TensorBuffer testArray(model->GetInputBufferSize() * batch);
+                FillInput(testArray.Data(), batch);
+                TensorBuffer testOutArray(model->GetOutputBufferSize() * batch);
+                auto runOne = [&] {
+                    configured->Run(testArray.Data(), testOutArray.Data(), static_cast<int64_t>(batch));
+                };
+
+                WarmUpUntilStable(options.warmupCv, options.warmupMaxSeconds, runOne);
+                auto measurement = MeasureUntilPrecise(MeasurementTarget(), runOne);
+                const auto &latency = measurement.latency;
+                auto throughput = static_cast<double>(latency.Count() * batch) /
+                                  std::chrono::duration<double>(measurement.elapsed).count();
+
+                Logging(name, ", batchNum = ", batch, ": ", throughput, " inputs/s");
+                LogLatency(latency);
+                LogPrecision(measurement.stats, measurement.converged);
+                auto params = cell.params;
+                params.emplace_back("batch", std::to_string(batch));
+                report.Add({"matrix", params, "latency per call", latency, throughput,
+                            measurement.stats.RelativeHalfWidth()});
+                rows.emplace_back(Row{name, batch, latency.Mean(), latency.Percentile(50), latency.Percentile(99),
+                                      throughput});
+            }
+        }
+
+        std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) {
+            return a.batch != b.batch ? a.batch < b.batch : a.mean < b.mean;
+        });
+        Logging("Ranked by mean latency:");
+        Logging("  ", std::setw(7), "batch", std::setw(12), "mean ms", std::setw(12), "p50 ms", std::setw(12),
+                "p99 ms", std::setw(14), "inputs/s", "  cell");
+        for (const auto &row: rows) {
+            Logging("  ", std::setw(7), row.batch, std::setw(12), row.mean / 1e6,
+                    std::setw(12), NanosecondsToMilliseconds(row.p50),
+                    std::setw(12), NanosecondsToMilliseconds(row.p99),
+                    std::setw(14), row.throughput, "  ", row.cell);
+        }
+    }
+}
@@ -0,0 +1,152 @@
+//
+// Created by antares on 4/28/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "memory_stats.h"
+#include "model_wrapper.h"
+#include "tensor_utils.h"
+#include <algorithm>
+#include <iomanip>
+
+namespace OnnxBenchmarks {
+    void BenchMark::Run_MemoryBenchmark() {
+        // allocations are counted over a separate window, so the atomic counters do not skew the latency
+        static constexpr size_t CountedCalls = 100;
+        static constexpr double MiB = 1024. * 1024.;
+
+        struct Variant {
+            const char *name;
+            bool memArena;
+            bool memPattern;
+            int arenaExtendStrategy;
+        };
+        static constexpr Variant Variants[] = {
+                {"default",             true,  true,  -1},
+                {"no-pattern",          true,  false, -1},
+                {"no-arena",            false, true,  -1},
+                {"no-arena-no-pattern", false, false, -1},
+                {"same-as-requested",   true,  true,  1},
+        };
+
+        std::vector<const Variant *> variants;
+        for (const auto &name: options.memoryVariants) {
+            auto it = std::find_if(std::begin(Variants), std::end(Variants),
+                                   [&name](const Variant &variant) { return name == variant.name; });
+            if (it == std::end(Variants)) {
+                throw std::invalid_argument("Unknown memory variant: " + name);
+            }
+            variants.emplace_back(it);
+        }
+
+        auto batches = options.memoryBatches;
+        if (batches.empty()) {
+            batches = {1, 8, 64};
+        }
+        if (!model->IsBatchSupported() && batches != std::vector<size_t>{1}) {
+            Warning("Model does not support batching, measure batchNum = 1 only");
+            batches = {1};
+        }
+        if (!AllocationCountingSupported()) {
+            Warning("Allocation counting is not supported on this platform");
+        }
+
+        struct Row {
+            const char *variant;
+            size_t batch;
+            uint64_t p50;
+            double allocations;
+            double bytes;
+            double arenaGrowth;
+            MemoryUsage usage;
+        };
+        std::vector<Row> rows;
+
+        for (auto variant: variants) {
+            // like the main session except for the memory options under test
+            auto config = model->GetConfig();
+            config.memArena = variant->memArena;
+            config.memPattern = variant->memPattern;
+            config.arenaExtendStrategy = variant->arenaExtendStrategy;
+
+            auto beforeLoad = ReadMemoryUsage();
+            OnnxModel fresh(config);
+            fresh.SetDynamicDims(model->GetDynamicDims());
+            fresh.Load(model->GetModelPath().c_str());
+            auto afterLoad = ReadMemoryUsage();
+            Logging("Variant ", variant->name, ": session takes ",
+                    (static_cast<double>(afterLoad.rss) - static_cast<double>(beforeLoad.rss)) / MiB, " MiB RSS");
+
+            for (auto batch: batches) {
+                TensorBuffer testArray(model->GetInputBufferSize() * batch);
+                FillInput(testArray.Data(), batch);
+                TensorBuffer testOutArray(model->GetOutputBufferSize() * batch);
+                auto runOne = [&] { fresh.Run(testArray.Data(), testOutArray.Data(), static_cast<int64_t>(batch)); };
+
+                // the arena grows for a new shape during the first calls
+                auto heapBefore = static_cast<double>(ReadMemoryUsage().heapInUse);
+                WarmUpUntilStable(options.warmupCv, options.warmupMaxSeconds, runOne);
+                auto arenaGrowth = static_cast<double>(ReadMemoryUsage().heapInUse) - heapBefore;
+
+                auto measurement = MeasureUntilPrecise(MeasurementTarget(), runOne);
+
+                AllocationCount count;
+                {
+                    AllocationCountingScope scope;
+                    for (size_t i = 0; i < CountedCalls; ++i) {
+                        runOne();
+                    }
+                    count = scope.Count();
+                }
+                auto allocations = static_cast<double>(count.allocations) / CountedCalls;
+                auto bytes = static_cast<double>(count.bytes) / CountedCalls;
+
+                const auto &latency = measurement.latency;
+                auto throughput = static_cast<double>(latency.Count() * batch) /
+                                  std::chrono::duration<double>(measurement.elapsed).count();
+                Logging("  batchNum = ", batch, ": p50 ", NanosecondsToMilliseconds(latency.Percentile(50)), "ms, ",
+                        allocations, " allocations (", bytes / 1024, " KiB) per call, heap growth ", arenaGrowth / MiB,
+                        " MiB");
+                report.Add({"memory", {{"variant", variant->name}, {"batch", std::to_string(batch)}},
+                            "latency per call", latency, throughput, measurement.stats.RelativeHalfWidth(),
+                            MemoryUsage{}, allocations, bytes});
+                rows.emplace_back(Row{variant->name, batch, latency.Percentile(50), allocations, bytes, arenaGrowth,
+                                      report.Results().back().memory});
+            }
+        }
+
+        Logging("Memory vs latency:");
+        Logging("  ", std::left, std::setw(22), "variant", std::right, std::setw(7), "batch", std::setw(11), "p50 ms",
+                std::setw(12), "allocs/call", std::setw(12), "KiB/call", std::setw(14), "heap grow MiB",
+                std::setw(10), "RSS MiB", std::setw(11), "peak MiB");
+        for (const auto &row: rows) {
+            Logging("  ", std::left, std::setw(22), row.variant, std::right, std::setw(7), row.batch,
+                    std::setw(11), NanosecondsToMilliseconds(row.p50), std::setw(12), row.allocations,
+                    std::setw(12), row.bytes / 1024, std::setw(14), row.arenaGrowth / MiB,
+                    std::setw(10), static_cast<double>(row.usage.rss) / MiB,
+                    std::setw(11), static_cast<double>(row.usage.peakRss) / MiB);
+        }
+    }
+}
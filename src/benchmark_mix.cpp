@@ -0,0 +1,171 @@
+//
+// Created by antares on 5/2/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "cpu_topology.h"
+#include "model_wrapper.h"
+#include "tensor_utils.h"
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+
+namespace OnnxBenchmarks {
+    void BenchMark::Run_ModelMixBenchmark() {
+        const auto &mix = options.mixModels;
+        if (mix.empty()) {
+            throw std::invalid_argument("The mix scenario needs models, e.g. --mix=a.onnx:3,b.onnx:1");
+        }
+        const size_t cores = std::thread::hardware_concurrency();
+        const size_t callers = options.mixCallers > 0 ? options.mixCallers : cores;
+        const size_t intraThreads = options.mixIntraThreads > 0 ? options.mixIntraThreads
+                                                                : std::max<size_t>(cores / mix.size(), 1);
+
+        // a request picks model i when the draw falls into its share of the total weight
+        std::vector<double> cumulative;
+        double totalWeight = 0;
+        for (const auto &entry: mix) {
+            totalWeight += entry.second;
+            cumulative.emplace_back(totalWeight);
+        }
+
+        std::vector<bool> threadPoolKinds;
+        if (options.mixPerSessionThreadPools) threadPoolKinds.emplace_back(false);
+        if (options.mixGlobalThreadPools) threadPoolKinds.emplace_back(true);
+
+        struct Row {
+            bool global;
+            std::string model;
+            size_t calls;
+            double throughput;
+            uint64_t p50;
+            uint64_t p99;
+        };
+        std::vector<Row> rows;
+
+        Logging("Model mix, ", mix.size(), " models, ", callers, " callers, ", options.mixSeconds, "s per pool kind");
+
+        for (auto global: threadPoolKinds) {
+            if (global && !model->GetEnv()) {
+                throw std::logic_error("Global thread pools need the Env created in main");
+            }
+
+            // with per-session pools, the intra-op threads of the sessions follow all callers' slots
+            std::vector<std::unique_ptr<OnnxModel>> models;
+            std::vector<TensorBuffer> inputs;
+            for (size_t i = 0; i < mix.size(); ++i) {
+                SessionConfig config;
+                config.intraOpThreads = static_cast<int>(intraThreads);
+                config.interOpThreads = 1;
+                config.useGlobalThreadPools = global;
+                if (!global) {
+                    config.intraOpThreadAffinities = GetThreadPlacement().IntraOpAffinities(
+                            intraThreads, callers + i * (intraThreads - 1));
+                }
+                auto &loaded = models.emplace_back(std::make_unique<OnnxModel>(
+                        config, global ? model->GetEnv() : nullptr));
+                // --shape names the main model's inputs, the other models only share the symbolic dims
+                auto isMain = mix[i].first == options.modelPath;
+                loaded->SetDynamicDims(DynamicDims{isMain ? options.shapes : decltype(options.shapes){}, options.dims});
+                loaded->Load(mix[i].first.c_str());
+
+                auto &input = inputs.emplace_back(loaded->GetInputBufferSize());
+                FillRandomInput(*loaded, input.Data(), 1, options.intRange);
+                TensorBuffer output(loaded->GetOutputBufferSize());
+                WarmUpUntilStable(options.warmupCv, options.warmupMaxSeconds,
+                                  [&] { loaded->Run(input.Data(), output.Data(), 1); });
+            }
+
+            std::vector<std::unique_ptr<ConcurrentLatencyHistogram>> histograms;
+            for (size_t i = 0; i < mix.size(); ++i) {
+                histograms.emplace_back(std::make_unique<ConcurrentLatencyHistogram>());
+            }
+            std::vector<std::atomic<size_t>> calls(mix.size());
+            auto start = Clock::now();
+            auto deadline = start + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(options.mixSeconds));
+            RunOnThreads(callers, [&](size_t) {
+                std::vector<TensorBuffer> outputs;
+                std::vector<LatencyHistogram *> local;
+                for (size_t i = 0; i < models.size(); ++i) {
+                    outputs.emplace_back(models[i]->GetOutputBufferSize());
+                    local.emplace_back(&histograms[i]->Local());
+                }
+                std::vector<size_t> localCalls(models.size());
+                auto last = Clock::now();
+                while (last < deadline) {
+                    auto draw = static_cast<double>(RandomNumber<uint64_t>(1u << 30)) / (1u << 30) * totalWeight;
+                    auto i = static_cast<size_t>(std::upper_bound(cumulative.begin(), cumulative.end(), draw) -
+                                                 cumulative.begin());
+                    i = std::min(i, models.size() - 1);
+                    models[i]->Run(inputs[i].Data(), outputs[i].Data(), 1);
+                    auto now = Clock::now();
+                    local[i]->Record(DurationToNanoseconds(now - last));
+                    last = now;
+                    ++localCalls[i];
+                }
+                for (size_t i = 0; i < models.size(); ++i) {
+                    calls[i] += localCalls[i];
+                }
+            });
+            auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            const char *pools = global ? "global" : "per-session";
+            const std::string threads = global ? std::to_string(cores) : std::to_string(intraThreads);
+            LatencyHistogram total;
+            size_t totalCalls = 0;
+            for (size_t i = 0; i < models.size(); ++i) {
+                auto latency = histograms[i]->Merge();
+                auto name = std::filesystem::path(mix[i].first).filename().string();
+                auto throughput = static_cast<double>(calls[i].load()) / seconds;
+                Logging(pools, " pools, ", name, ": ", throughput, " inputs/s");
+                LogLatency(latency);
+                report.Add({"mix", {{"pools", pools}, {"model", name}, {"callers", std::to_string(callers)},
+                                    {"intra_threads", threads}},
+                            "latency per call", latency, throughput});
+                rows.emplace_back(Row{global, name, calls[i].load(), throughput, latency.Percentile(50),
+                                      latency.Percentile(99)});
+                total.Merge(latency);
+                totalCalls += calls[i].load();
+            }
+            auto throughput = static_cast<double>(totalCalls) / seconds;
+            Logging(pools, " pools, all models: ", throughput, " inputs/s");
+            report.Add({"mix", {{"pools", pools}, {"model", "all"}, {"callers", std::to_string(callers)},
+                                {"intra_threads", threads}},
+                        "latency per call", total, throughput});
+            rows.emplace_back(Row{global, "all", totalCalls, throughput, total.Percentile(50), total.Percentile(99)});
+        }
+
+        Logging("Per-model results:");
+        Logging("  ", std::setw(12), "pools", std::setw(24), "model", std::setw(10), "calls", std::setw(14),
+                "inputs/s", std::setw(12), "p50 ms", std::setw(12), "p99 ms");
+        for (const auto &row: rows) {
+            Logging("  ", std::setw(12), row.global ? "global" : "per-session", std::setw(24), row.model,
+                    std::setw(10), row.calls, std::setw(14), row.throughput,
+                    std::setw(12), NanosecondsToMilliseconds(row.p50),
+                    std::setw(12), NanosecondsToMilliseconds(row.p99));
+        }
+    }
+}
@@ -0,0 +1,170 @@
+//
+// Created by antares on 4/30/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "cpu_topology.h"
+#include "model_wrapper.h"
+#include "tensor_utils.h"
+#include <algorithm>
+#include <cstring>
+
+namespace OnnxBenchmarks {
+    void BenchMark::Run_NumaReplicaBenchmark() {
+        const auto &topology = GetThreadPlacement().Topology();
+        const auto nodes = topology.Nodes();
+        if (nodes.size() < 2) {
+            Warning("Only one NUMA node, the replica is compared with an unpinned session on the same CPUs");
+        }
+        size_t batch = options.sweepBatch;
+        if (batch > 1 && !model->IsBatchSupported()) {
+            Warning("Model does not support batching, numa uses batch 1");
+            batch = 1;
+        }
+        const size_t callers = std::max<size_t>(options.numaCallers, 1) * nodes.size();
+        const size_t inArraySize = model->GetInputBufferSize() * batch;
+        const size_t outArraySize = model->GetOutputBufferSize() * batch;
+
+        TensorBuffer testArray(inArraySize);
+        FillInput(testArray.Data(), batch);
+
+        // one replica per node: an intra-op thread on every CPU of the node but the first, whose share of
+        // the work is done by the calling thread
+        std::vector<std::unique_ptr<OnnxModel>> replicas;
+        for (auto node: nodes) {
+            auto cpus = topology.CpusOfNode(node);
+            std::vector<std::vector<int>> threadCpus;
+            for (size_t i = 1; i < cpus.size(); ++i) {
+                threadCpus.push_back({cpus[i]});
+            }
+            auto config = model->GetConfig();
+            config.intraOpThreads = static_cast<int>(cpus.size());
+            config.interOpThreads = 1;
+            config.useGlobalThreadPools = false;
+            config.intraOpThreadAffinities = IntraOpAffinityString(threadCpus);
+            config.unpinnedThreads = true;
+            auto &replica = replicas.emplace_back(std::make_unique<OnnxModel>(config));
+            replica->SetDynamicDims(model->GetDynamicDims());
+            replica->Load(model->GetModelPath().c_str());
+        }
+
+        // the baseline: one session over all CPUs, nothing pinned, buffers wherever malloc puts them.
+        // Both modes otherwise keep the main session's config, so only the thread placement differs
+        auto sharedConfig = model->GetConfig();
+        sharedConfig.intraOpThreads = static_cast<int>(topology.Cpus().size());
+        sharedConfig.interOpThreads = 1;
+        sharedConfig.useGlobalThreadPools = false;
+        sharedConfig.intraOpThreadAffinities.clear();
+        sharedConfig.unpinnedThreads = true;
+        OnnxModel shared(sharedConfig);
+        shared.SetDynamicDims(model->GetDynamicDims());
+        shared.Load(model->GetModelPath().c_str());
+
+        Logging("NUMA replicas, ", nodes.size(), " nodes, ", callers, " callers, batchNum = ", batch, ", ",
+                options.sweepSeconds, "s per mode");
+
+        auto measure = [&](bool replicated) {
+            ConcurrentLatencyHistogram histograms;
+            std::atomic<size_t> calls{0};
+            std::atomic<size_t> ready{0};
+            std::atomic<size_t> bound{0};
+            std::vector<double> rates(callers);
+            RunOnThreads(callers, [&](size_t index) {
+                auto node = nodes[index % nodes.size()];
+                auto &session = replicated ? *replicas[index % nodes.size()] : shared;
+
+                // node-local buffers are allocated and first touched by their pinned caller
+                NodeLocalBuffer localIn, localOut;
+                TensorBuffer heapIn, heapOut;
+                std::byte *in, *out;
+                if (replicated) {
+                    PinCurrentThread(topology.CpusOfNode(node));
+                    localIn = NodeLocalBuffer(inArraySize, node);
+                    localOut = NodeLocalBuffer(outArraySize, node);
+                    bound += localIn.Bound() && localOut.Bound();
+                    in = localIn.Data();
+                    out = localOut.Data();
+                } else {
+                    heapIn = TensorBuffer(inArraySize);
+                    heapOut = TensorBuffer(outArraySize);
+                    in = heapIn.Data();
+                    out = heapOut.Data();
+                }
+                std::memcpy(in, testArray.Data(), inArraySize);
+                std::memset(out, 0, outArraySize);
+                auto runOne = [&] { session.Run(in, out, static_cast<int64_t>(batch)); };
+
+                WarmUpUntilStable(options.warmupCv, options.warmupMaxSeconds, runOne);
+                ++ready;
+                while (ready.load() < callers) {
+                    std::this_thread::yield();
+                }
+
+                auto &histogram = histograms.Local();
+                size_t localCalls = 0;
+                // after the barrier, so no caller's warm-up is counted
+                CountingWindow window;
+                auto start = Clock::now();
+                auto deadline = start + std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(options.sweepSeconds));
+                auto last = start;
+                while (last < deadline) {
+                    runOne();
+                    auto now = Clock::now();
+                    histogram.Record(DurationToNanoseconds(now - last));
+                    last = now;
+                    ++localCalls;
+                }
+                calls += localCalls;
+                rates[index] = static_cast<double>(localCalls) / std::chrono::duration<double>(last - start).count();
+            }, false);
+
+            if (replicated && bound.load() < callers) {
+                Warning("Buffers of ", callers - bound.load(), " callers could not be bound to their node, they ",
+                        "are placed by first touch");
+            }
+            auto latency = histograms.Merge();
+            double throughput = 0;
+            for (auto rate: rates) {
+                throughput += rate;
+            }
+            throughput *= static_cast<double>(batch);
+
+            const char *mode = replicated ? "replicas" : "unpinned";
+            Logging(mode, ": ", throughput, " inputs/s, ", calls.load(), " calls");
+            LogLatency(latency);
+            report.Add({"numa", {{"placement", mode}, {"callers", std::to_string(callers)},
+                                 {"batch", std::to_string(batch)}},
+                        "latency per call", latency, throughput});
+            return std::make_pair(throughput, latency.Percentile(99));
+        };
+
+        auto [sharedThroughput, sharedP99] = measure(false);
+        auto [replicaThroughput, replicaP99] = measure(true);
+        Logging("Per-node replicas vs one unpinned session: throughput x", replicaThroughput / sharedThroughput,
+                ", p99 ", NanosecondsToMilliseconds(replicaP99), "ms vs ", NanosecondsToMilliseconds(sharedP99),
+                "ms");
+    }
+}
@@ -0,0 +1,241 @@
+//
+// Created by antares on 4/5/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "model_wrapper.h"
+#include "latency_histogram.h"
+#include "tensor_utils.h"
+#include <algorithm>
+#include <condition_variable>
+#include <iomanip>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace OnnxBenchmarks {
+    namespace {
+        struct OpenLoopResult {
+            double offeredRate = 0;
+            double achievedRate = 0;
+            LatencyHistogram queueing;
+            LatencyHistogram service;
+            LatencyHistogram response;
+        };
+
+        /// Output buffers of the requests in flight. The pool does not expose its threads, so a request takes
+        /// any idle buffer; with one buffer per pool worker, one is idle whenever a worker starts a request.
+        class OutputScratch {
+            std::vector<TensorBuffer> buffers;
+            std::vector<TensorBuffer *> idle;
+            std::mutex mutex;
+            std::condition_variable condition;
+
+        public:
+            OutputScratch(size_t count, size_t bytes) {
+                buffers.reserve(count);
+                for (size_t i = 0; i < count; ++i) {
+                    idle.emplace_back(&buffers.emplace_back(bytes));
+                }
+            }
+
+            TensorBuffer *Take() {
+                std::unique_lock lock(mutex);
+                condition.wait(lock, [this] { return !idle.empty(); });
+                auto *buffer = idle.back();
+                idle.pop_back();
+                return buffer;
+            }
+
+            void Return(TensorBuffer *buffer) {
+                {
+                    std::lock_guard lock(mutex);
+                    idle.emplace_back(buffer);
+                }
+                condition.notify_one();
+            }
+        };
+
+        /// Wait until `deadline`: sleep while it is far away, spin for the last stretch.
+        void WaitUntil(Clock::time_point deadline) {
+            constexpr auto SpinThreshold = std::chrono::microseconds(200);
+            auto now = Clock::now();
+            if (deadline - now > SpinThreshold) {
+                std::this_thread::sleep_until(deadline - SpinThreshold);
+            }
+            while (Clock::now() < deadline) {
+            }
+        }
+
+        /// The scheduled send times of all requests, relative to the start of the run; at least one request
+        /// even when the rate is too low to send one within `seconds`.
+        std::vector<Clock::duration> GenerateSchedule(ArrivalProcess arrival, double rate, double seconds) {
+            std::vector<Clock::duration> schedule;
+            auto count = std::max<size_t>(static_cast<size_t>(rate * seconds), 1);
+            schedule.reserve(count);
+
+            std::mt19937_64 engine(0x5eed);
+            std::exponential_distribution<double> exponential(rate);
+            double t = 0;
+            for (size_t i = 0; i < count; ++i) {
+                schedule.emplace_back(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(t)));
+                t += arrival == ArrivalProcess::Poisson ? exponential(engine) : 1. / rate;
+            }
+            return schedule;
+        }
+    }
+
+    void BenchMark::Run_OpenLoopBenchmark() {
+        size_t batch = options.openLoopBatch;
+        if (batch > 1 && !model->IsBatchSupported()) {
+            Warning("Model does not support batching, open-loop requests use batch 1");
+            batch = 1;
+        }
+
+        size_t inArraySize = model->GetInputBufferSize() * batch;
+        size_t outArraySize = model->GetOutputBufferSize() * batch;
+
+        // every request reads the same input; outputs go to scratch buffers that live as long as the scenario
+        TensorBuffer testArray(inArraySize);
+        FillInput(testArray.Data(), batch);
+        OutputScratch outScratch(std::max<size_t>(std::thread::hardware_concurrency(), 1), outArraySize);
+
+        auto runRequest = [this, &testArray, &outScratch, batch]() {
+            auto *outBuffer = outScratch.Take();
+            model->Run(testArray.Data(), outBuffer->Data(), static_cast<int64_t>(batch));
+            outScratch.Return(outBuffer);
+        };
+
+        // Requests are sent at their scheduled time, independent of completions. Queueing delay is measured
+        // from the scheduled (not the actual) send time, so a late dispatcher can not hide latency
+        // (no coordinated omission).
+        auto runAtRate = [&runRequest, this](double rate) {
+            OpenLoopResult result;
+            result.offeredRate = rate;
+            auto schedule = GenerateSchedule(options.arrival, rate, options.openLoopSeconds);
+
+            ConcurrentLatencyHistogram queueing;
+            ConcurrentLatencyHistogram service;
+            ConcurrentLatencyHistogram response;
+            std::atomic<int64_t> lastCompletion{0};
+
+            Async async;
+            async.counter = schedule.size();
+            auto start = Clock::now();
+            for (const auto &offset: schedule) {
+                auto intended = start + offset;
+                WaitUntil(intended);
+                GetThreadPool().push_task(
+                        [&runRequest, &async, &queueing, &service, &response, &lastCompletion, intended, start]() {
+                            auto begin = Clock::now();
+                            runRequest();
+                            auto end = Clock::now();
+                            queueing.Local().Record(DurationToNanoseconds(begin - intended));
+                            service.Local().Record(DurationToNanoseconds(end - begin));
+                            response.Local().Record(DurationToNanoseconds(end - intended));
+
+                            auto finished = static_cast<int64_t>(DurationToNanoseconds(end - start));
+                            auto last = lastCompletion.load(std::memory_order_relaxed);
+                            while (last < finished && !lastCompletion.compare_exchange_weak(last, finished)) {
+                            }
+                            async.finish_one();
+                        });
+            }
+            async.promise.get_future().wait();
+
+            result.achievedRate = static_cast<double>(schedule.size()) /
+                                  (static_cast<double>(lastCompletion.load()) / 1e9);
+            result.queueing = queueing.Merge();
+            result.service = service.Merge();
+            result.response = response.Merge();
+            return result;
+        };
+
+        // `load` identifies the point across runs: the fixed rate, or the fraction of the estimated capacity
+        auto logResult = [this, batch](const OpenLoopResult &result, const std::string &load) {
+            Logging("Offered ", result.offeredRate, " req/s, achieved ", result.achievedRate, " req/s");
+            LogLatency(result.queueing, "queueing delay");
+            LogLatency(result.service, "service time");
+            LogLatency(result.response, "response time");
+            std::vector<std::pair<std::string, std::string>> params{
+                    {"arrival", options.arrival == ArrivalProcess::Poisson ? "poisson" : "constant"},
+                    {"batch",   std::to_string(batch)},
+                    {"load",    load}};
+            auto throughput = result.achievedRate * static_cast<double>(batch);
+            report.Add({"openloop", params, "queueing delay", result.queueing, throughput});
+            report.Add({"openloop", params, "service time", result.service, throughput});
+            report.Add({"openloop", params, "response time", result.response, throughput});
+        };
+
+        // The system is saturated once it can not keep up with the offered rate, or requests
+        // typically wait longer in the queue than they take to run.
+        auto isSaturated = [](const OpenLoopResult &result) {
+            return result.achievedRate < 0.95 * result.offeredRate ||
+                   result.queueing.Percentile(50) > result.service.Percentile(50);
+        };
+
+        Logging("Open-loop, ", options.arrival == ArrivalProcess::Poisson ? "poisson" : "constant",
+                " arrivals, batchNum = ", batch, ", ", options.openLoopSeconds, "s per rate");
+
+        if (options.rate > 0) {
+            std::ostringstream load;
+            load << std::setprecision(6) << options.rate << " req/s";
+            logResult(runAtRate(options.rate), load.str());
+        } else {
+            // estimate the capacity with a short closed-loop burst, then sweep around it
+            static const size_t ProbeTasks = 50 * std::thread::hardware_concurrency();
+            Clock::duration probeDuration;
+            {
+                ClockGuard guard(probeDuration);
+                Async async;
+                async.counter = ProbeTasks;
+                for (size_t i = 0; i < ProbeTasks; i++) {
+                    GetThreadPool().push_task([&runRequest, &async]() {
+                        runRequest();
+                        async.finish_one();
+                    });
+                }
+                async.promise.get_future().wait();
+            }
+            auto capacity = static_cast<double>(ProbeTasks) / std::chrono::duration<double>(probeDuration).count();
+            Logging("Estimated closed-loop capacity: ", capacity, " req/s");
+
+            static constexpr double LoadFactors[] = {0.1, 0.25, 0.5, 0.6, 0.7, 0.8, 0.85, 0.9, 0.95, 1.0, 1.1, 1.25};
+            double knee = 0;
+            for (auto factor: LoadFactors) {
+                auto result = runAtRate(capacity * factor);
+                logResult(result, std::to_string(static_cast<int>(factor * 100)) + "% capacity");
+                if (isSaturated(result)) {
+                    Logging("Saturated at ", result.offeredRate, " req/s (", factor * 100, "% of capacity)");
+                    break;
+                }
+                knee = result.offeredRate;
+            }
+            Logging("Highest sustainable rate: ", knee, " req/s");
+        }
+    }
+}
@@ -0,0 +1,267 @@
+//
+// Created by antares on 5/9/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "memory_stats.h"
+#include "model_wrapper.h"
+#include "onnx_prune.h"
+#include "profile.h"
+#include "tensor_utils.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iomanip>
+#include <numeric>
+
+namespace OnnxBenchmarks {
+    void BenchMark::Run_OutputSubsetBenchmark() {
+        static constexpr size_t CountedCalls = 100;
+        static constexpr size_t WarmUpCalls = 10;
+        static constexpr const char *ProfilePrefix = "onnxbenchmark_outputs";
+        static constexpr double MiB = 1024. * 1024.;
+
+        const auto &outputNames = model->GetOutputNames();
+        auto outputCount = outputNames.size();
+        std::vector<size_t> all(outputCount);
+        std::iota(all.begin(), all.end(), 0);
+
+        // the first subset is always every output, the baseline of the savings
+        std::vector<std::vector<size_t>> subsets{all};
+        if (options.outputSubsets.empty()) {
+            for (size_t i = 0; outputCount > 1 && i < outputCount; ++i) {
+                subsets.emplace_back(std::vector<size_t>{i});
+            }
+        }
+        for (const auto &names: options.outputSubsets) {
+            std::vector<size_t> indexes;
+            for (const auto &name: names) {
+                auto it = std::find(outputNames.begin(), outputNames.end(), name);
+                if (it == outputNames.end()) {
+                    throw std::invalid_argument("The model has no output " + name);
+                }
+                indexes.emplace_back(static_cast<size_t>(it - outputNames.begin()));
+            }
+            std::sort(indexes.begin(), indexes.end());
+            indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+            if (indexes != all) {
+                subsets.emplace_back(std::move(indexes));
+            }
+        }
+        if (subsets.size() == 1) {
+            Warning("Model has a single output, only all outputs are measured");
+        }
+
+        auto labelOf = [&outputNames](const std::vector<size_t> &subset) {
+            std::string label;
+            for (auto index: subset) {
+                label += (label.empty() ? "" : "+") + outputNames[index];
+            }
+            return label;
+        };
+
+        TensorBuffer testArray(model->GetInputBufferSize());
+        FillInput(testArray.Data(), 1);
+        // a subset's outputs are packed at the front, so the buffer of all outputs fits every subset
+        TensorBuffer testOutArray(model->GetOutputBufferSize());
+        auto run = [&](OnnxModel &session, const std::vector<size_t> &subset) {
+            if (subset.size() == outputCount) {
+                session.Run(testArray.Data(), testOutArray.Data(), 1);
+            } else if (subset.size() == 1) {
+                session.RunWithOutIndex(subset.front(), testArray.Data(), testOutArray.Data(), 1);
+            } else {
+                session.RunWithOutIndexes(subset, testArray.Data(), testOutArray.Data(), 1);
+            }
+        };
+
+        struct Row {
+            std::string label;
+            uint64_t p50 = 0;
+            double allocations = 0;
+            double bytes = 0;
+            double arenaGrowth = 0;
+            size_t nodesRun = 0;
+            std::vector<std::string> skipped;
+            double skippedShare = 0;
+            PruneResult pruned;
+            uint64_t prunedLoad = 0;
+        };
+        std::vector<Row> rows(subsets.size());
+
+        // a new session per subset, so the arena only grows to what the subset needs; every session is
+        // set up like the main one, so only the requested outputs differ
+        for (size_t s = 0; s < subsets.size(); ++s) {
+            auto &row = rows[s];
+            row.label = labelOf(subsets[s]);
+            OnnxModel fresh{model->GetConfig()};
+            fresh.SetDynamicDims(model->GetDynamicDims());
+            fresh.Load(model->GetModelPath().c_str());
+            auto runOne = [&] { run(fresh, subsets[s]); };
+
+            auto heapBefore = static_cast<double>(ReadMemoryUsage().heapInUse);
+            WarmUpUntilStable(options.warmupCv, options.warmupMaxSeconds, runOne);
+            row.arenaGrowth = static_cast<double>(ReadMemoryUsage().heapInUse) - heapBefore;
+
+            auto measurement = MeasureUntilPrecise(MeasurementTarget(), runOne);
+            {
+                AllocationCountingScope scope;
+                for (size_t i = 0; i < CountedCalls; ++i) {
+                    runOne();
+                }
+                auto count = scope.Count();
+                row.allocations = static_cast<double>(count.allocations) / CountedCalls;
+                row.bytes = static_cast<double>(count.bytes) / CountedCalls;
+            }
+
+            const auto &latency = measurement.latency;
+            row.p50 = latency.Percentile(50);
+            auto throughput = static_cast<double>(latency.Count()) /
+                              std::chrono::duration<double>(measurement.elapsed).count();
+            Logging("Outputs ", row.label, ": p50 ", NanosecondsToMilliseconds(row.p50), "ms, ", row.allocations,
+                    " allocations (", row.bytes / 1024, " KiB) per call, heap growth ", row.arenaGrowth / MiB, " MiB");
+            report.Add({"outputs", {{"outputs", row.label}}, "latency per call", latency, throughput,
+                        measurement.stats.RelativeHalfWidth(), MemoryUsage{}, row.allocations, row.bytes});
+        }
+
+        // which nodes ORT executes for every subset, from one profiled session
+        {
+            auto config = model->GetConfig();
+            config.profilePrefix = ProfilePrefix;
+            OnnxModel profiled(config);
+            profiled.SetDynamicDims(model->GetDynamicDims());
+            profiled.Load(model->GetModelPath().c_str());
+            std::vector<int> groupOfRun;
+            for (size_t s = 0; s < subsets.size(); ++s) {
+                for (size_t i = 0; i < WarmUpCalls + options.profileCalls; ++i) {
+                    run(profiled, subsets[s]);
+                    groupOfRun.emplace_back(i < WarmUpCalls ? -1 : static_cast<int>(s));
+                }
+            }
+            auto path = profiled.EndProfiling();
+            Logging("Profile of ", options.profileCalls, " calls per output subset written to ", path);
+
+            auto profiles = ParseOrtProfile(path, groupOfRun, subsets.size());
+            const auto &baseline = profiles.front();
+            for (size_t s = 0; s < subsets.size(); ++s) {
+                auto &row = rows[s];
+                row.nodesRun = profiles[s].nodes.size();
+                double skippedMicroseconds = 0;
+                for (const auto &[node, entry]: baseline.nodes) {
+                    if (profiles[s].nodes.count(node) == 0) {
+                        row.skipped.emplace_back(node);
+                        skippedMicroseconds += entry.microseconds;
+                    }
+                }
+                row.skippedShare = baseline.runMicroseconds > 0 ? skippedMicroseconds / baseline.runMicroseconds : 0.;
+            }
+        }
+
+        // load time of a model cut down to every subset, against the full model. Pruning edits the original
+        // .onnx (a cached model may be in ORT format), so both are loaded from .onnx with the main session's
+        // config, which keeps the two loads comparable
+        uint64_t fullLoad = 0;
+        if (!options.exportPrunedDir.empty()) {
+            std::filesystem::create_directories(options.exportPrunedDir);
+            auto timeLoad = [&](const std::string &path) {
+                LatencyHistogram load;
+                for (size_t i = 0; i < options.startupRepeats; ++i) {
+                    OnnxModel fresh{model->GetConfig()};
+                    fresh.SetDynamicDims(model->GetDynamicDims());
+                    auto start = Clock::now();
+                    fresh.Load(path.c_str());
+                    load.Record(DurationToNanoseconds(Clock::now() - start));
+                }
+                return load.Percentile(50);
+            };
+            fullLoad = timeLoad(options.modelPath);
+            for (size_t s = 1; s < subsets.size(); ++s) {
+                auto &row = rows[s];
+                auto fileName = row.label;
+                std::replace_if(fileName.begin(), fileName.end(), [](char c) {
+                    return !std::isalnum(static_cast<unsigned char>(c)) && c != '+' && c != '-';
+                }, '_');
+                auto path = (std::filesystem::path(options.exportPrunedDir) / (fileName + ".onnx")).string();
+                std::vector<std::string> keep;
+                for (auto index: subsets[s]) {
+                    keep.emplace_back(outputNames[index]);
+                }
+                row.pruned = PruneOnnxModel(options.modelPath, keep, path);
+                if (!row.pruned.nodesPruned) {
+                    Warning("Model ", path, " has subgraphs, only its outputs were removed");
+                }
+                row.prunedLoad = timeLoad(path);
+                Logging("Pruned model ", path, ": ", row.pruned.keptNodes, " nodes kept, ", row.pruned.removedNodes,
+                        " removed, load p50 ", NanosecondsToMilliseconds(row.prunedLoad), "ms vs ",
+                        NanosecondsToMilliseconds(fullLoad), "ms");
+            }
+        }
+
+        const auto &base = rows.front();
+        auto saved = [](double full, double part) { return full > 0 ? (full - part) / full * 100 : 0.; };
+        Logging("Output subsets vs all outputs (saved: share of the all-outputs value):");
+        Logging("  ", std::left, std::setw(32), "outputs", std::right, std::setw(11), "p50 ms", std::setw(9), "saved",
+                std::setw(12), "KiB/call", std::setw(14), "heap grow MiB", std::setw(11), "nodes run",
+                std::setw(9), "skipped", std::setw(12), "skip share");
+        for (const auto &row: rows) {
+            Logging("  ", std::left, std::setw(32), row.label.substr(0, 31), std::right,
+                    std::setw(11), NanosecondsToMilliseconds(row.p50),
+                    std::setw(8), saved(static_cast<double>(base.p50), static_cast<double>(row.p50)), "%",
+                    std::setw(12), row.bytes / 1024, std::setw(14), row.arenaGrowth / MiB,
+                    std::setw(11), row.nodesRun, std::setw(9), row.skipped.size(),
+                    std::setw(11), row.skippedShare * 100, "%");
+        }
+        for (size_t s = 1; s < rows.size(); ++s) {
+            if (rows[s].skipped.empty() && subsets[s].size() < outputCount) {
+                Warning("Outputs ", rows[s].label, ": ORT ran every node of the full graph");
+            }
+        }
+
+        auto &details = report.Details("outputs") = JsonValue::Array{};
+        for (const auto &row: rows) {
+            JsonValue entry;
+            entry["outputs"] = row.label;
+            entry["p50_ms"] = NanosecondsToMilliseconds(row.p50);
+            entry["latency_saved"] = saved(static_cast<double>(base.p50), static_cast<double>(row.p50)) / 100;
+            entry["allocations_per_call"] = row.allocations;
+            entry["bytes_per_call"] = row.bytes;
+            entry["heap_growth_bytes"] = row.arenaGrowth;
+            entry["nodes_run"] = static_cast<uint64_t>(row.nodesRun);
+            entry["skipped_share"] = row.skippedShare;
+            auto &skipped = entry["skipped_nodes"] = JsonValue::Array{};
+            for (const auto &node: row.skipped) {
+                skipped.Push(node);
+            }
+            if (row.prunedLoad > 0) {
+                auto &pruned = entry["pruned"];
+                pruned["kept_nodes"] = static_cast<uint64_t>(row.pruned.keptNodes);
+                pruned["removed_nodes"] = static_cast<uint64_t>(row.pruned.removedNodes);
+                pruned["nodes_pruned"] = row.pruned.nodesPruned;
+                pruned["load_ms"] = NanosecondsToMilliseconds(row.prunedLoad);
+                pruned["full_load_ms"] = NanosecondsToMilliseconds(fullLoad);
+            }
+            details.Push(std::move(entry));
+        }
+    }
+}
@@ -0,0 +1,98 @@
+//
+// Created by antares on 4/14/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "model_wrapper.h"
+#include "tensor_utils.h"
+#include <algorithm>
+#include <tuple>
+
+namespace OnnxBenchmarks {
+    void BenchMark::Run_PreparedRunBenchmark() {
+        size_t inArraySize = model->GetInputBufferSize();
+        size_t outArraySize = model->GetOutputBufferSize();
+
+        auto testInBatch = [this, inArraySize, outArraySize](size_t batch) {
+            Logging("Testing batchNum = ", batch, "...");
+            TensorBuffer testArray(inArraySize * batch);
+            FillInput(testArray.Data(), batch);
+            TensorBuffer testOutArray(outArraySize * batch);
+            WarmUpBatch(testArray.Data(), testOutArray.Data(), batch);
+
+            // both paths are measured before either is reported, so each sums its own hardware counts
+            HardwareCounts plainCounts{0, 0, 0, 0, 0, 0};
+            HardwareCounts boundCounts{0, 0, 0, 0, 0, 0};
+            auto measure = [this](auto &&runOne, HardwareCounts &counts) {
+                auto before = ReadActiveCounts();
+                auto latency = MeasureUntilPrecise(MeasurementTarget(), runOne).latency;
+                counts = counts.Plus(ReadActiveCounts().Since(before));
+                return latency;
+            };
+
+            auto prepared = model->Prepare(testArray.Data(), testOutArray.Data(), static_cast<int64_t>(batch));
+
+            // alternate the order so neither path always runs on a warmer cache
+            LatencyHistogram plain;
+            LatencyHistogram bound;
+            for (int round = 0; round < 2; ++round) {
+                auto runPlain = [&] {
+                    plain.Merge(measure([&] {
+                        model->Run(testArray.Data(), testOutArray.Data(), static_cast<int64_t>(batch));
+                    }, plainCounts));
+                };
+                auto runBound = [&] { bound.Merge(measure([&] { prepared.Run(); }, boundCounts)); };
+                if (round == 0) {
+                    runPlain();
+                    runBound();
+                } else {
+                    runBound();
+                    runPlain();
+                }
+            }
+
+            LogLatency(plain, "Run");
+            LogLatency(bound, "PreparedRun");
+            for (auto [histogram, metric, counts]: {std::tuple{&plain, "Run", &plainCounts},
+                                                    std::tuple{&bound, "PreparedRun", &boundCounts}}) {
+                auto calls = static_cast<double>(std::max<size_t>(histogram->Count(), 1));
+                report.Add({"prepared", {{"batch", std::to_string(batch)}}, metric, *histogram,
+                            histogram->Mean() > 0 ? static_cast<double>(batch) / histogram->Mean() * 1e9 : 0.,
+                            0, MemoryUsage{}, -1, -1, counts->PerUnit(calls)});
+            }
+            auto savedMean = plain.Mean() - bound.Mean();
+            auto savedMedian = static_cast<double>(plain.Percentile(50)) - static_cast<double>(bound.Percentile(50));
+            Logging("  per-call overhead saved: mean ", savedMean / 1e3, "us (",
+                    plain.Mean() > 0 ? savedMean / plain.Mean() * 100 : 0., "%), median ", savedMedian / 1e3, "us");
+        };
+
+        testInBatch(1);
+
+        if (model->IsBatchSupported()) {
+            testInBatch(8);
+            testInBatch(64);
+        }
+    }
+}
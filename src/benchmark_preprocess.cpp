@@ -0,0 +1,226 @@
+//
+// Created by antares on 5/11/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "image_preprocess.h"
+#include "model_wrapper.h"
+#include "tensor_utils.h"
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+
+namespace OnnxBenchmarks {
+    void BenchMark::Run_PreprocessBenchmark() {
+        auto level = ParseSimdLevel(options.simdLevel);
+
+        // the images go to the first float input shaped [N, C, H, W] with 1 to 4 channels
+        auto imageInput = model->GetInputNums();
+        size_t channels = 3;
+        size_t height = 224;
+        size_t width = 224;
+        for (size_t i = 0; i < model->GetInputNums(); ++i) {
+            const auto &dims = model->GetInputDims()[i];
+            if (model->GetInputTypes()[i] == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT && dims.size() == 4 &&
+                dims[1] >= 1 && dims[1] <= 4 && dims[2] > 0 && dims[3] > 0) {
+                imageInput = i;
+                channels = static_cast<size_t>(dims[1]);
+                height = static_cast<size_t>(dims[2]);
+                width = static_cast<size_t>(dims[3]);
+                break;
+            }
+        }
+        if (imageInput == model->GetInputNums()) {
+            Warning("Model has no float NCHW image input, only the kernels are measured, for 3x224x224");
+        }
+        Logging("Preprocess ", options.imageHeight, "x", options.imageWidth, "x", channels, " uint8 HWC images to ",
+                channels, "x", height, "x", width, " float CHW, SIMD level ", SimdLevelName(level));
+
+        Normalization normalization;
+        auto pixels = height * width;
+        std::vector<uint8_t> image(options.imageHeight * options.imageWidth * channels);
+        FillRandom(ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8, image.data(), image.size(), 256);
+        std::vector<uint8_t> resized(pixels * channels);
+        std::vector<uint8_t> planar(pixels * channels);
+        std::vector<float> floats(pixels * channels);
+        // normalize works in place, it starts from these values again before every timed call
+        std::vector<float> unnormalized(floats.size());
+        FillRandom(ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT, unnormalized.data(), unnormalized.size());
+
+        // every kernel at every level this CPU supports, on one image
+        struct Kernel {
+            const char *name;
+            std::function<void(ImagePreprocessor &, SimdLevel)> call;
+            /// Untimed, before every call of a kernel that changes its own input
+            std::function<void()> reset{};
+        };
+        const Kernel kernels[] = {
+                {"resize",         [&](ImagePreprocessor &pre, SimdLevel) {
+                    pre.Resize(image.data(), resized.data());
+                }},
+                {"hwc-to-chw",     [&](ImagePreprocessor &, SimdLevel l) {
+                    HwcToChw(resized.data(), planar.data(), pixels, channels, l);
+                }},
+                {"convert",        [&](ImagePreprocessor &, SimdLevel l) {
+                    ConvertU8ToFloat(planar.data(), floats.data(), floats.size(), normalization.scale, l);
+                }},
+                {"normalize",      [&](ImagePreprocessor &, SimdLevel l) {
+                    NormalizePlanes(floats.data(), pixels, channels, normalization, l);
+                }, [&] { std::copy(unnormalized.begin(), unnormalized.end(), floats.begin()); }},
+                {"fused",          [&](ImagePreprocessor &, SimdLevel l) {
+                    HwcToNormalizedChw(resized.data(), floats.data(), pixels, channels, normalization, l);
+                }},
+                {"pipeline-staged", [&](ImagePreprocessor &pre, SimdLevel) {
+                    pre.RunStaged(image.data(), floats.data());
+                }},
+                {"pipeline-fused", [&](ImagePreprocessor &pre, SimdLevel) {
+                    pre.Run(image.data(), floats.data());
+                }},
+        };
+        auto levels = SupportedSimdLevels();
+        std::vector<std::vector<uint64_t>> p50(std::size(kernels), std::vector<uint64_t>(levels.size()));
+        for (size_t l = 0; l < levels.size(); ++l) {
+            ImagePreprocessor pre(options.imageHeight, options.imageWidth, channels, height, width, normalization,
+                                  levels[l]);
+            for (size_t k = 0; k < std::size(kernels); ++k) {
+                const auto &kernel = kernels[k];
+                auto call = [&] { kernel.call(pre, levels[l]); };
+                if (kernel.reset) {
+                    kernel.reset();
+                    WarmUpUntilStable(options.warmupCv, options.warmupMaxSeconds, [&] {
+                        call();
+                        kernel.reset();
+                    });
+                } else {
+                    WarmUpUntilStable(options.warmupCv, options.warmupMaxSeconds, call);
+                }
+                auto measurement = kernel.reset ? MeasureUntilPrecise(MeasurementTarget(), call, kernel.reset)
+                                                : MeasureUntilPrecise(MeasurementTarget(), call);
+                const auto &latency = measurement.latency;
+                p50[k][l] = latency.Percentile(50);
+                // from the mean, the elapsed time would include the untimed resets
+                report.Add({"preprocess", {{"kernel", kernel.name}, {"simd", SimdLevelName(levels[l])}},
+                            "latency per image", latency, latency.Mean() > 0 ? 1e9 / latency.Mean() : 0.,
+                            measurement.stats.RelativeHalfWidth()});
+            }
+        }
+
+        Logging("Kernel p50 per image in microseconds (speedup over scalar):");
+        {
+            std::ostringstream header;
+            header << "  " << std::left << std::setw(18) << "kernel" << std::right;
+            for (auto l: levels) {
+                header << std::setw(20) << SimdLevelName(l);
+            }
+            Logging(header.str());
+        }
+        for (size_t k = 0; k < std::size(kernels); ++k) {
+            std::ostringstream row;
+            row << "  " << std::left << std::setw(18) << kernels[k].name << std::right << std::fixed;
+            for (size_t l = 0; l < levels.size(); ++l) {
+                auto speedup = p50[k][l] > 0 ? static_cast<double>(p50[k][0]) / static_cast<double>(p50[k][l]) : 0.;
+                row << std::setw(12) << std::setprecision(1) << static_cast<double>(p50[k][l]) / 1e3
+                    << " (" << std::setw(4) << std::setprecision(2) << speedup << "x)";
+            }
+            Logging(row.str());
+        }
+
+        if (imageInput == model->GetInputNums()) {
+            return;
+        }
+
+        // preprocessing written straight into the image input of the buffer the session wraps, then Run
+        auto batches = options.preprocessBatches;
+        if (batches.empty()) {
+            batches = {1};
+        }
+        if (!model->IsBatchSupported() && batches != std::vector<size_t>{1}) {
+            Warning("Model does not support batching, measure batchNum = 1 only");
+            batches = {1};
+        }
+        ImagePreprocessor scalarStaged(options.imageHeight, options.imageWidth, channels, height, width,
+                                       normalization, SimdLevel::Scalar);
+        ImagePreprocessor fused(options.imageHeight, options.imageWidth, channels, height, width, normalization,
+                                level);
+        auto fusedName = std::string(SimdLevelName(level)) + " fused + infer";
+        for (auto batch: batches) {
+            // every input of the layout is aligned, so the image input can be written as floats
+            size_t imageOffset = 0;
+            for (size_t i = 0; i < imageInput; ++i) {
+                imageOffset += model->GetInputBufferStrides()[i] * batch;
+            }
+            TensorBuffer testArray(model->GetInputBufferSize() * batch);
+            FillInput(testArray.Data(), batch);
+            TensorBuffer testOutArray(model->GetOutputBufferSize() * batch);
+            auto itemFloats = model->GetInputBufferSizes()[imageInput] / sizeof(float);
+            auto *images = reinterpret_cast<float *>(testArray.Data(imageOffset));
+            std::vector<std::vector<uint8_t>> sources(batch, std::vector<uint8_t>(image.size()));
+            for (auto &source: sources) {
+                FillRandom(ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8, source.data(), source.size(), 256);
+            }
+            WarmUpBatch(testArray.Data(), testOutArray.Data(), batch);
+
+            auto infer = [&] { model->Run(testArray.Data(), testOutArray.Data(), static_cast<int64_t>(batch)); };
+            struct Pipeline {
+                std::string name;
+                std::function<void()> call;
+            };
+            const Pipeline pipelines[] = {
+                    {"infer only",                  infer},
+                    {"scalar staged + infer", [&] {
+                        for (size_t b = 0; b < batch; ++b) {
+                            scalarStaged.RunStaged(sources[b].data(), images + b * itemFloats);
+                        }
+                        infer();
+                    }},
+                    {fusedName,               [&] {
+                        for (size_t b = 0; b < batch; ++b) {
+                            fused.Run(sources[b].data(), images + b * itemFloats);
+                        }
+                        infer();
+                    }},
+            };
+            uint64_t inferP50 = 0;
+            for (const auto &pipeline: pipelines) {
+                WarmUpUntilStable(options.warmupCv, options.warmupMaxSeconds, pipeline.call);
+                auto measurement = MeasureUntilPrecise(MeasurementTarget(), pipeline.call);
+                const auto &latency = measurement.latency;
+                auto median = latency.Percentile(50);
+                if (inferP50 == 0) {
+                    inferP50 = median;
+                }
+                auto share = median > inferP50 ? static_cast<double>(median - inferP50) / static_cast<double>(median)
+                                                : 0.;
+                auto throughput = static_cast<double>(latency.Count() * batch) /
+                                  std::chrono::duration<double>(measurement.elapsed).count();
+                Logging("batchNum = ", batch, ", ", pipeline.name, ": p50 ", NanosecondsToMilliseconds(median),
+                        "ms, ", throughput, " images/s, preprocessing ", share * 100, "% of the call");
+                report.Add({"preprocess", {{"pipeline", pipeline.name}, {"batch", std::to_string(batch)}},
+                            "latency per call", latency, throughput, measurement.stats.RelativeHalfWidth()});
+            }
+        }
+    }
+}
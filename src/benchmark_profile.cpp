@@ -0,0 +1,193 @@
+//
+// Created by antares on 4/27/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "model_wrapper.h"
+#include "profile.h"
+#include "tensor_utils.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace OnnxBenchmarks {
+    void BenchMark::Run_ProfileBenchmark() {
+        // untimed by the profile analysis: the arena grows and kernels pick their algorithms
+        static constexpr size_t WarmUpCalls = 10;
+        static constexpr const char *ProfilePrefix = "onnxbenchmark_profile";
+
+        auto batches = options.profileBatches;
+        if (batches.empty()) {
+            batches = {1, 8, 64};
+        }
+        if (!model->IsBatchSupported() && batches != std::vector<size_t>{1}) {
+            Warning("Model does not support batching, profile batchNum = 1 only");
+            batches = {1};
+        }
+
+        // the main session with profiling on: same options, same (possibly cached) model file
+        auto config = model->GetConfig();
+        config.profilePrefix = ProfilePrefix;
+        OnnxModel profiled(config, model->GetEnv());
+        profiled.SetDynamicDims(model->GetDynamicDims());
+        profiled.Load(model->GetModelPath().c_str());
+
+        std::vector<int> groupOfRun;
+        for (size_t group = 0; group < batches.size(); ++group) {
+            auto batch = batches[group];
+            TensorBuffer testArray(model->GetInputBufferSize() * batch);
+            FillInput(testArray.Data(), batch);
+            TensorBuffer testOutArray(model->GetOutputBufferSize() * batch);
+            for (size_t i = 0; i < WarmUpCalls + options.profileCalls; ++i) {
+                profiled.Run(testArray.Data(), testOutArray.Data(), static_cast<int64_t>(batch));
+                groupOfRun.emplace_back(i < WarmUpCalls ? -1 : static_cast<int>(group));
+            }
+        }
+        auto path = profiled.EndProfiling();
+        Logging("Profile of ", options.profileCalls, " calls per batch size written to ", path);
+
+        auto profiles = ParseOrtProfile(path, groupOfRun, batches.size());
+
+        auto msPerRun = [](const RunProfile &profile, const ProfileEntry &entry) {
+            return entry.microseconds / static_cast<double>(profile.runs) / 1e3;
+        };
+        auto lookup = [](const std::map<std::string, ProfileEntry> &entries, const std::string &key) {
+            auto it = entries.find(key);
+            return it == entries.end() ? ProfileEntry{} : it->second;
+        };
+
+        for (size_t g = 0; g < batches.size(); ++g) {
+            const auto &profile = profiles[g];
+            double kernel = 0;
+            for (const auto &[op, entry]: profile.ops) {
+                kernel += entry.microseconds;
+            }
+            auto runMs = profile.runMicroseconds / static_cast<double>(profile.runs) / 1e3;
+            auto kernelShare = profile.runMicroseconds > 0 ? kernel / profile.runMicroseconds * 100 : 0.;
+            Logging("batchNum = ", batches[g], ": run ", runMs, "ms, kernels ", kernelShare, "% of it");
+        }
+
+        // rank by the share in the first batch size
+        auto ranked = [&](const std::map<std::string, ProfileEntry> &entries) {
+            std::vector<std::string> keys;
+            for (const auto &[key, entry]: entries) {
+                keys.emplace_back(key);
+            }
+            std::sort(keys.begin(), keys.end(), [&entries](const std::string &a, const std::string &b) {
+                return entries.at(a).microseconds > entries.at(b).microseconds;
+            });
+            return keys;
+        };
+
+        auto printRow = [&](const std::string &label, const std::string &op, size_t labelWidth, auto select) {
+            std::ostringstream row;
+            row << "  " << std::left << std::setw(static_cast<int>(labelWidth)) << label.substr(0, labelWidth - 1);
+            if (!op.empty()) {
+                row << std::setw(20) << op.substr(0, 19);
+            }
+            row << std::right;
+            for (size_t g = 0; g < batches.size(); ++g) {
+                auto entry = lookup(select(profiles[g]), label);
+                auto runMicroseconds = profiles[g].runMicroseconds;
+                auto share = runMicroseconds > 0 ? entry.microseconds / runMicroseconds * 100 : 0.;
+                row << std::setw(11) << std::fixed << std::setprecision(3) << msPerRun(profiles[g], entry)
+                    << std::setw(7) << std::setprecision(1) << share << "%"
+                    << std::setw(7) << static_cast<double>(entry.calls) /
+                                        static_cast<double>(std::max<size_t>(profiles[g].runs, 1));
+            }
+            if (batches.size() > 1) {
+                auto first = msPerRun(profiles.front(), lookup(select(profiles.front()), label)) /
+                             static_cast<double>(batches.front());
+                auto last = msPerRun(profiles.back(), lookup(select(profiles.back()), label)) /
+                            static_cast<double>(batches.back());
+                row << std::setw(11) << std::setprecision(2);
+                if (first > 0) {
+                    row << last / first << "x";
+                } else {
+                    row << "-";
+                }
+            }
+            Logging(row.str());
+        };
+
+        auto printHeader = [&](const char *label, bool withOp, size_t labelWidth) {
+            std::ostringstream header;
+            header << "  " << std::left << std::setw(static_cast<int>(labelWidth)) << label;
+            if (withOp) {
+                header << std::setw(20) << "op";
+            }
+            header << std::right;
+            for (auto batch: batches) {
+                header << std::setw(11) << ("b=" + std::to_string(batch) + " ms") << std::setw(8) << "share"
+                       << std::setw(7) << "calls";
+            }
+            if (batches.size() > 1) {
+                header << std::setw(12) << "per input";
+            }
+            Logging(header.str());
+        };
+
+        auto selectOps = [](const RunProfile &profile) -> const auto & { return profile.ops; };
+        auto selectNodes = [](const RunProfile &profile) -> const auto & { return profile.nodes; };
+
+        Logging("Time per run by op type (calls: kernel calls per run, per input: cost per batch item at the ",
+                "largest vs the smallest batch):");
+        printHeader("op type", false, 24);
+        for (const auto &op: ranked(profiles.front().ops)) {
+            printRow(op, "", 24, selectOps);
+        }
+
+        auto nodes = ranked(profiles.front().nodes);
+        Logging("Top ", std::min(nodes.size(), options.profileTopNodes), " of ", nodes.size(), " nodes:");
+        printHeader("node", true, 40);
+        for (size_t i = 0; i < nodes.size() && i < options.profileTopNodes; ++i) {
+            printRow(nodes[i], profiles.front().nodeOps.at(nodes[i]), 40, selectNodes);
+        }
+
+        auto &details = report.Details("profile") = JsonValue::Array{};
+        for (size_t g = 0; g < batches.size(); ++g) {
+            const auto &profile = profiles[g];
+            JsonValue entry;
+            entry["batch"] = static_cast<uint64_t>(batches[g]);
+            entry["runs"] = static_cast<uint64_t>(profile.runs);
+            entry["run_ms"] = profile.runMicroseconds / static_cast<double>(profile.runs) / 1e3;
+            auto addEntries = [&](const char *key, const std::map<std::string, ProfileEntry> &entries, bool withOp) {
+                auto &json = entry[key] = JsonValue::Object{};
+                for (const auto &[name, e]: entries) {
+                    auto &item = json[name];
+                    if (withOp) {
+                        item["op"] = profile.nodeOps.at(name);
+                    }
+                    item["ms_per_run"] = msPerRun(profile, e);
+                    item["calls_per_run"] = static_cast<double>(e.calls) / static_cast<double>(profile.runs);
+                    item["share"] = profile.runMicroseconds > 0 ? e.microseconds / profile.runMicroseconds : 0.;
+                }
+            };
+            addEntries("ops", profile.ops, false);
+            addEntries("nodes", profile.nodes, true);
+            details.Push(std::move(entry));
+        }
+    }
+}
@@ -0,0 +1,187 @@
+//
+// Created by antares on 5/13/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "model_wrapper.h"
+#include "tensor_utils.h"
+#include <algorithm>
+#include <iomanip>
+#include <set>
+
+namespace OnnxBenchmarks {
+    void BenchMark::Run_ThreadScalingBenchmark() {
+        size_t batch = options.scalingBatch;
+        if (batch > 1 && !model->IsBatchSupported()) {
+            Warning("Model does not support batching, scaling uses batch 1");
+            batch = 1;
+        }
+        const auto &topology = GetThreadPlacement().Topology();
+        auto logical = std::max<size_t>(topology.Cpus().size(), 1);
+        auto physical = std::max<size_t>(topology.PhysicalCoreCount(), 1);
+
+        auto threadCounts = options.scalingThreads;
+        if (threadCounts.empty()) {
+            threadCounts = PowersOfTwoUpTo(logical);
+            threadCounts.emplace_back(physical);
+        }
+        // speedup and efficiency are relative to one measured thread
+        threadCounts.emplace_back(1);
+        std::sort(threadCounts.begin(), threadCounts.end());
+        threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+        // every caller is one core's worth of work when the session runs each call on the caller alone;
+        // apart from its threads the session is set up like the main one
+        auto config = model->GetConfig();
+        config.intraOpThreads = static_cast<int>(options.scalingIntraThreads);
+        config.interOpThreads = 1;
+        config.useGlobalThreadPools = false;
+        OnnxModel session(config);
+        session.SetDynamicDims(model->GetDynamicDims());
+        session.Load(model->GetModelPath().c_str());
+
+        Logging("Thread scaling, batchNum = ", batch, ", ", options.scalingIntraThreads,
+                " intra-op thread(s) per call, ", physical, " physical cores, ", logical, " logical CPUs, ",
+                options.scalingSeconds, "s per point");
+        if (!GetThreadPlacement().Enabled()) {
+            Warning("Threads are not pinned, use --pin=scatter to fill the physical cores before their SMT siblings");
+        }
+
+        auto maxThreads = threadCounts.back();
+        std::vector<TensorBuffer> inputs;
+        std::vector<TensorBuffer> outputs;
+        for (size_t i = 0; i < maxThreads; ++i) {
+            FillInput(inputs.emplace_back(model->GetInputBufferSize() * batch).Data(), batch);
+            outputs.emplace_back(model->GetOutputBufferSize() * batch);
+        }
+        auto runOne = [&](size_t index) {
+            session.Run(inputs[index].Data(), outputs[index].Data(), static_cast<int64_t>(batch));
+        };
+        WarmUpUntilStable(options.warmupCv, options.warmupMaxSeconds, [&] { runOne(0); });
+
+        struct Point {
+            size_t threads;
+            double throughput;
+            uint64_t p50;
+            uint64_t p99;
+            double speedup = 0;
+            double efficiency = 0;
+            /// Throughput gained per added thread, relative to the single-thread throughput
+            double marginal = 0;
+        };
+        std::vector<Point> points;
+
+        // whether the callers of a point share physical cores, known only when every slot is pinned to one CPU
+        const auto &placement = GetThreadPlacement();
+        auto cpuKind = [&](size_t threads) -> const char * {
+            if (!placement.Enabled() || placement.Policy() == PlacementPolicy::Numa) {
+                return "-";
+            }
+            std::set<std::pair<int, int>> cores;
+            for (size_t slot = 0; slot < threads; ++slot) {
+                for (auto cpu: placement.CpusOfSlot(slot)) {
+                    for (const auto &logicalCpu: topology.Cpus()) {
+                        if (logicalCpu.id == cpu) {
+                            cores.emplace(logicalCpu.package, logicalCpu.core);
+                        }
+                    }
+                }
+            }
+            return cores.size() < threads ? "smt" : "phys";
+        };
+
+        for (auto threads: threadCounts) {
+            // new threads for every point, pinned to slots 0, 1, ... of the placement
+            auto result = RunClosedLoop(threads, options.scalingSeconds, runOne);
+            auto throughput = result.CallsPerSecond() * static_cast<double>(batch);
+            points.emplace_back(Point{threads, throughput, result.latency.Percentile(50),
+                                      result.latency.Percentile(99)});
+            report.Add({"scaling", {{"threads", std::to_string(threads)}, {"batch", std::to_string(batch)}},
+                        "latency per call", result.latency, throughput});
+        }
+
+        auto single = points.front().throughput;
+        for (size_t i = 0; i < points.size(); ++i) {
+            auto &point = points[i];
+            point.speedup = point.throughput / single;
+            point.efficiency = point.speedup / static_cast<double>(point.threads);
+            auto previousThreads = i > 0 ? points[i - 1].threads : 0;
+            auto previousThroughput = i > 0 ? points[i - 1].throughput : 0.;
+            point.marginal = (point.throughput - previousThroughput) / single /
+                             static_cast<double>(point.threads - previousThreads);
+        }
+
+        // scaling has flattened once adding a thread gains less than the threshold of one thread's throughput
+        size_t knee = points.size() - 1;
+        for (size_t i = 1; i < points.size(); ++i) {
+            if (points[i].marginal < options.scalingKnee) {
+                knee = i - 1;
+                break;
+            }
+        }
+
+        Logging("Scaling curve (efficiency: speedup / threads, marginal: gain per added thread / 1-thread rate):");
+        Logging("  ", std::setw(8), "threads", std::setw(6), "cpus", std::setw(15), "inputs/s", std::setw(9),
+                "speedup", std::setw(12), "efficiency", std::setw(10), "marginal", std::setw(14), "p50/input ms",
+                std::setw(10), "p99 ms");
+        for (size_t i = 0; i < points.size(); ++i) {
+            const auto &point = points[i];
+            Logging("  ", std::setw(8), point.threads, std::setw(6), cpuKind(point.threads),
+                    std::setw(15), point.throughput, std::setw(9), point.speedup, std::setw(11),
+                    point.efficiency * 100, "%", std::setw(9), point.marginal * 100, "%", std::setw(14),
+                    NanosecondsToMilliseconds(point.p50) / static_cast<double>(batch), std::setw(10),
+                    NanosecondsToMilliseconds(point.p99), i == knee && knee + 1 < points.size() ? "  <- flattens" : "");
+        }
+        if (knee + 1 < points.size()) {
+            Logging("Scaling flattens after ", points[knee].threads, " threads (", points[knee].efficiency * 100,
+                    "% efficiency): the next step adds ", points[knee + 1].marginal * 100,
+                    "% of a thread per thread, below ", options.scalingKnee * 100, "%");
+        } else {
+            Logging("No flattening up to ", points.back().threads, " threads (", points.back().efficiency * 100,
+                    "% efficiency)");
+        }
+
+        auto &details = report.Details("scaling") = JsonValue::Object{};
+        details["batch"] = static_cast<uint64_t>(batch);
+        details["physical_cores"] = static_cast<uint64_t>(physical);
+        details["logical_cpus"] = static_cast<uint64_t>(logical);
+        details["knee_threads"] = static_cast<uint64_t>(points[knee].threads);
+        auto &curve = details["curve"] = JsonValue::Array{};
+        for (const auto &point: points) {
+            JsonValue entry;
+            entry["threads"] = static_cast<uint64_t>(point.threads);
+            if (std::string kind = cpuKind(point.threads); kind != "-") {
+                entry["smt"] = kind == "smt";
+            }
+            entry["throughput"] = point.throughput;
+            entry["speedup"] = point.speedup;
+            entry["efficiency"] = point.efficiency;
+            entry["marginal"] = point.marginal;
+            entry["p50_per_input_ms"] = NanosecondsToMilliseconds(point.p50) / static_cast<double>(batch);
+            entry["p99_ms"] = NanosecondsToMilliseconds(point.p99);
+            curve.Push(std::move(entry));
+        }
+    }
+}
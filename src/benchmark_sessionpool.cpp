@@ -0,0 +1,145 @@
+//
+// Created by antares on 4/12/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "session_pool.h"
+#include "tensor_utils.h"
+#include <algorithm>
+#include <iomanip>
+
+namespace OnnxBenchmarks {
+    void BenchMark::Run_SessionPoolBenchmark() {
+        const size_t cores = std::thread::hardware_concurrency();
+        size_t batch = options.sweepBatch;
+        if (batch > 1 && !model->IsBatchSupported()) {
+            Warning("Model does not support batching, sweep uses batch 1");
+            batch = 1;
+        }
+
+        size_t inArraySize = model->GetInputBufferSize() * batch;
+        size_t outArraySize = model->GetOutputBufferSize() * batch;
+
+        // all callers read the same input, each owns its output
+        TensorBuffer testArray(inArraySize);
+        FillInput(testArray.Data(), batch);
+
+        // without explicit lists, only partitions that fit the cores (K * M <= cores) are tried
+        const bool explicitGrid = !options.sessionCounts.empty() || !options.intraOpThreads.empty();
+        auto sessionCounts = options.sessionCounts.empty() ? PowersOfTwoUpTo(cores) : options.sessionCounts;
+        auto intraOpThreads = options.intraOpThreads.empty() ? PowersOfTwoUpTo(cores) : options.intraOpThreads;
+
+        std::vector<bool> threadPoolKinds;
+        if (options.sweepPerSessionThreadPools) threadPoolKinds.emplace_back(false);
+        if (options.sweepGlobalThreadPools) threadPoolKinds.emplace_back(true);
+
+        struct Cell {
+            bool global;
+            size_t sessions;
+            size_t intraThreads;
+            size_t callers;
+            double throughput;
+            uint64_t p50;
+            uint64_t p99;
+        };
+        std::vector<Cell> cells;
+
+        Logging("Session pool sweep, batchNum = ", batch, ", ", options.sweepSeconds, "s per point");
+
+        for (auto global: threadPoolKinds) {
+            if (global && !model->GetEnv()) {
+                throw std::logic_error("Global thread pools need the Env created in main");
+            }
+            // the global pool was sized once in main (one thread per core) and all K sessions share it, so
+            // there is no M to sweep: its cells report the real pool size
+            auto threadCounts = global ? std::vector<size_t>{cores} : intraOpThreads;
+            for (auto sessions: sessionCounts) {
+                for (auto intraThreads: threadCounts) {
+                    if (!explicitGrid && !global && sessions * intraThreads > cores) {
+                        continue;
+                    }
+
+                    SessionConfig config;
+                    config.intraOpThreads = static_cast<int>(intraThreads);
+                    config.interOpThreads = 1;
+                    config.useGlobalThreadPools = global;
+                    SessionPool pool(options.modelPath, sessions, config, model->GetDynamicDims(),
+                                     global ? model->GetEnv() : nullptr);
+
+                    auto callerCounts = options.callerCounts;
+                    if (callerCounts.empty()) {
+                        callerCounts = {sessions};
+                        if (cores != sessions) callerCounts.emplace_back(cores);
+                    }
+
+                    for (auto callers: callerCounts) {
+                        std::vector<TensorBuffer> outArrays;
+                        for (size_t i = 0; i < callers; ++i) {
+                            outArrays.emplace_back(outArraySize);
+                        }
+                        auto runOne = [&](size_t index) {
+                            pool.Get(index).Run(testArray.Data(), outArrays[index].Data(),
+                                                static_cast<int64_t>(batch));
+                        };
+
+                        // warm up every session before timing
+                        RunOnThreads(callers, [&](size_t index) {
+                            WarmUpUntilStable(options.warmupCv, options.warmupMaxSeconds, [&] { runOne(index); });
+                        });
+                        auto result = RunClosedLoop(callers, options.sweepSeconds, runOne);
+
+                        auto &cell = cells.emplace_back(
+                                Cell{global, sessions, intraThreads, callers,
+                                     result.CallsPerSecond() * static_cast<double>(batch),
+                                     result.latency.Percentile(50), result.latency.Percentile(99)});
+                        Logging(global ? "global" : "per-session", " pools, K = ", sessions, ", M = ",
+                                intraThreads, ", callers = ", callers, ": ", cell.throughput, " inputs/s");
+                        LogLatency(result.latency);
+                        report.Add({"sessionpool",
+                                    {{"pools", global ? "global" : "per-session"},
+                                     {"sessions", std::to_string(sessions)},
+                                     {"intra_threads", std::to_string(intraThreads)},
+                                     {"callers", std::to_string(callers)},
+                                     {"batch", std::to_string(batch)}},
+                                    "latency per call", result.latency, cell.throughput});
+                    }
+                }
+            }
+        }
+
+        std::sort(cells.begin(), cells.end(),
+                  [](const Cell &a, const Cell &b) { return a.throughput > b.throughput; });
+        Logging("Ranked by throughput:");
+        Logging("  ", std::setw(12), "pools", std::setw(6), "K", std::setw(6), "M", std::setw(9), "callers",
+                std::setw(14), "inputs/s", std::setw(12), "p50 ms", std::setw(12), "p99 ms");
+        for (const auto &cell: cells) {
+            Logging("  ", std::setw(12), cell.global ? "global" : "per-session", std::setw(6), cell.sessions,
+                    std::setw(6), cell.intraThreads, std::setw(9), cell.callers,
+                    std::setw(14), cell.throughput,
+                    std::setw(12), NanosecondsToMilliseconds(cell.p50),
+                    std::setw(12), NanosecondsToMilliseconds(cell.p99));
+        }
+    }
+}
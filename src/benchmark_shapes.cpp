@@ -0,0 +1,138 @@
+//
+// Created by antares on 4/20/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "model_wrapper.h"
+#include "tensor_utils.h"
+#include <algorithm>
+#include <iomanip>
+
+namespace OnnxBenchmarks {
+    void BenchMark::Run_ShapeSweepBenchmark() {
+        if (options.sweepDim.empty() || options.sweepDimValues.empty()) {
+            Warning("No dimension to sweep, set it with --sweep-dim=SYMBOL:MIN:MAX");
+            return;
+        }
+
+        bool found = false;
+        for (const auto &symbols: model->GetInputSymbols()) {
+            found = found || std::find(symbols.begin(), symbols.end(), options.sweepDim) != symbols.end();
+        }
+        if (!found) {
+            std::string available;
+            for (const auto &symbols: model->GetInputSymbols()) {
+                for (const auto &symbol: symbols) {
+                    if (!symbol.empty() && available.find(symbol) == std::string::npos) {
+                        available += " " + symbol;
+                    }
+                }
+            }
+            Warning("No input has the symbolic dimension ", options.sweepDim, ", available:", available);
+            return;
+        }
+
+        std::vector<size_t> batches{1};
+        if (model->IsBatchSupported() && options.sweepBatch > 1) {
+            batches.emplace_back(options.sweepBatch);
+        }
+
+        struct Point {
+            int64_t value;
+            size_t batch;
+            double mean;
+            uint64_t p50;
+            uint64_t p99;
+            double throughput;
+        };
+        std::vector<Point> points;
+
+        const auto savedDims = model->GetDynamicDims();
+        for (auto value: options.sweepDimValues) {
+            auto dims = savedDims;
+            dims.symbols[options.sweepDim] = value;
+            // an explicit shape of an input would pin the swept dimension, let the symbol decide
+            for (size_t i = 0; i < model->GetInputNums(); ++i) {
+                const auto &symbols = model->GetInputSymbols()[i];
+                if (std::find(symbols.begin(), symbols.end(), options.sweepDim) != symbols.end()) {
+                    dims.shapes.erase(model->GetInputNames()[i]);
+                }
+            }
+            model->SetDynamicDims(dims);
+
+            for (auto batch: batches) {
+                TensorBuffer testArray(model->GetInputBufferSize() * batch);
+                FillInput(testArray.Data(), batch);
+                TensorBuffer testOutArray(model->GetOutputBufferSize() * batch);
+
+                // the arena has to grow for every new shape
+                WarmUpBatch(testArray.Data(), testOutArray.Data(), batch);
+                auto measurement = MeasureUntilPrecise(MeasurementTarget(), [&] {
+                    model->Run(testArray.Data(), testOutArray.Data(), static_cast<int64_t>(batch));
+                });
+                const auto &histogram = measurement.latency;
+
+                auto throughput = static_cast<double>(histogram.Count() * batch) /
+                                  std::chrono::duration<double>(measurement.elapsed).count();
+                Logging(options.sweepDim, " = ", value, ", batchNum = ", batch, ": ", throughput, " inputs/s, ",
+                        throughput * static_cast<double>(value), " ", options.sweepDim, " elements/s");
+                LogLatency(histogram);
+                LogPrecision(measurement.stats, measurement.converged);
+                report.Add({"shapes", {{options.sweepDim, std::to_string(value)}, {"batch", std::to_string(batch)}},
+                            "latency per call", histogram, throughput, measurement.stats.RelativeHalfWidth()});
+                points.emplace_back(Point{value, batch, histogram.Mean(), histogram.Percentile(50),
+                                          histogram.Percentile(99), throughput});
+            }
+        }
+        model->SetDynamicDims(savedDims);
+
+        Logging("Shape sweep summary (", options.sweepDim, "):");
+        Logging("  ", std::setw(10), options.sweepDim, std::setw(7), "batch", std::setw(12), "p50 ms",
+                std::setw(12), "p99 ms", std::setw(14), "inputs/s", std::setw(16), "ns/element");
+        for (auto batch: batches) {
+            const Point *previous = nullptr;
+            for (const auto &point: points) {
+                if (point.batch != batch) {
+                    continue;
+                }
+                auto perElement = point.mean / static_cast<double>(point.value * static_cast<int64_t>(batch));
+                Logging("  ", std::setw(10), point.value, std::setw(7), batch,
+                        std::setw(12), NanosecondsToMilliseconds(point.p50),
+                        std::setw(12), NanosecondsToMilliseconds(point.p99),
+                        std::setw(14), point.throughput, std::setw(16), perElement);
+                // the cost per element should stay flat or fall as the shape grows; a jump is a cliff
+                if (previous) {
+                    auto previousPerElement = previous->mean /
+                                              static_cast<double>(previous->value * static_cast<int64_t>(batch));
+                    if (perElement > 1.25 * previousPerElement) {
+                        Logging("    ^ latency cliff: cost per element x", perElement / previousPerElement,
+                                " from ", options.sweepDim, " = ", previous->value);
+                    }
+                }
+                previous = &point;
+            }
+        }
+    }
+}
@@ -0,0 +1,230 @@
+//
+// Created by antares on 5/12/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "model_wrapper.h"
+#include "tensor_utils.h"
+#include <algorithm>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <set>
+
+namespace OnnxBenchmarks {
+    namespace {
+        struct SloProbe {
+            size_t batch = 0;
+            size_t concurrency = 0;
+            /// Inputs per second
+            double throughput = 0;
+            /// Latency per call at the SLO percentile
+            uint64_t latency = 0;
+            bool feasible = false;
+        };
+
+        /// Probes no other probe beats on both throughput and latency, by ascending latency
+        std::vector<SloProbe> ParetoFrontier(std::vector<SloProbe> probes) {
+            std::sort(probes.begin(), probes.end(), [](const SloProbe &a, const SloProbe &b) {
+                return a.latency != b.latency ? a.latency < b.latency : a.throughput > b.throughput;
+            });
+            std::vector<SloProbe> frontier;
+            for (const auto &probe: probes) {
+                if (frontier.empty() || probe.throughput > frontier.back().throughput) {
+                    frontier.emplace_back(probe);
+                }
+            }
+            return frontier;
+        }
+    }
+
+    void BenchMark::Run_SloSearchBenchmark() {
+        // a batch range is bisected until it is this narrow relative to its lower end
+        static constexpr double BatchTolerance = 0.125;
+        // concurrency doubling stops after this many steps without a better throughput
+        static constexpr size_t PatienceSteps = 2;
+
+        auto slo = static_cast<uint64_t>(options.sloMilliseconds * 1e6);
+        auto percentile = options.sloPercentile;
+        auto maxBatch = model->IsBatchSupported() ? options.sloMaxBatch : 1;
+        if (!model->IsBatchSupported()) {
+            Warning("Model does not support batching, search the concurrency at batchNum = 1 only");
+        }
+        auto maxConcurrency = options.sloMaxConcurrency > 0
+                              ? options.sloMaxConcurrency
+                              : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        Logging("Search batch size x concurrency for p", percentile, " <= ", options.sloMilliseconds,
+                "ms, batch up to ", maxBatch, ", concurrency up to ", maxConcurrency);
+
+        std::map<std::pair<size_t, size_t>, SloProbe> probes;
+        std::set<size_t> warmed;
+        auto probe = [&](size_t batch, size_t concurrency) -> const SloProbe & {
+            auto key = std::make_pair(batch, concurrency);
+            if (auto it = probes.find(key); it != probes.end()) {
+                return it->second;
+            }
+            std::vector<TensorBuffer> inputs;
+            std::vector<TensorBuffer> outputs;
+            for (size_t i = 0; i < concurrency; ++i) {
+                FillInput(inputs.emplace_back(model->GetInputBufferSize() * batch).Data(), batch);
+                outputs.emplace_back(model->GetOutputBufferSize() * batch);
+            }
+            if (warmed.insert(batch).second) {
+                WarmUpBatch(inputs.front().Data(), outputs.front().Data(), batch);
+            }
+            auto result = RunClosedLoop(concurrency, options.sloSeconds, [&](size_t index) {
+                model->Run(inputs[index].Data(), outputs[index].Data(), static_cast<int64_t>(batch));
+            });
+
+            SloProbe point{batch, concurrency, result.CallsPerSecond() * static_cast<double>(batch),
+                           result.latency.Percentile(percentile)};
+            point.feasible = point.latency <= slo;
+            Logging("  batchNum = ", batch, ", concurrency = ", concurrency, ": ", point.throughput, " inputs/s, p",
+                    percentile, " ", NanosecondsToMilliseconds(point.latency), "ms",
+                    point.feasible ? "" : " (violates the SLO)");
+            report.Add({"slo", {{"batch", std::to_string(batch)}, {"concurrency", std::to_string(concurrency)}},
+                        "latency per call", result.latency, point.throughput});
+            return probes[key] = point;
+        };
+
+        // Latency grows with the batch, so the largest batch within the SLO is found by doubling, then by
+        // bisecting between the last feasible and the first infeasible batch. 0 if batch 1 already fails.
+        auto largestFeasibleBatch = [&](size_t concurrency) -> size_t {
+            if (!probe(1, concurrency).feasible) {
+                return 0;
+            }
+            size_t low = 1;
+            size_t high = 0;
+            while (low < maxBatch) {
+                auto next = std::min(low * 2, maxBatch);
+                if (!probe(next, concurrency).feasible) {
+                    high = next;
+                    break;
+                }
+                low = next;
+            }
+            auto tolerance = [&low] { return std::max(1., BatchTolerance * static_cast<double>(low)); };
+            while (high > 0 && static_cast<double>(high - low) > tolerance()) {
+                auto middle = low + (high - low) / 2;
+                if (probe(middle, concurrency).feasible) {
+                    low = middle;
+                } else {
+                    high = middle;
+                }
+            }
+            return low;
+        };
+
+        // the concurrency doubles while that pays off, then the gaps next to the best one are halved once
+        std::map<size_t, double> bestAt;
+        auto explore = [&](size_t concurrency) {
+            auto batch = largestFeasibleBatch(concurrency);
+            bestAt[concurrency] = batch > 0 ? probe(batch, concurrency).throughput : 0.;
+            return batch > 0;
+        };
+        double best = 0;
+        size_t stale = 0;
+        for (size_t concurrency = 1; stale < PatienceSteps; concurrency = std::min(concurrency * 2, maxConcurrency)) {
+            // more callers only add contention once batch 1 misses the SLO
+            if (!explore(concurrency)) {
+                break;
+            }
+            if (bestAt[concurrency] > best) {
+                best = bestAt[concurrency];
+                stale = 0;
+            } else {
+                ++stale;
+            }
+            if (concurrency == maxConcurrency) {
+                break;
+            }
+        }
+        if (best > 0) {
+            auto top = std::max_element(bestAt.begin(), bestAt.end(), [](const auto &a, const auto &b) {
+                return a.second < b.second;
+            })->first;
+            auto above = bestAt.upper_bound(top);
+            auto below = bestAt.find(top);
+            if (above != bestAt.end() && above->first - top > 1) {
+                explore(top + (above->first - top) / 2);
+            }
+            if (below != bestAt.begin() && top - std::prev(below)->first > 1) {
+                explore(std::prev(below)->first + (top - std::prev(below)->first) / 2);
+            }
+        }
+
+        std::vector<SloProbe> all;
+        for (const auto &[key, point]: probes) {
+            all.emplace_back(point);
+        }
+        auto frontier = ParetoFrontier(all);
+
+        Logging("Pareto frontier of the ", all.size(), " probes (p", percentile, " latency vs throughput):");
+        Logging("  ", std::setw(7), "batch", std::setw(13), "concurrency", std::setw(15), "inputs/s",
+                std::setw(12), "latency ms", std::setw(6), "SLO");
+        for (const auto &point: frontier) {
+            Logging("  ", std::setw(7), point.batch, std::setw(13), point.concurrency, std::setw(15), point.throughput,
+                    std::setw(12), NanosecondsToMilliseconds(point.latency), std::setw(6),
+                    point.feasible ? "ok" : "miss");
+        }
+
+        auto toJson = [](const SloProbe &point) {
+            JsonValue json;
+            json["batch"] = static_cast<uint64_t>(point.batch);
+            json["concurrency"] = static_cast<uint64_t>(point.concurrency);
+            json["throughput"] = point.throughput;
+            json["latency_ms"] = NanosecondsToMilliseconds(point.latency);
+            json["feasible"] = point.feasible;
+            return json;
+        };
+        auto &details = report.Details("slo") = JsonValue::Object{};
+        details["percentile"] = percentile;
+        details["slo_ms"] = options.sloMilliseconds;
+        auto &frontierJson = details["frontier"] = JsonValue::Array{};
+        for (const auto &point: frontier) {
+            frontierJson.Push(toJson(point));
+        }
+        auto &probesJson = details["probes"] = JsonValue::Array{};
+        for (const auto &point: all) {
+            probesJson.Push(toJson(point));
+        }
+
+        std::vector<SloProbe> feasible;
+        std::copy_if(all.begin(), all.end(), std::back_inserter(feasible),
+                     [](const SloProbe &point) { return point.feasible; });
+        if (feasible.empty()) {
+            Warning("No configuration meets p", percentile, " <= ", options.sloMilliseconds,
+                    "ms, not even batchNum = 1 on one thread");
+            details["best"] = nullptr;
+            return;
+        }
+        auto top = *std::max_element(feasible.begin(), feasible.end(), [](const SloProbe &a, const SloProbe &b) {
+            return a.throughput < b.throughput;
+        });
+        Logging("Best within the SLO: batchNum = ", top.batch, ", concurrency = ", top.concurrency, ", ",
+                top.throughput, " inputs/s at p", percentile, " ", NanosecondsToMilliseconds(top.latency), "ms");
+        details["best"] = toJson(top);
+    }
+}
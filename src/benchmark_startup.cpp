@@ -0,0 +1,147 @@
+//
+// Created by antares on 4/26/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include "model_wrapper.h"
+#include "model_cache.h"
+#include "latency_histogram.h"
+#include "tensor_utils.h"
+#include <filesystem>
+
+namespace OnnxBenchmarks {
+    void BenchMark::Run_StartupBenchmark() {
+        static constexpr const char *DefaultCacheDir = ".onnxbenchmark-cache";
+        const std::string &modelPath = options.modelPath;
+
+        TensorBuffer testArray(model->GetInputBufferSize());
+        FillInput(testArray.Data(), 1);
+        TensorBuffer testOutArray(model->GetOutputBufferSize());
+
+        struct StartupSample {
+            uint64_t load;
+            uint64_t firstRun;
+        };
+
+        // Create a new session from `path`, time it, its first inference and the calls right after.
+        // Only the session is new, the process (and the ORT Env) is already warm.
+        auto measure = [&](const std::string &path, const SessionConfig &config, LatencyHistogram &firstCalls) {
+            OnnxModel fresh(config);
+            fresh.SetDynamicDims(model->GetDynamicDims());
+            auto start = Clock::now();
+            fresh.Load(path.c_str());
+            auto loaded = Clock::now();
+            fresh.Run(testArray.Data(), testOutArray.Data(), 1);
+            auto first = Clock::now();
+            auto last = first;
+            for (size_t i = 0; i < options.firstCalls; ++i) {
+                fresh.Run(testArray.Data(), testOutArray.Data(), 1);
+                auto now = Clock::now();
+                firstCalls.Record(DurationToNanoseconds(now - last));
+                last = now;
+            }
+            return StartupSample{DurationToNanoseconds(loaded - start), DurationToNanoseconds(first - loaded)};
+        };
+
+        struct Summary {
+            LatencyHistogram load;
+            LatencyHistogram firstRun;
+            LatencyHistogram firstCalls;
+
+            [[nodiscard]] double TimeToFirstInference() const {
+                return NanosecondsToMilliseconds(load.Percentile(50) + firstRun.Percentile(50));
+            }
+        };
+
+        auto run = [&](const char *cache, bool cold, const std::string &path, const SessionConfig &config,
+                       size_t repeats) {
+            const char *pageCache = cold ? "cold" : "warm";
+            Summary summary;
+            for (size_t i = 0; i < repeats; ++i) {
+                if (cold) {
+                    EvictFromPageCache(path);
+                }
+                auto sample = measure(path, config, summary.firstCalls);
+                summary.load.Record(sample.load);
+                summary.firstRun.Record(sample.firstRun);
+            }
+            Logging("Cache ", cache, ", ", pageCache, " page cache, ", repeats, " loads: load p50 ",
+                    NanosecondsToMilliseconds(summary.load.Percentile(50)), "ms, first inference p50 ",
+                    NanosecondsToMilliseconds(summary.firstRun.Percentile(50)), "ms, time to first inference ",
+                    summary.TimeToFirstInference(), "ms");
+            LogLatency(summary.firstCalls, "next calls");
+
+            std::vector<std::pair<std::string, std::string>> params{{"cache",      cache},
+                                                                    {"page_cache", pageCache}};
+            report.Add({"startup", params, "load time", summary.load, 0});
+            report.Add({"startup", params, "first inference", summary.firstRun, 0});
+            report.Add({"startup", params, "next calls", summary.firstCalls, 0});
+            return summary;
+        };
+
+        Logging("Startup, ", options.startupRepeats, " warm loads per configuration, ", options.firstCalls,
+                " calls timed after the first");
+
+        SessionConfig plainConfig;
+        auto coldPlain = run("off", true, modelPath, plainConfig, 1);
+        auto warmPlain = run("off", false, modelPath, plainConfig, options.startupRepeats);
+
+        ModelCache cache(options.modelCacheDir.empty() ? DefaultCacheDir : options.modelCacheDir,
+                         options.cacheFormat);
+        SessionConfig cachedConfig;
+        auto entry = cache.Prepare(modelPath, cachedConfig);
+        if (entry == modelPath) {
+            // a miss: this load optimizes the graph and writes the entry
+            Clock::duration populate;
+            {
+                ClockGuard guard(populate);
+                OnnxModel writer(cachedConfig);
+                writer.SetDynamicDims(model->GetDynamicDims());
+                writer.Load(modelPath.c_str());
+            }
+            Logging("Cache populated in ", DurationToMilliseconds(populate), "ms");
+            cachedConfig = SessionConfig{};
+            entry = cache.Prepare(modelPath, cachedConfig);
+            if (entry == modelPath) {
+                Warning("ORT did not write the optimized model, skip cached loads");
+                return;
+            }
+        }
+        Logging("Cache entry: ", entry, ", ", std::filesystem::file_size(entry), " bytes (model: ",
+                std::filesystem::file_size(modelPath), " bytes)");
+
+        auto coldCached = run("on", true, entry, cachedConfig, 1);
+        auto warmCached = run("on", false, entry, cachedConfig, options.startupRepeats);
+
+        auto speedup = [](const LatencyHistogram &plain, const LatencyHistogram &cached) {
+            auto c = static_cast<double>(cached.Percentile(50));
+            return c > 0 ? static_cast<double>(plain.Percentile(50)) / c : 0.;
+        };
+        Logging("Model cache speedup: load x", speedup(coldPlain.load, coldCached.load), " cold, x",
+                speedup(warmPlain.load, warmCached.load), " warm; time to first inference ",
+                warmPlain.TimeToFirstInference(), "ms -> ", warmCached.TimeToFirstInference(), "ms warm, ",
+                coldPlain.TimeToFirstInference(), "ms -> ", coldCached.TimeToFirstInference(), "ms cold");
+    }
+}
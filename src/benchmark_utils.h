@@ -0,0 +1,288 @@
+//
+// Created by antares on 4/5/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_BENCHMARK_UTILS_H
+#define TESTPROJECT_BENCHMARK_UTILS_H
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "lockfree-threadpool/src/ThreadPool.h"
+#include "latency_histogram.h"
+#include "cpu_topology.h"
+#include "perf_counters.h"
+
+namespace OnnxBenchmarks {
+    struct Async {
+        std::atomic<size_t> counter;
+        std::promise<void> promise;
+
+        void finish_one() {
+            if (--counter == 0) {
+                promise.set_value();
+            }
+        }
+
+        void finish_n(size_t n) {
+            size_t c = counter.fetch_sub(n);
+            if (c == n) {
+                promise.set_value();
+            }
+        }
+    };
+
+    using Clock = std::chrono::high_resolution_clock;
+
+    inline double DurationToMilliseconds(const Clock::duration &duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    inline uint64_t DurationToNanoseconds(const Clock::duration &duration) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+
+    inline double NanosecondsToMilliseconds(uint64_t ns) {
+        return static_cast<double>(ns) / 1e6;
+    }
+
+    inline auto &GetThreadPool() {
+        static Antares::ThreadPool pool;
+        return pool;
+    }
+
+    /// 1, 2, 4, ... up to `n`, and `n` itself when it is not a power of two
+    inline std::vector<size_t> PowersOfTwoUpTo(size_t n) {
+        std::vector<size_t> answer;
+        for (size_t i = 1; i <= n; i *= 2) {
+            answer.emplace_back(i);
+        }
+        if (n > 0 && answer.back() != n) {
+            answer.emplace_back(n);
+        }
+        return answer;
+    }
+
+    /// Run `func(index)` on `count` new threads and wait for all of them. Thread i is pinned to slot i of
+    /// the placement, unless `pinned` is false.
+    template<typename F>
+    void RunOnThreads(size_t count, F &&func, bool pinned = true) {
+        std::vector<std::thread> threads;
+        threads.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            threads.emplace_back([&func, i, pinned]() {
+                if (pinned) {
+                    GetThreadPlacement().PinCurrentThread(i);
+                } else {
+                    GetThreadPlacement().UnpinCurrentThread();
+                }
+                func(i);
+            });
+        }
+        for (auto &thread: threads) {
+            thread.join();
+        }
+    }
+
+    /// Welford's running mean and variance of latencies in nanoseconds
+    struct RunningStats {
+        size_t count = 0;
+        double mean = 0;
+        double m2 = 0;
+
+        void Add(double x) {
+            ++count;
+            auto delta = x - mean;
+            mean += delta / static_cast<double>(count);
+            m2 += delta * (x - mean);
+        }
+
+        [[nodiscard]] double StdDev() const {
+            return count > 1 ? std::sqrt(m2 / static_cast<double>(count - 1)) : 0;
+        }
+
+        /// Coefficient of variation
+        [[nodiscard]] double Cv() const {
+            return mean > 0 ? StdDev() / mean : 0;
+        }
+
+        /// Half-width of the 95% confidence interval of the mean (normal approximation)
+        [[nodiscard]] double HalfWidth() const {
+            return count > 1 ? 1.96 * StdDev() / std::sqrt(static_cast<double>(count))
+                             : std::numeric_limits<double>::infinity();
+        }
+
+        /// HalfWidth() relative to the mean
+        [[nodiscard]] double RelativeHalfWidth() const {
+            return mean > 0 ? HalfWidth() / mean : std::numeric_limits<double>::infinity();
+        }
+    };
+
+    /// When a measurement has enough samples: once the confidence interval of the mean is narrow enough,
+    /// or the time budget is spent (but never before minCalls samples)
+    struct PrecisionTarget {
+        /// Target half-width of the 95% confidence interval relative to the mean
+        double relativeHalfWidth = 0.01;
+        double maxSeconds = 10;
+        size_t minCalls = 10;
+        size_t maxCalls = 1000000;
+
+        [[nodiscard]] bool Reached(const RunningStats &stats) const {
+            return stats.count >= minCalls && stats.RelativeHalfWidth() <= relativeHalfWidth;
+        }
+
+        [[nodiscard]] bool Done(const RunningStats &stats, Clock::duration elapsed) const {
+            return Reached(stats) || stats.count >= maxCalls ||
+                   (stats.count >= minCalls && std::chrono::duration<double>(elapsed).count() >= maxSeconds);
+        }
+    };
+
+    struct PreciseMeasurement {
+        LatencyHistogram latency;
+        RunningStats stats;
+        Clock::duration elapsed{};
+        /// The precision target was reached, rather than the time budget
+        bool converged = false;
+    };
+
+    /// Time `call()` back to back until `target` is done, one clock read per call. `between()` runs
+    /// after every call outside of the samples, e.g. to fetch the next input; hardware counters (if
+    /// active) count the calls only.
+    template<typename F, typename G = std::nullptr_t>
+    PreciseMeasurement MeasureUntilPrecise(const PrecisionTarget &target, F &&call, G &&between = nullptr) {
+        PreciseMeasurement result;
+        CountingWindow window;
+        auto start = Clock::now();
+        auto last = start;
+        while (!target.Done(result.stats, last - start)) {
+            call();
+            auto now = Clock::now();
+            auto ns = DurationToNanoseconds(now - last);
+            result.latency.Record(ns);
+            result.stats.Add(static_cast<double>(ns));
+            last = now;
+            if constexpr (!std::is_null_pointer_v<std::decay_t<G>>) {
+                window.Pause();
+                between();
+                window.Resume();
+                last = Clock::now();
+            }
+        }
+        result.elapsed = last - start;
+        result.converged = target.Reached(result.stats);
+        return result;
+    }
+
+    struct WarmUpResult {
+        size_t calls = 0;
+        double cv = 0;
+        bool stable = false;
+    };
+
+    /// Call `call()` until the coefficient of variation of the last `window` latencies drops below
+    /// `targetCv`, or `maxSeconds` have passed.
+    template<typename F>
+    WarmUpResult WarmUpUntilStable(double targetCv, double maxSeconds, F &&call, size_t window = 20) {
+        WarmUpResult result;
+        std::vector<double> recent(window);
+        auto start = Clock::now();
+        auto last = start;
+        while (true) {
+            call();
+            auto now = Clock::now();
+            recent[result.calls % window] = static_cast<double>(DurationToNanoseconds(now - last));
+            last = now;
+            ++result.calls;
+            if (result.calls >= window) {
+                RunningStats stats;
+                for (auto x: recent) {
+                    stats.Add(x);
+                }
+                result.cv = stats.Cv();
+                if (result.cv < targetCv) {
+                    result.stable = true;
+                    return result;
+                }
+            }
+            if (std::chrono::duration<double>(now - start).count() >= maxSeconds) {
+                return result;
+            }
+        }
+    }
+
+    struct ClosedLoopResult {
+        LatencyHistogram latency;
+        size_t calls = 0;
+        Clock::duration elapsed{};
+
+        [[nodiscard]] double CallsPerSecond() const {
+            return static_cast<double>(calls) / std::chrono::duration<double>(elapsed).count();
+        }
+    };
+
+    /// Call `call(threadIndex)` back to back on `threads` threads until `seconds` have passed,
+    /// timing every call. The threads are placed as by RunOnThreads.
+    template<typename F>
+    ClosedLoopResult RunClosedLoop(size_t threads, double seconds, F &&call, bool pinned = true) {
+        ConcurrentLatencyHistogram histograms;
+        std::atomic<size_t> calls{0};
+        ClosedLoopResult result;
+        CountingWindow window;
+        auto start = Clock::now();
+        auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+        RunOnThreads(threads, [&](size_t index) {
+            auto &histogram = histograms.Local();
+            size_t localCalls = 0;
+            auto last = Clock::now();
+            while (last < deadline) {
+                call(index);
+                auto now = Clock::now();
+                histogram.Record(DurationToNanoseconds(now - last));
+                last = now;
+                ++localCalls;
+            }
+            calls += localCalls;
+        }, pinned);
+        result.elapsed = Clock::now() - start;
+        result.calls = calls.load();
+        result.latency = histograms.Merge();
+        return result;
+    }
+
+    /// Pin the workers of GetThreadPool() to slots 0, 1, ... of the placement, a no-op without a policy
+    void PinThreadPoolWorkers();
+
+    /// Log min/mean/percentiles/max of the histogram in milliseconds
+    void LogLatency(const LatencyHistogram &histogram, const char *label = "latency per call");
+
+    /// Log the confidence interval of the mean and whether the precision target was reached
+    void LogPrecision(const RunningStats &stats, bool converged);
+}
+
+#endif //TESTPROJECT_BENCHMARK_UTILS_H
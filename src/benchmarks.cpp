@@ -24,42 +24,135 @@
 //
 
 #include "benchmarks.h"
-#include "lockfree-threadpool/src/ThreadPool.h"
+#include "benchmark_utils.h"
 #include "model_wrapper.h"
-#include "lockfree-threadpool/src/MemoryPool/src/MemoryPool.h"
+#include "latency_histogram.h"
+#include "tensor_utils.h"
+#include "dataset.h"
+#include "memory_stats.h"
+#include "cpu_topology.h"
+#include "perf_counters.h"
+#include <algorithm>
+#include <condition_variable>
+#include <iomanip>
+#include <mutex>
 
 namespace OnnxBenchmarks {
-    struct Async {
-        std::atomic<size_t> counter;
-        std::promise<void> promise;
+    void LogLatency(const LatencyHistogram &histogram, const char *label) {
+        auto ms = NanosecondsToMilliseconds;
+        Logging("  ", label, " (", histogram.Count(), " samples): min ", ms(histogram.Min()),
+                "ms, mean ", histogram.Mean() / 1e6,
+                "ms, p50 ", ms(histogram.Percentile(50)),
+                "ms, p90 ", ms(histogram.Percentile(90)),
+                "ms, p99 ", ms(histogram.Percentile(99)),
+                "ms, p99.9 ", ms(histogram.Percentile(99.9)),
+                "ms, max ", ms(histogram.Max()), "ms");
+    }
+
+    void LogPrecision(const RunningStats &stats, bool converged) {
+        Logging("  mean ", stats.mean / 1e6, "ms +- ", stats.HalfWidth() / 1e6, "ms (95% CI, +-",
+                stats.RelativeHalfWidth() * 100, "%) over ", stats.count, " samples",
+                converged ? "" : ", precision target not reached within the time budget");
+    }
 
-        void finish_one() {
-            if (--counter == 0) {
-                promise.set_value();
+    namespace {
+        std::string CountText(double value) {
+            if (value < 0) {
+                return "-";
             }
+            std::ostringstream text;
+            text << std::setprecision(4) << value;
+            return text.str();
         }
 
-        void finish_n(size_t n) {
-            size_t c = counter.fetch_sub(n);
-            if (c == n) {
-                promise.set_value();
+        /// One row per point from `first` on, per input (batch element)
+        void LogHardwareCounts(const std::vector<BenchmarkResult> &results, size_t first) {
+            Logging("Hardware counters per input (timed calls only, '-' where the point has no counted calls):");
+            Logging("  ", std::left, std::setw(36), "point", std::right, std::setw(11), "cycles", std::setw(11),
+                    "instr", std::setw(7), "IPC", std::setw(11), "LLC miss", std::setw(11), "br miss",
+                    std::setw(10), "mem GB/s");
+            for (size_t i = first; i < results.size(); ++i) {
+                const auto &result = results[i];
+                if (i > first && results[i - 1].params == result.params) {
+                    continue;
+                }
+                std::string point;
+                for (const auto &[name, value]: result.params) {
+                    point += (point.empty() ? "" : " ") + name + "=" + value;
+                }
+                auto perInput = result.counters.PerUnit(static_cast<double>(result.BatchSize()));
+                auto bandwidth = result.counters.MemoryBandwidth();
+                Logging("  ", std::left, std::setw(36), point.empty() ? "-" : point, std::right,
+                        std::setw(11), CountText(perInput.cycles), std::setw(11), CountText(perInput.instructions),
+                        std::setw(7), CountText(result.counters.Ipc()), std::setw(11), CountText(perInput.llcMisses),
+                        std::setw(11), CountText(perInput.branchMisses),
+                        std::setw(10), CountText(bandwidth >= 0 ? bandwidth / 1e9 : -1));
             }
         }
-    };
+    }
 
-    using Clock = std::chrono::high_resolution_clock;
+    void PinThreadPoolWorkers() {
+        auto &placement = GetThreadPlacement();
+        if (!placement.Enabled()) {
+            return;
+        }
+        // the pool does not expose its threads: every task holds its worker until all tasks have started
+        // (or briefly, should the pool be smaller), so that each worker pins itself exactly once
+        const size_t workers = std::thread::hardware_concurrency();
+        std::mutex mutex;
+        std::condition_variable condition;
+        size_t started = 0;
+        Async async;
+        async.counter = workers;
+        for (size_t i = 0; i < workers; ++i) {
+            GetThreadPool().push_task([&]() {
+                size_t slot;
+                {
+                    std::lock_guard lock(mutex);
+                    slot = started++;
+                }
+                condition.notify_all();
+                placement.PinCurrentThread(slot);
+                {
+                    std::unique_lock lock(mutex);
+                    condition.wait_for(lock, std::chrono::milliseconds(100), [&] { return started == workers; });
+                }
+                async.finish_one();
+            });
+        }
+        async.promise.get_future().wait();
+    }
 
-    auto DurationToMilliseconds(const Clock::duration &duration) {
-        return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+    BenchMark::BenchMark(OnnxModel *inModel, BenchmarkOptions inOptions) : model(inModel),
+                                                                          options(std::move(inOptions)) {
+        model->RegisterBenchmark(this);
     }
 
-    inline auto &GetThreadPool() {
-        static Antares::ThreadPool pool;
-        return pool;
+    BenchMark::~BenchMark() = default;
+
+    void BenchMark::FillInput(void *buffer, size_t batch) {
+        if (dataset && dataset->SampleBytes() == model->GetInputDataSize()) {
+            dataset->CopyBatch(datasetCursor, batch, model->GetInputBufferSizes(), model->GetInputBufferStrides(),
+                               static_cast<std::byte *>(buffer));
+            datasetCursor = (datasetCursor + batch) % dataset->Size();
+        } else {
+            FillRandomInput(*model, buffer, batch, options.intRange);
+        }
     }
 
-    BenchMark::BenchMark(OnnxModel *inModel) : model(inModel) {
-        model->RegisterBenchmark(this);
+    PrecisionTarget BenchMark::MeasurementTarget() const {
+        PrecisionTarget target;
+        target.relativeHalfWidth = options.precision;
+        target.maxSeconds = options.measureMaxSeconds;
+        return target;
+    }
+
+    void BenchMark::WarmUpBatch(void *inBuffer, void *outBuffer, size_t batch) {
+        auto result = WarmUpUntilStable(options.warmupCv, options.warmupMaxSeconds, [&] {
+            model->Run(inBuffer, outBuffer, static_cast<int64_t>(batch));
+        });
+        Logging("Warmed up batchNum = ", batch, " in ", result.calls, " calls, cv ", result.cv,
+                result.stable ? "" : " (not stable within the time limit)");
     }
 
     void BenchMark::Run_SingleThreadBenchmark() {
@@ -68,35 +161,47 @@ namespace OnnxBenchmarks {
 
         const bool isBatchSupported = model->IsBatchSupported();
 
-        static constexpr size_t MaxRunRepeatTimes = 1000;
-
         auto testInBatch = [this, inArraySize, outArraySize](size_t batch) mutable {
             Logging("Testing batchNum = ", batch, "...");
             {
-                auto testArray = Antares::MemoryPool::NewArray<float>(inArraySize * batch);
-                for (size_t i = 0; i < inArraySize * batch; i++) {
-                    testArray[i] = RandomNumber<float>(10000) / 5000.f - 1.f;
-                }
-                auto testOutArray = Antares::MemoryPool::NewArray<float>(outArraySize * batch);
-                auto RunRepeatTimes = MaxRunRepeatTimes;
-                while (batch * RunRepeatTimes > 10 * MaxRunRepeatTimes) {
-                    RunRepeatTimes /= 2;
+                TensorBuffer testArray(inArraySize * batch);
+                FillInput(testArray.Data(), batch);
+                TensorBuffer testOutArray(outArraySize * batch);
+
+                // stream a fresh batch per call from the dataset, read ahead by a background thread
+                std::unique_ptr<DatasetPrefetcher> prefetcher;
+                if (dataset && dataset->SampleBytes() == model->GetInputDataSize()) {
+                    prefetcher = std::make_unique<DatasetPrefetcher>(*dataset, model->GetInputBufferSizes(),
+                                                                     model->GetInputBufferStrides(), batch,
+                                                                     options.prefetchDepth);
                 }
-                Clock::duration t_duration;
-                {
-                    ClockGuard guard(t_duration);
-
-                    for (size_t i = 0; i < RunRepeatTimes; i++) {
-                        model->Run(testArray, testOutArray, static_cast<int64_t>(batch));
-                    }
-                }
-                auto elapsed = DurationToMilliseconds(t_duration);
+                // ORT only reads inputs, so the read-only mapped samples can be passed in place
+                auto nextInput = [&]() -> void * {
+                    return prefetcher ? const_cast<std::byte *>(prefetcher->Next()) : testArray.Data();
+                };
+
+                void *input = nextInput();
+                WarmUpBatch(input, testOutArray.Data(), batch);
+
+                // one clock read per call: each sample spans from the end of the previous call,
+                // fetching the next dataset batch is kept out of the samples
+                auto runOne = [&] { model->Run(input, testOutArray.Data(), static_cast<int64_t>(batch)); };
+                auto measurement = prefetcher
+                                   ? MeasureUntilPrecise(MeasurementTarget(), runOne, [&] { input = nextInput(); })
+                                   : MeasureUntilPrecise(MeasurementTarget(), runOne);
+                const auto &histogram = measurement.latency;
+                auto RunRepeatTimes = histogram.Count();
+                auto elapsed = DurationToMilliseconds(measurement.elapsed);
                 auto avgElapsed = static_cast<double>(elapsed) / static_cast<double>(RunRepeatTimes);
                 auto avgEachInput = avgElapsed / static_cast<double>(batch);
 
                 Logging("BatchNum = ", batch, " finished, repeated: ", RunRepeatTimes, " times, time elapsed: ",
                         elapsed, "ms, average time: ",
                         avgElapsed, "ms, average per input: ", avgEachInput, "ms");
+                LogLatency(histogram);
+                LogPrecision(measurement.stats, measurement.converged);
+                report.Add({"single", {{"batch", std::to_string(batch)}}, "latency per call", histogram,
+                            static_cast<double>(batch) / avgElapsed * 1e3, measurement.stats.RelativeHalfWidth()});
             }
         };
 
@@ -120,7 +225,8 @@ namespace OnnxBenchmarks {
 
         const bool isBatchSupported = model->IsBatchSupported();
 
-        static constexpr size_t RunRepeatTimes = 10;
+        // a loop pushes all tasks at once, so fewer samples than calls are needed
+        static constexpr size_t MinRunRepeatTimes = 3;
         static const size_t MaxTotalTaskPerRun = 100 * std::thread::hardware_concurrency();
 
         auto testInBatch = [this, inArraySize, outArraySize](size_t batch) mutable {
@@ -130,34 +236,46 @@ namespace OnnxBenchmarks {
                 TotalTaskPerRun /= 2;
             }
 
-            auto testArray = Antares::MemoryPool::NewArray<float>(inArraySize * batch * TotalTaskPerRun);
-            for (size_t i = 0; i < inArraySize * batch * TotalTaskPerRun; i++) {
-                testArray[i] = RandomNumber<float>(10000) / 5000.f - 1.f;
+            TensorBuffer testArray(inArraySize * batch * TotalTaskPerRun);
+            for (size_t i = 0; i < TotalTaskPerRun; i++) {
+                FillInput(testArray.Data(inArraySize * batch * i), batch);
             }
-            auto testOutArray = Antares::MemoryPool::NewArray<float>(outArraySize * batch * TotalTaskPerRun);
-
-            Clock::duration t_duration;
-            {
-                ClockGuard guard(t_duration);
-
-                for (size_t _ = 0; _ < RunRepeatTimes; _++) {
-                    Async async;
-                    async.counter = TotalTaskPerRun;
-                    float *inArray = testArray;
-                    float *outArray = testOutArray;
-
-                    for (size_t i = 0; i < TotalTaskPerRun; i++) {
-                        GetThreadPool().push_task(
-                                [this, inArray, outArray, batch, &async]() {
-                                    model->Run(inArray, outArray, static_cast<int64_t>(batch));
-                                    async.finish_one();
-                                });
-                        inArray += inArraySize * batch;
-                        outArray += outArraySize * batch;
-                    }
-                    async.promise.get_future().wait();
+            TensorBuffer testOutArray(outArraySize * batch * TotalTaskPerRun);
+
+            ConcurrentLatencyHistogram histograms;
+            bool recording = false;
+            auto runLoop = [&]() {
+                Async async;
+                async.counter = TotalTaskPerRun;
+                std::byte *inArray = testArray.Data();
+                std::byte *outArray = testOutArray.Data();
+
+                for (size_t i = 0; i < TotalTaskPerRun; i++) {
+                    GetThreadPool().push_task(
+                            [this, inArray, outArray, batch, recording, &async, &histograms]() {
+                                auto start = Clock::now();
+                                model->Run(inArray, outArray, static_cast<int64_t>(batch));
+                                if (recording) {
+                                    histograms.Local().Record(DurationToNanoseconds(Clock::now() - start));
+                                }
+                                async.finish_one();
+                            });
+                    inArray += inArraySize * batch;
+                    outArray += outArraySize * batch;
                 }
-            }
+                async.promise.get_future().wait();
+            };
+
+            // every pool thread sees the batch shape before timing, loops stabilize within a few
+            auto warmUp = WarmUpUntilStable(options.warmupCv, options.warmupMaxSeconds, runLoop, MinRunRepeatTimes);
+            Logging("Warmed up in ", warmUp.calls, " loops, cv ", warmUp.cv, warmUp.stable ? "" : " (not stable)");
+
+            recording = true;
+            auto target = MeasurementTarget();
+            target.minCalls = MinRunRepeatTimes;
+            auto measurement = MeasureUntilPrecise(target, runLoop);
+            auto RunRepeatTimes = static_cast<double>(measurement.stats.count);
+            auto t_duration = measurement.elapsed;
 
             auto elapsed = DurationToMilliseconds(t_duration);
             auto avgElapsed = static_cast<double>(elapsed) / RunRepeatTimes;
@@ -168,6 +286,11 @@ namespace OnnxBenchmarks {
                     TotalTaskPerRun, ", time elapsed: ",
                     elapsed, "ms, average time per loop: ",
                     avgElapsed, "ms, average per task: ", avgEachTask, "ms, average per input: ", avgEachInput, "ms");
+            auto latency = histograms.Merge();
+            LogLatency(latency);
+            LogPrecision(measurement.stats, measurement.converged);
+            report.Add({"multi", {{"batch", std::to_string(batch)}}, "latency per call", latency,
+                        static_cast<double>(batch) / avgEachTask * 1e3, measurement.stats.RelativeHalfWidth()});
         };
 
         testInBatch(1);
@@ -186,17 +309,23 @@ namespace OnnxBenchmarks {
 
     void BenchMark::PrintModelInfo() {
         Logging("Model info:");
-        Logging("  Model input: ", model->GetInputNums(), " inputs: ", model->GetInputBufferSize(), " elements");
-        Logging("  Model output: ", model->GetOutputNums(), " outputs: ", model->GetOutputBufferSize(), " elements");
+        Logging("  Model input: ", model->GetInputNums(), " inputs: ", model->GetInputBufferSize(), " bytes");
+        Logging("  Model output: ", model->GetOutputNums(), " outputs: ", model->GetOutputBufferSize(), " bytes");
         Logging("  Model batch supported: ", model->IsBatchSupported() ? "true" : "false");
-        Logging("  Input names:");
-        for (const auto &name: model->GetInputNames()) {
-            Logging("    ", name);
-        }
-        Logging("  Output names:");
-        for (const auto &name: model->GetOutputNames()) {
-            Logging("    ", name);
-        }
+
+        auto printTensors = [](const auto &names, const auto &types, const auto &dims) {
+            for (size_t i = 0; i < names.size(); ++i) {
+                std::string shape;
+                for (auto dim: dims[i]) {
+                    shape += (shape.empty() ? "" : "x") + std::to_string(dim);
+                }
+                Logging("    ", names[i], ": ", ElementTypeName(types[i]), "[", shape, "]");
+            }
+        };
+        Logging("  Inputs:");
+        printTensors(model->GetInputNames(), model->GetInputTypes(), model->GetInputDims());
+        Logging("  Outputs:");
+        printTensors(model->GetOutputNames(), model->GetOutputTypes(), model->GetOutputDims());
     }
 
     void BenchMark::WarmUp() {
@@ -205,47 +334,181 @@ namespace OnnxBenchmarks {
         size_t inArraySize = model->GetInputBufferSize();
         size_t outArraySize = model->GetOutputBufferSize();
 
-        auto testArray = Antares::MemoryPool::NewArray<float>(inArraySize);
-        for (size_t i = 0; i < inArraySize; i++) {
-            testArray[i] = RandomNumber<float>(10000) / 5000.f - 1.f;
-        }
-        auto testOutArray = Antares::MemoryPool::NewArray<float>(outArraySize);
+        TensorBuffer testArray(inArraySize);
+        FillInput(testArray.Data(), 1);
+        TensorBuffer testOutArray(outArraySize);
 
-        for (size_t i = 0; i < 1000; i++) {
-            model->Run(testArray, testOutArray, 1);
-        }
+        WarmUpBatch(testArray.Data(), testOutArray.Data(), 1);
 
         Logging("Warm up finished");
-
-        Antares::MemoryPool::DeleteArray(testArray, inArraySize);
-        Antares::MemoryPool::DeleteArray(testOutArray, outArraySize);
     }
 
-    void BenchMark::RunBenchmark() {
+    int BenchMark::RunBenchmark() {
         if (model == nullptr) {
             throw std::runtime_error("Model is not initialized");
         }
         static_cast<void>(GetThreadPool());
 
+        const auto &placement = GetThreadPlacement();
+        if (placement.Enabled()) {
+            const auto &topology = placement.Topology();
+            Logging("Pinning threads over ", topology.Cpus().size(), " CPUs (", topology.PhysicalCoreCount(),
+                    " cores, ", topology.Nodes().size(), " NUMA nodes)");
+            PinThreadPoolWorkers();
+            // the main thread is the caller of the single-threaded scenarios
+            placement.PinCurrentThread(0);
+        }
+
+        if (!options.datasetPath.empty()) {
+            // .npy files hold the elements of all inputs when they share a type, their bytes otherwise
+            NpySampleFormat npyFormat{"|u1", model->GetInputDataSize()};
+            const auto &types = model->GetInputTypes();
+            if (std::all_of(types.begin(), types.end(), [&](auto type) { return type == types.front(); }) &&
+                NpyDescr(types.front()) != nullptr) {
+                npyFormat.descr = NpyDescr(types.front());
+                npyFormat.elements = 0;
+                for (auto count: model->GetInputElementCounts()) {
+                    npyFormat.elements += count;
+                }
+            }
+            dataset = std::make_unique<Dataset>(options.datasetPath, model->GetInputDataSize(), npyFormat);
+            Logging("Dataset ", options.datasetPath, ": ", dataset->Size(), " samples of ", dataset->SampleBytes(),
+                    " bytes");
+        }
+
         // testing single thread
-        auto benchmark_runner = [this](auto task, const char *taskname)mutable {
+        auto countersWanted = [this](const char *name) {
+            const auto &wanted = options.perfCounterScenarios;
+            return std::find(wanted.begin(), wanted.end(), "all") != wanted.end() ||
+                   std::find(wanted.begin(), wanted.end(), name) != wanted.end();
+        };
+        auto benchmark_runner = [this, &countersWanted](auto task, const char *taskname, const char *name)mutable {
+            ResetPeakRss();
+            // opened per scenario, so the threads the earlier scenarios left running are counted too
+            std::unique_ptr<PerfCounters> counters;
+            if (countersWanted(name)) {
+                counters = std::make_unique<PerfCounters>();
+                if (counters->Available()) {
+                    for (const auto &reason: counters->Missing()) {
+                        Warning("Hardware counter unavailable, ", reason);
+                    }
+                    report.CountHardwareEvents(counters.get());
+                    ActivePerfCounters() = counters.get();
+                } else {
+                    Warning("No hardware counters for ", name, ", ", counters->Missing().front());
+                    counters.reset();
+                }
+            }
+            auto firstResult = report.Results().size();
             Clock::duration duration;
             {
                 ClockGuard guard(duration);
                 (this->*task)();
             }
             Logging(taskname, " finished, time elapsed: ", DurationToMilliseconds(duration), "ms");
+            if (counters) {
+                ActivePerfCounters() = nullptr;
+                report.CountHardwareEvents(nullptr);
+                if (report.Results().size() > firstResult) {
+                    LogHardwareCounts(report.Results(), firstResult);
+                }
+            }
         };
 
-#define ONNX_BENCHMARK_RUN(task) benchmark_runner(&BenchMark::Run_##task, #task)
+        struct Scenario {
+            const char *name;
+            void (BenchMark::*task)();
+            const char *taskname;
+        };
+
+#define ONNX_BENCHMARK_SCENARIO(name, task) Scenario{name, &BenchMark::Run_##task, #task}
+
+        static const Scenario scenarioTable[] = {
+                ONNX_BENCHMARK_SCENARIO("single", SingleThreadBenchmark),
+                ONNX_BENCHMARK_SCENARIO("multi", MultiThreadBenchmark),
+                ONNX_BENCHMARK_SCENARIO("openloop", OpenLoopBenchmark),
+                ONNX_BENCHMARK_SCENARIO("batcher", DynamicBatchingBenchmark),
+                ONNX_BENCHMARK_SCENARIO("sessionpool", SessionPoolBenchmark),
+                ONNX_BENCHMARK_SCENARIO("prepared", PreparedRunBenchmark),
+                ONNX_BENCHMARK_SCENARIO("shapes", ShapeSweepBenchmark),
+                ONNX_BENCHMARK_SCENARIO("startup", StartupBenchmark),
+                ONNX_BENCHMARK_SCENARIO("profile", ProfileBenchmark),
+                ONNX_BENCHMARK_SCENARIO("memory", MemoryBenchmark),
+                ONNX_BENCHMARK_SCENARIO("numa", NumaReplicaBenchmark),
+                ONNX_BENCHMARK_SCENARIO("mix", ModelMixBenchmark),
+                ONNX_BENCHMARK_SCENARIO("matrix", ConfigMatrixBenchmark),
+                ONNX_BENCHMARK_SCENARIO("async", AsyncRunBenchmark),
+                ONNX_BENCHMARK_SCENARIO("outputs", OutputSubsetBenchmark),
+                ONNX_BENCHMARK_SCENARIO("serve", IpcServeBenchmark),
+                ONNX_BENCHMARK_SCENARIO("client", IpcClientBenchmark),
+                ONNX_BENCHMARK_SCENARIO("preprocess", PreprocessBenchmark),
+                ONNX_BENCHMARK_SCENARIO("slo", SloSearchBenchmark),
+                ONNX_BENCHMARK_SCENARIO("scaling", ThreadScalingBenchmark),
+                ONNX_BENCHMARK_SCENARIO("cache", CacheStateBenchmark),
+                ONNX_BENCHMARK_SCENARIO("decode", StatefulDecodeBenchmark),
+        };
+
+#undef ONNX_BENCHMARK_SCENARIO
+
+        std::vector<const Scenario *> selected;
+        for (const auto &name: options.scenarios) {
+            auto it = std::find_if(std::begin(scenarioTable), std::end(scenarioTable),
+                                   [&name](const Scenario &scenario) { return name == scenario.name; });
+            if (it == std::end(scenarioTable)) {
+                throw std::invalid_argument("Unknown scenario: " + name);
+            }
+            selected.emplace_back(it);
+        }
 
         PrintModelInfo();
 
         WarmUp();
 
-        ONNX_BENCHMARK_RUN(SingleThreadBenchmark);
-        ONNX_BENCHMARK_RUN(MultiThreadBenchmark);
+        auto &metadata = report.Metadata();
+        metadata["model"] = options.modelPath;
+        metadata["onnxruntime"] = Ort::GetVersionString();
+        auto describeTensors = [](const auto &names, const auto &types, const auto &dims) {
+            JsonValue tensors = JsonValue::Array{};
+            for (size_t i = 0; i < names.size(); ++i) {
+                auto &tensor = tensors.Push(JsonValue::Object{});
+                tensor["name"] = names[i];
+                tensor["type"] = ElementTypeName(types[i]);
+                auto &shape = tensor["shape"] = JsonValue::Array{};
+                for (auto dim: dims[i]) {
+                    shape.Push(dim);
+                }
+            }
+            return tensors;
+        };
+        metadata["inputs"] = describeTensors(model->GetInputNames(), model->GetInputTypes(), model->GetInputDims());
+        metadata["outputs"] = describeTensors(model->GetOutputNames(), model->GetOutputTypes(),
+                                              model->GetOutputDims());
+        metadata["host"] = HostMetadata();
+        metadata["topology"] = placement.ToJson();
+        auto &scenarios = metadata["scenarios"] = JsonValue::Array{};
+        for (const auto &name: options.scenarios) {
+            scenarios.Push(name);
+        }
+        metadata["dataset"] = options.datasetPath;
+
+        for (auto scenario: selected) {
+            benchmark_runner(scenario->task, scenario->taskname, scenario->name);
+        }
 
-#undef ONNX_BENCHMARK_RUN
+        if (!options.jsonPath.empty()) {
+            report.WriteJson(options.jsonPath);
+            Logging("Results written to ", options.jsonPath);
+        }
+        if (!options.csvPath.empty()) {
+            report.WriteCsv(options.csvPath);
+            Logging("Results written to ", options.csvPath);
+        }
+        if (!options.comparePath.empty()) {
+            auto baseline = ResultsReport::LoadJson(options.comparePath);
+            if (CompareResults(baseline, report, options.regressionThreshold, options.significance) > 0) {
+                return 2;
+            }
+        }
+        return 0;
     }
 }
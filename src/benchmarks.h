@@ -28,10 +28,17 @@
 
 #include <iostream>
 #include <chrono>
+#include <memory>
+#include "options.h"
+#include "results.h"
 
 namespace OnnxBenchmarks {
     class OnnxModel;
 
+    class Dataset;
+
+    struct PrecisionTarget;
+
     template<typename ...T>
     void Logging(T &&... args) {
         (std::cout << ... << args) << std::endl;
@@ -79,22 +86,81 @@ namespace OnnxBenchmarks {
 
     private:
         OnnxModel *model = nullptr;
+        BenchmarkOptions options;
+        std::unique_ptr<Dataset> dataset;
+        /// Next dataset sample handed out by FillInput
+        size_t datasetCursor = 0;
+        /// Every scenario adds its measurement points, written out by RunBenchmark
+        ResultsReport report;
 
     public:
-        explicit BenchMark(OnnxModel *inModel);
+        explicit BenchMark(OnnxModel *inModel, BenchmarkOptions inOptions = {});
 
-        ~BenchMark() = default;
+        ~BenchMark();
 
         void PrintModelInfo();
 
-        void RunBenchmark();
+        /// Run the selected scenarios, returns the process exit code (2 when the baseline comparison
+        /// found regressions)
+        int RunBenchmark();
 
     private:
-            void WarmUp();
+        void WarmUp();
+
+        /// Run `batch`-sized calls until their latency is stable, every batch shape needs its own warm-up
+        /// (the arena grows, kernels pick their algorithms).
+        void WarmUpBatch(void *inBuffer, void *outBuffer, size_t batch);
+
+        /// When a measurement may stop, from the precision options
+        [[nodiscard]] PrecisionTarget MeasurementTarget() const;
+
+        /// Fill a batched input buffer from the dataset, or with random data if there is none
+        /// (or its samples do not fit the current input shapes).
+        void FillInput(void *buffer, size_t batch);
 
         void Run_SingleThreadBenchmark();
 
         void Run_MultiThreadBenchmark();
+
+        void Run_OpenLoopBenchmark();
+
+        void Run_DynamicBatchingBenchmark();
+
+        void Run_SessionPoolBenchmark();
+
+        void Run_PreparedRunBenchmark();
+
+        void Run_ShapeSweepBenchmark();
+
+        void Run_StartupBenchmark();
+
+        void Run_ProfileBenchmark();
+
+        void Run_MemoryBenchmark();
+
+        void Run_NumaReplicaBenchmark();
+
+        void Run_ModelMixBenchmark();
+
+        void Run_ConfigMatrixBenchmark();
+
+        void Run_AsyncRunBenchmark();
+
+        void Run_OutputSubsetBenchmark();
+
+        void Run_IpcServeBenchmark();
+
+        void Run_IpcClientBenchmark();
+
+        void Run_PreprocessBenchmark();
+
+        void Run_SloSearchBenchmark();
+
+        void Run_ThreadScalingBenchmark();
+
+        void Run_CacheStateBenchmark();
+
+        void Run_StatefulDecodeBenchmark();
     };
 
 
@@ -0,0 +1,206 @@
+//
+// Created by antares on 5/4/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "config_matrix.h"
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+namespace OnnxBenchmarks {
+    namespace {
+        std::vector<std::string> Split(const std::string &str, char delimiter) {
+            std::vector<std::string> answer;
+            size_t begin = 0;
+            while (begin <= str.size()) {
+                auto end = std::min(str.find(delimiter, begin), str.size());
+                if (end > begin) {
+                    answer.emplace_back(str.substr(begin, end - begin));
+                }
+                begin = end + 1;
+            }
+            return answer;
+        }
+
+        std::string Label(const JsonValue &value) {
+            if (value.IsString()) {
+                return value.AsString();
+            }
+            if (value.IsBool()) {
+                return value.AsBool() ? "on" : "off";
+            }
+            if (value.IsNumber()) {
+                auto number = value.AsNumber();
+                return number == static_cast<double>(static_cast<int64_t>(number))
+                       ? std::to_string(static_cast<int64_t>(number)) : std::to_string(number);
+            }
+            throw std::invalid_argument("Expect a string, number or boolean in the config matrix");
+        }
+
+        bool Switch(const std::string &axis, const JsonValue &value) {
+            auto label = Label(value);
+            if (label == "on" || label == "true" || label == "1") {
+                return true;
+            }
+            if (label == "off" || label == "false" || label == "0") {
+                return false;
+            }
+            throw std::invalid_argument("Expect on/off for " + axis + ": " + label);
+        }
+
+        int Threads(const std::string &axis, const JsonValue &value) {
+            auto label = Label(value);
+            size_t pos = 0;
+            int threads = -1;
+            try {
+                threads = std::stoi(label, &pos);
+            } catch (const std::exception &) {
+                pos = 0;
+            }
+            if (pos == 0 || pos != label.size() || threads < 0) {
+                throw std::invalid_argument("Expect a thread count for " + axis + ": " + label);
+            }
+            return threads;
+        }
+
+        /// Set the axis in `config`, returns the label of the value
+        std::string ApplyAxis(const std::string &axis, const JsonValue &value, SessionConfig &config) {
+            if (axis == "optimization") {
+                static const std::pair<const char *, GraphOptimizationLevel> levels[] = {
+                        {"disable",  ORT_DISABLE_ALL},
+                        {"basic",    ORT_ENABLE_BASIC},
+                        {"extended", ORT_ENABLE_EXTENDED},
+                        {"all",      ORT_ENABLE_ALL},
+                };
+                auto label = Label(value);
+                auto it = std::find_if(std::begin(levels), std::end(levels),
+                                       [&label](const auto &level) { return label == level.first; });
+                if (it == std::end(levels)) {
+                    throw std::invalid_argument("Unknown optimization level: " + label);
+                }
+                config.optimizationLevel = it->second;
+                return label;
+            }
+            if (axis == "execution_mode") {
+                auto label = Label(value);
+                if (label == "sequential") {
+                    config.executionMode = ORT_SEQUENTIAL;
+                } else if (label == "parallel") {
+                    config.executionMode = ORT_PARALLEL;
+                } else {
+                    throw std::invalid_argument("Unknown execution mode: " + label);
+                }
+                return label;
+            }
+            if (axis == "intra_threads") {
+                config.intraOpThreads = Threads(axis, value);
+                return std::to_string(config.intraOpThreads);
+            }
+            if (axis == "inter_threads") {
+                config.interOpThreads = Threads(axis, value);
+                return std::to_string(config.interOpThreads);
+            }
+            if (axis == "spinning") {
+                config.allowSpinning = Switch(axis, value) ? 1 : 0;
+                return config.allowSpinning ? "on" : "off";
+            }
+            if (axis == "denormal_as_zero") {
+                config.denormalAsZero = Switch(axis, value);
+                return config.denormalAsZero ? "on" : "off";
+            }
+            if (axis == "provider") {
+                std::string label;
+                if (value.IsObject()) {
+                    config.executionProvider = value.At("name").AsString();
+                    label = config.executionProvider;
+                    if (auto options = value.Find("options")) {
+                        for (const auto &[key, option]: options->AsObject()) {
+                            config.providerOptions[key] = Label(option);
+                            label += (label == config.executionProvider ? ":" : ",") + key + "=" + Label(option);
+                        }
+                    }
+                } else {
+                    config.executionProvider = label = Label(value);
+                }
+                static const char *providers[] = {"cpu", "xnnpack", "dnnl", "openvino"};
+                if (std::find(std::begin(providers), std::end(providers), config.executionProvider) ==
+                    std::end(providers)) {
+                    throw std::invalid_argument("Unknown execution provider: " + config.executionProvider);
+                }
+                return label;
+            }
+            throw std::invalid_argument("Unknown config matrix axis: " + axis);
+        }
+    }
+
+    JsonValue LoadConfigMatrix(const std::string &fileOrSpec) {
+        if (std::filesystem::exists(fileOrSpec) || fileOrSpec.find('=') == std::string::npos) {
+            return JsonValue::ParseFile(fileOrSpec);
+        }
+        JsonValue matrix = JsonValue::Object{};
+        for (const auto &axis: Split(fileOrSpec, ';')) {
+            auto eq = axis.find('=');
+            if (eq == std::string::npos || eq == 0) {
+                throw std::invalid_argument("Expect AXIS=VALUE,... in the config matrix: " + axis);
+            }
+            auto &values = matrix[axis.substr(0, eq)] = JsonValue::Array{};
+            for (const auto &value: Split(axis.substr(eq + 1), ',')) {
+                values.Push(value);
+            }
+        }
+        return matrix;
+    }
+
+    std::vector<MatrixCell> ExpandConfigMatrix(const JsonValue &matrix, const SessionConfig &base) {
+        if (!matrix.IsObject()) {
+            throw std::invalid_argument("The config matrix must be an object of axes");
+        }
+        std::vector<std::pair<std::string, JsonValue::Array>> axes;
+        for (const auto &[name, values]: matrix.AsObject()) {
+            auto &axis = axes.emplace_back(name, values.IsArray() ? values.AsArray() : JsonValue::Array{values});
+            if (axis.second.empty()) {
+                throw std::invalid_argument("No values for config matrix axis: " + name);
+            }
+        }
+
+        std::vector<MatrixCell> cells;
+        std::vector<size_t> index(axes.size());
+        while (true) {
+            auto &cell = cells.emplace_back(MatrixCell{{}, base});
+            for (size_t i = 0; i < axes.size(); ++i) {
+                const auto &[name, values] = axes[i];
+                cell.params.emplace_back(name, ApplyAxis(name, values[index[i]], cell.config));
+            }
+
+            // odometer over the axes, the last one fastest
+            size_t i = axes.size();
+            while (i > 0 && ++index[i - 1] == axes[i - 1].second.size()) {
+                index[--i] = 0;
+            }
+            if (i == 0) {
+                return cells;
+            }
+        }
+    }
+}
@@ -0,0 +1,59 @@
+//
+// Created by antares on 5/4/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_CONFIG_MATRIX_H
+#define TESTPROJECT_CONFIG_MATRIX_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "json.h"
+#include "model_wrapper.h"
+
+namespace OnnxBenchmarks {
+    /// One combination of session options of a configuration matrix
+    struct MatrixCell {
+        /// Axis name and value label of every axis, in the order of the matrix
+        std::vector<std::pair<std::string, std::string>> params;
+        SessionConfig config;
+    };
+
+    /// A matrix is an object of axes, each a value or an array of values:
+    ///   optimization      disable, basic, extended, all
+    ///   execution_mode    sequential, parallel
+    ///   intra_threads     thread count, 0 for hardware concurrency
+    ///   inter_threads     thread count, 0 for hardware concurrency
+    ///   spinning          on, off (or true, false)
+    ///   denormal_as_zero  on, off (or true, false)
+    ///   provider          cpu, xnnpack, dnnl, openvino, or {"name": ..., "options": {...}}
+    /// Read from a JSON file, or given inline as `axis=a,b;axis=c`.
+    JsonValue LoadConfigMatrix(const std::string &fileOrSpec);
+
+    /// Every combination of the axis values, the last axis varying fastest, each applied to a copy of
+    /// `base`. Throws std::invalid_argument on unknown axes or values.
+    std::vector<MatrixCell> ExpandConfigMatrix(const JsonValue &matrix, const SessionConfig &base = {});
+}
+
+#endif //TESTPROJECT_CONFIG_MATRIX_H
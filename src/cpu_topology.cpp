@@ -0,0 +1,417 @@
+//
+// Created by antares on 4/30/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "cpu_topology.h"
+#include "benchmarks.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <new>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace OnnxBenchmarks {
+    namespace {
+        int ReadInt(const std::string &path, int fallback) {
+            std::ifstream file(path);
+            int value;
+            return file >> value ? value : fallback;
+        }
+
+        /// "0-3,8-11" -> {0, 1, 2, 3, 8, 9, 10, 11}
+        std::vector<int> ParseCpuList(const std::string &list) {
+            std::vector<int> answer;
+            size_t begin = 0;
+            while (begin < list.size()) {
+                auto end = list.find(',', begin);
+                if (end == std::string::npos) {
+                    end = list.size();
+                }
+                auto item = list.substr(begin, end - begin);
+                int first, last;
+                if (std::sscanf(item.c_str(), "%d-%d", &first, &last) == 2) {
+                    for (int cpu = first; cpu <= last; ++cpu) {
+                        answer.emplace_back(cpu);
+                    }
+                } else if (std::sscanf(item.c_str(), "%d", &first) == 1) {
+                    answer.emplace_back(first);
+                }
+                begin = end + 1;
+            }
+            return answer;
+        }
+
+        const char *PlacementPolicyName(PlacementPolicy policy) {
+            switch (policy) {
+                case PlacementPolicy::None:
+                    return "none";
+                case PlacementPolicy::Compact:
+                    return "compact";
+                case PlacementPolicy::Scatter:
+                    return "scatter";
+                case PlacementPolicy::Numa:
+                    return "numa";
+            }
+            return "unknown";
+        }
+    }
+
+    CpuTopology CpuTopology::Detect() {
+        namespace fs = std::filesystem;
+
+        std::map<int, int> nodeOfCpu;
+        std::error_code error;
+        for (const auto &entry: fs::directory_iterator("/sys/devices/system/node", error)) {
+            auto name = entry.path().filename().string();
+            int node;
+            if (std::sscanf(name.c_str(), "node%d", &node) != 1) {
+                continue;
+            }
+            std::ifstream file(entry.path() / "cpulist");
+            std::string list;
+            std::getline(file, list);
+            for (auto cpu: ParseCpuList(list)) {
+                nodeOfCpu[cpu] = node;
+            }
+        }
+
+        CpuTopology topology;
+        for (auto id: CurrentThreadAffinity()) {
+            auto base = "/sys/devices/system/cpu/cpu" + std::to_string(id) + "/topology/";
+            auto node = nodeOfCpu.find(id);
+            topology.cpus.emplace_back(LogicalCpu{id, ReadInt(base + "physical_package_id", 0),
+                                                  ReadInt(base + "core_id", id),
+                                                  node == nodeOfCpu.end() ? 0 : node->second});
+        }
+        return topology;
+    }
+
+    std::vector<int> CpuTopology::Nodes() const {
+        std::set<int> nodes;
+        for (const auto &cpu: cpus) {
+            nodes.emplace(cpu.node);
+        }
+        return {nodes.begin(), nodes.end()};
+    }
+
+    std::vector<int> CpuTopology::CpusOfNode(int node) const {
+        std::vector<int> answer;
+        for (const auto &cpu: cpus) {
+            if (cpu.node == node) {
+                answer.emplace_back(cpu.id);
+            }
+        }
+        return answer;
+    }
+
+    size_t CpuTopology::PhysicalCoreCount() const {
+        std::set<std::pair<int, int>> cores;
+        for (const auto &cpu: cpus) {
+            cores.emplace(cpu.package, cpu.core);
+        }
+        return cores.size();
+    }
+
+    std::vector<int> CpuTopology::Order(PlacementPolicy policy) const {
+        auto sorted = cpus;
+        std::sort(sorted.begin(), sorted.end(), [](const LogicalCpu &a, const LogicalCpu &b) {
+            return std::tie(a.node, a.package, a.core, a.id) < std::tie(b.node, b.package, b.core, b.id);
+        });
+
+        if (policy == PlacementPolicy::Scatter) {
+            // rank of every CPU among the hyper-threads of its core, of its core within its node, and of its node
+            struct Ranked {
+                size_t thread;
+                size_t core;
+                size_t node;
+                int id;
+            };
+            std::vector<Ranked> ranked;
+            for (size_t i = 0; i < sorted.size(); ++i) {
+                const auto &cpu = sorted[i];
+                if (i == 0) {
+                    ranked.emplace_back(Ranked{0, 0, 0, cpu.id});
+                    continue;
+                }
+                const auto &previous = sorted[i - 1];
+                auto last = ranked.back();
+                if (cpu.node != previous.node) {
+                    ranked.emplace_back(Ranked{0, 0, last.node + 1, cpu.id});
+                } else if (cpu.package != previous.package || cpu.core != previous.core) {
+                    ranked.emplace_back(Ranked{0, last.core + 1, last.node, cpu.id});
+                } else {
+                    ranked.emplace_back(Ranked{last.thread + 1, last.core, last.node, cpu.id});
+                }
+            }
+            std::stable_sort(ranked.begin(), ranked.end(), [](const Ranked &a, const Ranked &b) {
+                return std::tie(a.thread, a.core, a.node) < std::tie(b.thread, b.core, b.node);
+            });
+            std::vector<int> order;
+            for (const auto &cpu: ranked) {
+                order.emplace_back(cpu.id);
+            }
+            return order;
+        }
+
+        std::vector<int> order;
+        for (const auto &cpu: sorted) {
+            order.emplace_back(cpu.id);
+        }
+        return order;
+    }
+
+    JsonValue CpuTopology::ToJson() const {
+        JsonValue json;
+        json["logical_cpus"] = static_cast<uint64_t>(cpus.size());
+        json["physical_cores"] = static_cast<uint64_t>(PhysicalCoreCount());
+        std::set<int> packages;
+        for (const auto &cpu: cpus) {
+            packages.emplace(cpu.package);
+        }
+        json["packages"] = static_cast<uint64_t>(packages.size());
+        auto &nodes = json["nodes"] = JsonValue::Array{};
+        for (auto node: Nodes()) {
+            auto &entry = nodes.Push(JsonValue::Object{});
+            entry["node"] = node;
+            auto &list = entry["cpus"] = JsonValue::Array{};
+            for (auto cpu: CpusOfNode(node)) {
+                list.Push(cpu);
+            }
+        }
+        return json;
+    }
+
+    bool PinCurrentThread(const std::vector<int> &cpus) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (auto cpu: cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        return CPU_COUNT(&set) > 0 && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+
+    std::vector<int> CurrentThreadAffinity() {
+        std::vector<int> answer;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &set)) {
+                    answer.emplace_back(cpu);
+                }
+            }
+        }
+        if (answer.empty()) {
+            for (unsigned cpu = 0; cpu < std::thread::hardware_concurrency(); ++cpu) {
+                answer.emplace_back(static_cast<int>(cpu));
+            }
+        }
+        return answer;
+    }
+
+    std::string IntraOpAffinityString(const std::vector<std::vector<int>> &threadCpus) {
+        std::string answer;
+        for (const auto &cpus: threadCpus) {
+            if (!answer.empty()) {
+                answer += ';';
+            }
+            for (size_t i = 0; i < cpus.size(); ++i) {
+                if (i > 0) {
+                    answer += ',';
+                }
+                answer += std::to_string(cpus[i] + 1);
+            }
+        }
+        return answer;
+    }
+
+    size_t LastLevelCacheBytes() {
+        namespace fs = std::filesystem;
+        static constexpr size_t Fallback = size_t(32) << 20;
+
+        int bestLevel = 0;
+        size_t bestBytes = 0;
+        std::error_code error;
+        for (const auto &entry: fs::directory_iterator("/sys/devices/system/cpu/cpu0/cache", error)) {
+            auto level = ReadInt((entry.path() / "level").string(), 0);
+            std::ifstream file(entry.path() / "size");
+            size_t size;
+            std::string unit;
+            if (level < bestLevel || !(file >> size)) {
+                continue;
+            }
+            // "32768K"
+            file >> unit;
+            if (!unit.empty() && (unit[0] == 'K' || unit[0] == 'M')) {
+                size <<= unit[0] == 'K' ? 10 : 20;
+            }
+            if (level > bestLevel || size > bestBytes) {
+                bestLevel = level;
+                bestBytes = size;
+            }
+        }
+        return bestBytes > 0 ? bestBytes : Fallback;
+    }
+
+    ThreadPlacement::ThreadPlacement(PlacementPolicy inPolicy, CpuTopology inTopology)
+            : policy(inPolicy), topology(std::move(inTopology)) {
+        if (policy != PlacementPolicy::None) {
+            order = topology.Order(policy);
+        }
+    }
+
+    std::vector<int> ThreadPlacement::CpusOfSlot(size_t slot) const {
+        if (!Enabled()) {
+            return {};
+        }
+        if (policy == PlacementPolicy::Numa) {
+            return topology.CpusOfNode(NodeOfSlot(slot));
+        }
+        return {order[slot % order.size()]};
+    }
+
+    int ThreadPlacement::NodeOfSlot(size_t slot) const {
+        if (order.empty()) {
+            return 0;
+        }
+        auto cpu = order[slot % order.size()];
+        const auto &cpus = topology.Cpus();
+        auto it = std::find_if(cpus.begin(), cpus.end(), [cpu](const LogicalCpu &c) { return c.id == cpu; });
+        return it == cpus.end() ? 0 : it->node;
+    }
+
+    void ThreadPlacement::PinCurrentThread(size_t slot) const {
+        if (!Enabled()) {
+            return;
+        }
+        if (!OnnxBenchmarks::PinCurrentThread(CpusOfSlot(slot))) {
+            static std::atomic<bool> warned{false};
+            if (!warned.exchange(true)) {
+                Warning("Can not pin threads to CPUs, running unpinned");
+            }
+        }
+    }
+
+    void ThreadPlacement::UnpinCurrentThread() const {
+        if (!Enabled()) {
+            return;
+        }
+        std::vector<int> all;
+        for (const auto &cpu: topology.Cpus()) {
+            all.emplace_back(cpu.id);
+        }
+        OnnxBenchmarks::PinCurrentThread(all);
+    }
+
+    std::string ThreadPlacement::IntraOpAffinities(size_t threads, size_t firstSlot) const {
+        if (!Enabled() || threads <= 1) {
+            return {};
+        }
+        std::vector<std::vector<int>> threadCpus;
+        for (size_t i = 0; i + 1 < threads; ++i) {
+            threadCpus.emplace_back(CpusOfSlot(firstSlot + i));
+        }
+        return IntraOpAffinityString(threadCpus);
+    }
+
+    JsonValue ThreadPlacement::ToJson() const {
+        auto json = topology.ToJson();
+        json["policy"] = PlacementPolicyName(policy);
+        auto &slots = json["order"] = JsonValue::Array{};
+        for (auto cpu: order) {
+            slots.Push(cpu);
+        }
+        return json;
+    }
+
+    UnpinnedScope::UnpinnedScope() {
+        if (GetThreadPlacement().Enabled()) {
+            previous = CurrentThreadAffinity();
+            GetThreadPlacement().UnpinCurrentThread();
+        }
+    }
+
+    UnpinnedScope::~UnpinnedScope() {
+        if (!previous.empty()) {
+            PinCurrentThread(previous);
+        }
+    }
+
+    NodeLocalBuffer::NodeLocalBuffer(size_t inBytes, int inNode) : bytes(inBytes), node(inNode) {
+        if (bytes == 0) {
+            return;
+        }
+        data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) {
+            data = nullptr;
+            throw std::bad_alloc();
+        }
+#ifdef SYS_mbind
+        // MPOL_BIND without depending on libnuma, fails on kernels without NUMA support
+        static constexpr int MpolBind = 2;
+        static constexpr size_t BitsPerWord = 8 * sizeof(unsigned long);
+        if (node >= 0) {
+            std::vector<unsigned long> mask(static_cast<size_t>(node) / BitsPerWord + 1);
+            mask[static_cast<size_t>(node) / BitsPerWord] |= 1UL << (static_cast<size_t>(node) % BitsPerWord);
+            bound = syscall(SYS_mbind, data, bytes, MpolBind, mask.data(), mask.size() * BitsPerWord + 1, 0) == 0;
+        }
+#endif
+    }
+
+    NodeLocalBuffer::NodeLocalBuffer(NodeLocalBuffer &&other) noexcept
+            : data(std::exchange(other.data, nullptr)), bytes(std::exchange(other.bytes, 0)), node(other.node),
+              bound(other.bound) {}
+
+    NodeLocalBuffer &NodeLocalBuffer::operator=(NodeLocalBuffer &&other) noexcept {
+        if (this != &other) {
+            if (data) {
+                munmap(data, bytes);
+            }
+            data = std::exchange(other.data, nullptr);
+            bytes = std::exchange(other.bytes, 0);
+            node = other.node;
+            bound = other.bound;
+        }
+        return *this;
+    }
+
+    NodeLocalBuffer::~NodeLocalBuffer() {
+        if (data) {
+            munmap(data, bytes);
+        }
+    }
+}
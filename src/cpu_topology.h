@@ -0,0 +1,174 @@
+//
+// Created by antares on 4/30/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_CPU_TOPOLOGY_H
+#define TESTPROJECT_CPU_TOPOLOGY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "json.h"
+#include "options.h"
+
+namespace OnnxBenchmarks {
+    struct LogicalCpu {
+        int id = 0;
+        int package = 0;
+        /// Core id within the package, hyper-threads of one physical core share it
+        int core = 0;
+        int node = 0;
+    };
+
+    /// Logical CPUs the process may run on, with their package, physical core and NUMA node
+    class CpuTopology {
+        /// Sorted by id
+        std::vector<LogicalCpu> cpus;
+
+    public:
+        /// Read /sys/devices/system/{cpu,node}, restricted to the affinity mask of the calling thread.
+        /// Without sysfs every CPU is taken as its own core on package 0 and node 0.
+        static CpuTopology Detect();
+
+        [[nodiscard]] const std::vector<LogicalCpu> &Cpus() const { return cpus; }
+
+        /// Node ids in ascending order
+        [[nodiscard]] std::vector<int> Nodes() const;
+
+        [[nodiscard]] std::vector<int> CpusOfNode(int node) const;
+
+        [[nodiscard]] size_t PhysicalCoreCount() const;
+
+        /// The order in which threads are placed on CPUs:
+        ///   compact (and numa)  node by node, the hyper-threads of a core next to each other
+        ///   scatter             one CPU per physical core first, alternating between the nodes
+        [[nodiscard]] std::vector<int> Order(PlacementPolicy policy) const;
+
+        [[nodiscard]] JsonValue ToJson() const;
+    };
+
+    /// Restrict the calling thread to `cpus`, returns false if the kernel refused
+    bool PinCurrentThread(const std::vector<int> &cpus);
+
+    /// CPUs the calling thread may run on
+    std::vector<int> CurrentThreadAffinity();
+
+    /// ORT's session.intra_op_thread_affinities value: one group per intra-op thread but the first (which is
+    /// the caller), groups separated by ';' and processors by ',', processor ids counted from 1
+    std::string IntraOpAffinityString(const std::vector<std::vector<int>> &threadCpus);
+
+    /// Size of the largest cache level of CPU 0 from sysfs (usually the shared L3), 32 MiB when unknown
+    size_t LastLevelCacheBytes();
+
+    /// Where the threads of a run are placed. Threads are numbered by slots: a caller thread takes one slot
+    /// and each intra-op thread of its session another, and slot i runs on the i-th CPU of the policy's
+    /// order (wrapping around). With the numa policy a slot is bound to the whole node of that CPU instead,
+    /// leaving the scheduler free within the node.
+    class ThreadPlacement {
+        PlacementPolicy policy = PlacementPolicy::None;
+        CpuTopology topology;
+        std::vector<int> order;
+
+    public:
+        ThreadPlacement() = default;
+
+        ThreadPlacement(PlacementPolicy inPolicy, CpuTopology inTopology);
+
+        [[nodiscard]] bool Enabled() const { return policy != PlacementPolicy::None && !order.empty(); }
+
+        [[nodiscard]] PlacementPolicy Policy() const { return policy; }
+
+        [[nodiscard]] const CpuTopology &Topology() const { return topology; }
+
+        /// CPUs of a slot, empty without a policy
+        [[nodiscard]] std::vector<int> CpusOfSlot(size_t slot) const;
+
+        /// NUMA node of a slot's CPU
+        [[nodiscard]] int NodeOfSlot(size_t slot) const;
+
+        /// Pin the calling thread to a slot, a no-op without a policy
+        void PinCurrentThread(size_t slot) const;
+
+        /// Let the calling thread run on every CPU of the topology again
+        void UnpinCurrentThread() const;
+
+        /// Affinities of the intra-op threads of a session with `threads` threads (the caller counts as the
+        /// first), which take consecutive slots from `firstSlot`; empty (no pinning) without a policy
+        [[nodiscard]] std::string IntraOpAffinities(size_t threads, size_t firstSlot) const;
+
+        [[nodiscard]] JsonValue ToJson() const;
+    };
+
+    /// The placement of the run, set up once from the options before any session is created
+    inline ThreadPlacement &GetThreadPlacement() {
+        static ThreadPlacement placement;
+        return placement;
+    }
+
+    /// Lets the calling thread run on every CPU for its lifetime and restores its previous affinity, e.g.
+    /// while creating a session whose threads should not inherit a pinned caller's affinity
+    class UnpinnedScope {
+        std::vector<int> previous;
+
+    public:
+        UnpinnedScope();
+
+        UnpinnedScope(const UnpinnedScope &) = delete;
+
+        UnpinnedScope &operator=(const UnpinnedScope &) = delete;
+
+        ~UnpinnedScope();
+    };
+
+    /// Anonymous memory placed on one NUMA node: bound with mbind where the kernel allows it, otherwise
+    /// the pages land on the node of the thread that touches them first.
+    class NodeLocalBuffer {
+        void *data = nullptr;
+        size_t bytes = 0;
+        int node = 0;
+        bool bound = false;
+
+    public:
+        NodeLocalBuffer() = default;
+
+        NodeLocalBuffer(size_t inBytes, int inNode);
+
+        NodeLocalBuffer(NodeLocalBuffer &&other) noexcept;
+
+        NodeLocalBuffer &operator=(NodeLocalBuffer &&other) noexcept;
+
+        ~NodeLocalBuffer();
+
+        [[nodiscard]] std::byte *Data() const { return static_cast<std::byte *>(data); }
+
+        [[nodiscard]] size_t Size() const { return bytes; }
+
+        [[nodiscard]] int Node() const { return node; }
+
+        /// The pages are bound to the node, not only first-touch placed
+        [[nodiscard]] bool Bound() const { return bound; }
+    };
+}
+
+#endif //TESTPROJECT_CPU_TOPOLOGY_H
@@ -0,0 +1,359 @@
+//
+// Created by antares on 4/24/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "dataset.h"
+#include "benchmarks.h"
+#include "cpu_topology.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace OnnxBenchmarks {
+    namespace {
+        size_t PageSize() {
+            static const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            return pageSize;
+        }
+
+        /// Page-aligned range covering [begin, begin + length)
+        std::pair<void *, size_t> PageRange(const std::byte *begin, size_t length) {
+            auto address = reinterpret_cast<uintptr_t>(begin);
+            auto aligned = address & ~(PageSize() - 1);
+            return {reinterpret_cast<void *>(aligned), length + (address - aligned)};
+        }
+
+        /// The value of `key` in a .npy header dict, from after its colon up to `end` (exclusive)
+        std::string NpyHeaderValue(const std::string &header, const std::string &key, char end,
+                                   const std::string &path) {
+            auto at = header.find("'" + key + "'");
+            auto colon = at == std::string::npos ? std::string::npos : header.find(':', at);
+            auto first = colon == std::string::npos ? std::string::npos : header.find_first_not_of(' ', colon + 1);
+            auto last = first == std::string::npos ? std::string::npos : header.find(end, first + 1);
+            if (last == std::string::npos) {
+                throw std::runtime_error("No " + key + " in the .npy header of " + path);
+            }
+            return header.substr(first + 1, last - first - 1);
+        }
+
+        struct NpyHeader {
+            size_t dataOffset;
+            std::string descr;
+            std::vector<size_t> shape;
+        };
+
+        /// Offset of the array data, dtype and shape of a .npy file, see numpy.lib.format
+        NpyHeader ParseNpyHeader(const std::byte *data, size_t size, const std::string &path) {
+            static constexpr char Magic[] = "\x93NUMPY";
+            if (size < 10 || std::memcmp(data, Magic, 6) != 0) {
+                throw std::runtime_error("Not a .npy file: " + path);
+            }
+            auto major = static_cast<uint8_t>(data[6]);
+            size_t headerLen;
+            size_t prefix;
+            if (major == 1) {
+                headerLen = static_cast<size_t>(data[8]) | static_cast<size_t>(data[9]) << 8;
+                prefix = 10;
+            } else {
+                if (size < 12) {
+                    throw std::runtime_error("Truncated .npy header: " + path);
+                }
+                headerLen = 0;
+                for (int i = 3; i >= 0; --i) {
+                    headerLen = headerLen << 8 | static_cast<size_t>(data[8 + i]);
+                }
+                prefix = 12;
+            }
+            if (prefix + headerLen > size) {
+                throw std::runtime_error("Truncated .npy header: " + path);
+            }
+            std::string header(reinterpret_cast<const char *>(data + prefix), headerLen);
+            if (header.find("'fortran_order': True") != std::string::npos) {
+                throw std::runtime_error("Fortran-ordered .npy is not supported: " + path);
+            }
+
+            NpyHeader parsed{prefix + headerLen, NpyHeaderValue(header, "descr", '\'', path), {}};
+            auto shape = NpyHeaderValue(header, "shape", ')', path);
+            for (size_t pos = 0; (pos = shape.find_first_of("0123456789", pos)) != std::string::npos;) {
+                size_t length;
+                parsed.shape.emplace_back(std::stoull(shape.substr(pos), &length));
+                pos += length;
+            }
+            return parsed;
+        }
+    }
+
+    MappedFile::MappedFile(const std::string &path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Can not open " + path + ": " + std::strerror(errno));
+        }
+        struct stat st{};
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error("Can not stat " + path + ": " + std::strerror(errno));
+        }
+        size = static_cast<size_t>(st.st_size);
+        if (size > 0) {
+            void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Can not map " + path + ": " + std::strerror(errno));
+            }
+            data = static_cast<std::byte *>(mapped);
+            madvise(mapped, size, MADV_SEQUENTIAL);
+        }
+        close(fd);
+    }
+
+    MappedFile::~MappedFile() {
+        if (data) {
+            munmap(data, size);
+        }
+    }
+
+    void MappedFile::WillNeed(const std::byte *begin, size_t length) const {
+        auto [address, len] = PageRange(begin, length);
+        madvise(address, len, MADV_WILLNEED);
+    }
+
+    void MappedFile::DontNeed(const std::byte *begin, size_t length) const {
+        auto [address, len] = PageRange(begin, length);
+        madvise(address, len, MADV_DONTNEED);
+    }
+
+    Dataset::Dataset(const std::string &path, size_t inSampleBytes, NpySampleFormat inNpyFormat)
+            : sampleBytes(inSampleBytes), npyFormat(std::move(inNpyFormat)) {
+        if (sampleBytes == 0) {
+            throw std::invalid_argument("Dataset samples must not be empty");
+        }
+        if (std::filesystem::is_directory(path)) {
+            std::vector<std::string> files;
+            for (const auto &entry: std::filesystem::directory_iterator(path)) {
+                if (entry.is_regular_file()) {
+                    files.emplace_back(entry.path().string());
+                }
+            }
+            std::sort(files.begin(), files.end());
+            for (const auto &file: files) {
+                _add_file(file);
+            }
+        } else {
+            _add_file(path);
+        }
+        if (sampleCount == 0) {
+            throw std::runtime_error("Dataset " + path + " holds no sample of " + std::to_string(sampleBytes) +
+                                     " bytes");
+        }
+    }
+
+    void Dataset::_add_file(const std::string &path) {
+        auto file = std::make_shared<MappedFile>(path);
+        const std::byte *data = file->Data();
+        size_t size = file->Size();
+        if (std::filesystem::path(path).extension() == ".npy") {
+            auto header = ParseNpyHeader(data, size, path);
+            if (!npyFormat.descr.empty()) {
+                // '=' is the native byte order, little endian on every host this runs on
+                auto descr = header.descr;
+                if (!descr.empty() && descr[0] == '=') {
+                    descr[0] = npyFormat.descr[0];
+                }
+                size_t perSample = 1;
+                for (size_t i = 1; i < header.shape.size(); ++i) {
+                    perSample *= header.shape[i];
+                }
+                if (descr != npyFormat.descr) {
+                    throw std::runtime_error(path + " holds " + header.descr + " elements, the model input needs " +
+                                             npyFormat.descr);
+                }
+                if (header.shape.empty() || perSample != npyFormat.elements) {
+                    throw std::runtime_error(path + " holds samples of " + std::to_string(perSample) +
+                                             " elements (shape (samples, ...)), the model input needs " +
+                                             std::to_string(npyFormat.elements));
+                }
+                if (header.dataOffset + header.shape[0] * sampleBytes > size) {
+                    throw std::runtime_error(path + " is shorter than its shape");
+                }
+                size = header.dataOffset + header.shape[0] * sampleBytes;
+            }
+            data += header.dataOffset;
+            size -= header.dataOffset;
+        }
+        auto count = size / sampleBytes;
+        if (size % sampleBytes != 0) {
+            Warning("Dataset file ", path, " has ", size % sampleBytes, " trailing bytes that do not form a sample");
+        }
+        if (count == 0) {
+            return;
+        }
+        segments.emplace_back(Segment{std::move(file), data, sampleCount, count});
+        sampleCount += count;
+    }
+
+    const Dataset::Segment &Dataset::_segment_of(size_t index) const {
+        auto it = std::upper_bound(segments.begin(), segments.end(), index,
+                                   [](size_t i, const Segment &segment) { return i < segment.firstSample; });
+        return *(it - 1);
+    }
+
+    const std::byte *Dataset::Sample(size_t index) const {
+        index %= sampleCount;
+        const auto &segment = _segment_of(index);
+        return segment.data + (index - segment.firstSample) * sampleBytes;
+    }
+
+    size_t Dataset::ContiguousFrom(size_t index) const {
+        index %= sampleCount;
+        const auto &segment = _segment_of(index);
+        return segment.firstSample + segment.count - index;
+    }
+
+    void Dataset::CopyBatch(size_t first, size_t batch, const std::vector<size_t> &inputSizes,
+                            const std::vector<size_t> &inputStrides, std::byte *dst) const {
+        size_t offset = 0;
+        for (size_t i = 0; i < inputSizes.size(); ++i) {
+            auto len = inputSizes[i];
+            for (size_t r = 0; r < batch; ++r) {
+                std::memcpy(dst + r * len, Sample(first + r) + offset, len);
+            }
+            dst += batch * inputStrides[i];
+            offset += len;
+        }
+    }
+
+    void Dataset::Prefetch(size_t first, size_t count) const {
+        const auto pageSize = PageSize();
+        while (count > 0) {
+            first %= sampleCount;
+            const auto &segment = _segment_of(first);
+            auto n = std::min(count, segment.firstSample + segment.count - first);
+            const std::byte *begin = segment.data + (first - segment.firstSample) * sampleBytes;
+            size_t length = n * sampleBytes;
+            segment.file->WillNeed(begin, length);
+            // touch every page so the consumer never takes a page fault
+            volatile std::byte sink{};
+            for (size_t i = 0; i < length; i += pageSize) {
+                sink = begin[i];
+            }
+            sink = begin[length - 1];
+            static_cast<void>(sink);
+            first += n;
+            count -= n;
+        }
+    }
+
+    void Dataset::Release(size_t first, size_t count) const {
+        while (count > 0) {
+            first %= sampleCount;
+            const auto &segment = _segment_of(first);
+            auto n = std::min(count, segment.firstSample + segment.count - first);
+            segment.file->DontNeed(segment.data + (first - segment.firstSample) * sampleBytes, n * sampleBytes);
+            first += n;
+            count -= n;
+        }
+    }
+
+    DatasetPrefetcher::DatasetPrefetcher(const Dataset &inDataset, std::vector<size_t> inInputSizes,
+                                         std::vector<size_t> inInputStrides, size_t inBatch, size_t depth)
+            : dataset(inDataset), inputSizes(std::move(inInputSizes)), inputStrides(std::move(inInputStrides)),
+              batch(inBatch), slots(depth + 1) {
+        if (depth == 0 || batch == 0) {
+            throw std::invalid_argument("Prefetch depth and batch must be positive");
+        }
+        producer = std::thread(&DatasetPrefetcher::_producer_loop, this);
+    }
+
+    DatasetPrefetcher::~DatasetPrefetcher() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        producer.join();
+    }
+
+    const std::byte *DatasetPrefetcher::Next() {
+        std::unique_lock lock(mutex);
+        condition.wait(lock, [this] { return produced > consumed; });
+        auto &slot = slots[consumed % slots.size()];
+        ++consumed;
+        lock.unlock();
+        condition.notify_all();
+        return slot.data;
+    }
+
+    void DatasetPrefetcher::_producer_loop() {
+        // keep the reads off the CPU of the pinned caller it was started from
+        GetThreadPlacement().UnpinCurrentThread();
+        const size_t depth = slots.size() - 1;
+        size_t batchBytes = 0;
+        for (auto stride: inputStrides) {
+            batchBytes += stride * batch;
+        }
+        size_t next = 0;
+        while (true) {
+            {
+                std::unique_lock lock(mutex);
+                condition.wait(lock, [this, depth] { return stopping || produced < consumed + depth; });
+                if (stopping) {
+                    return;
+                }
+            }
+
+            // the slot to fill is neither ready nor held by the consumer
+            auto &slot = slots[produced % slots.size()];
+            if (slot.data && slot.data != slot.staging.Data()) {
+                // the consumer is done with the in-place batch previously held by this slot
+                dataset.Release(slot.first, batch);
+            }
+            slot.first = next;
+            if (inputSizes.size() == 1 && dataset.ContiguousFrom(next) >= batch) {
+                dataset.Prefetch(next, batch);
+                slot.data = dataset.Sample(next);
+            } else {
+                if (slot.staging.Size() < batchBytes) {
+                    slot.staging = TensorBuffer(batchBytes);
+                }
+                dataset.Prefetch(next, batch);
+                dataset.CopyBatch(next, batch, inputSizes, inputStrides, slot.staging.Data());
+                dataset.Release(next, batch);
+                slot.data = slot.staging.Data();
+            }
+            next = (next + batch) % dataset.Size();
+
+            {
+                std::lock_guard lock(mutex);
+                ++produced;
+            }
+            condition.notify_all();
+        }
+    }
+}
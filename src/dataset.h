@@ -0,0 +1,163 @@
+//
+// Created by antares on 4/24/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_DATASET_H
+#define TESTPROJECT_DATASET_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "tensor_utils.h"
+
+namespace OnnxBenchmarks {
+    /// Read-only memory mapping of a whole file
+    class MappedFile {
+        std::byte *data = nullptr;
+        size_t size = 0;
+
+    public:
+        explicit MappedFile(const std::string &path);
+
+        MappedFile(const MappedFile &) = delete;
+
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile();
+
+        [[nodiscard]] const std::byte *Data() const { return data; }
+
+        [[nodiscard]] size_t Size() const { return size; }
+
+        /// Hint that [begin, begin + length) is needed soon / no longer needed
+        void WillNeed(const std::byte *begin, size_t length) const;
+
+        void DontNeed(const std::byte *begin, size_t length) const;
+    };
+
+    /// What a .npy file of a dataset must declare: the dtype descr of its elements (e.g. "<f4") and the
+    /// elements per sample, which its shape (samples, ...) has to multiply to after the first dim.
+    /// An empty descr accepts any header.
+    struct NpySampleFormat {
+        std::string descr;
+        size_t elements = 0;
+    };
+
+    /// Model input samples read from .npy or raw files, mapped without copying.
+    /// A sample is all inputs of one batch item one after another, without the padding of the buffer
+    /// layout, so the files must hold such samples back to back; .npy headers are checked against the
+    /// sample format and skipped, other files are taken raw.
+    /// A directory is read as all its regular files in name order. Pages are only read on demand,
+    /// so the dataset may be much larger than RAM.
+    class Dataset {
+        struct Segment {
+            std::shared_ptr<MappedFile> file;
+            const std::byte *data;
+            size_t firstSample;
+            size_t count;
+        };
+
+        std::vector<Segment> segments;
+        size_t sampleBytes;
+        NpySampleFormat npyFormat;
+        size_t sampleCount = 0;
+
+    public:
+        Dataset(const std::string &path, size_t inSampleBytes, NpySampleFormat inNpyFormat = {});
+
+        [[nodiscard]] size_t Size() const { return sampleCount; }
+
+        [[nodiscard]] size_t SampleBytes() const { return sampleBytes; }
+
+        [[nodiscard]] const std::byte *Sample(size_t index) const;
+
+        /// Samples from `index` on that are contiguous in memory (within one file)
+        [[nodiscard]] size_t ContiguousFrom(size_t index) const;
+
+        /// Copy `batch` samples from `first` (wrapping around) into `dst` in the batched model layout:
+        /// input 0 of every sample, then input 1 of every sample, ..., input i at `batch` times the strides
+        /// before it (see OnnxModel::GetInputBufferStrides)
+        void CopyBatch(size_t first, size_t batch, const std::vector<size_t> &inputSizes,
+                       const std::vector<size_t> &inputStrides, std::byte *dst) const;
+
+        /// Fault in the pages of the samples ahead of use
+        void Prefetch(size_t first, size_t count) const;
+
+        /// Drop the pages of consumed samples from this process
+        void Release(size_t first, size_t count) const;
+
+    private:
+        [[nodiscard]] const Segment &_segment_of(size_t index) const;
+
+        void _add_file(const std::string &path);
+    };
+
+    /// Streams batches of a dataset through a bounded queue filled by a background thread, so that
+    /// file I/O and page faults happen off the timed path. Batches of single-input models that are
+    /// contiguous in a file are handed out in place; others are gathered into staging buffers.
+    class DatasetPrefetcher {
+        struct Slot {
+            const std::byte *data = nullptr;
+            size_t first = 0;
+            TensorBuffer staging;
+        };
+
+        const Dataset &dataset;
+        const std::vector<size_t> inputSizes;
+        const std::vector<size_t> inputStrides;
+        const size_t batch;
+
+        std::vector<Slot> slots;
+        std::mutex mutex;
+        std::condition_variable condition;
+        /// slots [consumed, produced) are ready, the one before `consumed` is in use by the consumer
+        size_t produced = 0;
+        size_t consumed = 0;
+        bool stopping = false;
+        std::thread producer;
+
+    public:
+        /// `depth` batches are kept ready ahead of the consumer
+        DatasetPrefetcher(const Dataset &inDataset, std::vector<size_t> inInputSizes,
+                          std::vector<size_t> inInputStrides, size_t inBatch, size_t depth);
+
+        DatasetPrefetcher(const DatasetPrefetcher &) = delete;
+
+        DatasetPrefetcher &operator=(const DatasetPrefetcher &) = delete;
+
+        ~DatasetPrefetcher();
+
+        /// The next batch in the model's input layout, valid until the following call. Single consumer only.
+        const std::byte *Next();
+
+    private:
+        void _producer_loop();
+    };
+}
+
+#endif //TESTPROJECT_DATASET_H
@@ -0,0 +1,167 @@
+//
+// Created by antares on 4/9/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "dynamic_batcher.h"
+#include "model_wrapper.h"
+#include "cpu_topology.h"
+#include <algorithm>
+#include <cstring>
+
+namespace OnnxBenchmarks {
+    DynamicBatcher::DynamicBatcher(OnnxModel *inModel, size_t inMaxBatch, std::chrono::microseconds inMaxWait,
+                                   size_t workerCount)
+            : model(inModel), maxBatch(std::max<size_t>(inMaxBatch, 1)), maxWait(inMaxWait) {
+        if (maxBatch > 1 && !model->IsBatchSupported()) {
+            throw std::invalid_argument("Dynamic batching needs a model with a dynamic batch dimension");
+        }
+        // such outputs are not in the batched output buffer, so they could not be scattered back
+        if (model->HasDynamicOutputs()) {
+            throw std::invalid_argument("Dynamic batching needs outputs of known shape, set their dims with --dim");
+        }
+        workerCount = std::max<size_t>(workerCount, 1);
+        workers.reserve(workerCount);
+        for (size_t i = 0; i < workerCount; ++i) {
+            workers.emplace_back(&DynamicBatcher::_worker_loop, this, i);
+        }
+    }
+
+    DynamicBatcher::~DynamicBatcher() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        for (auto &worker: workers) {
+            worker.join();
+        }
+    }
+
+    std::future<void> DynamicBatcher::Submit(const void *inBuffer, void *outBuffer) {
+        std::future<void> future;
+        {
+            std::lock_guard lock(mutex);
+            auto &request = queue.emplace_back(Request{static_cast<const std::byte *>(inBuffer),
+                                                       static_cast<std::byte *>(outBuffer), Clock::now(), {}});
+            future = request.promise.get_future();
+        }
+        condition.notify_one();
+        return future;
+    }
+
+    double DynamicBatcher::AverageBatchSize() const {
+        auto batches = batchCount.load();
+        return batches == 0 ? 0. : static_cast<double>(requestCount.load()) / static_cast<double>(batches);
+    }
+
+    void DynamicBatcher::_worker_loop(size_t index) {
+        GetThreadPlacement().PinCurrentThread(index);
+        TensorBuffer inBatch(model->GetInputBufferSize() * maxBatch);
+        TensorBuffer outBatch(model->GetOutputBufferSize() * maxBatch);
+        while (true) {
+            auto batch = _take_batch();
+            if (batch.empty()) {
+                return;
+            }
+            _run_batch(batch, inBatch, outBatch);
+        }
+    }
+
+    std::vector<DynamicBatcher::Request> DynamicBatcher::_take_batch() {
+        std::unique_lock lock(mutex);
+        while (true) {
+            if (queue.empty()) {
+                if (stopping) {
+                    return {};
+                }
+                condition.wait(lock);
+                continue;
+            }
+            // the front is the oldest request, its deadline decides when a partial batch is due
+            auto deadline = queue.front().arrival + maxWait;
+            if (stopping || queue.size() >= maxBatch || Clock::now() >= deadline) {
+                break;
+            }
+            condition.wait_until(lock, deadline);
+        }
+
+        auto count = std::min(queue.size(), maxBatch);
+        std::vector<Request> batch;
+        batch.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            batch.emplace_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+        bool remaining = !queue.empty();
+        lock.unlock();
+        if (remaining) {
+            condition.notify_one();
+        }
+        return batch;
+    }
+
+    void DynamicBatcher::_run_batch(std::vector<Request> &batch, TensorBuffer &inBatch, TensorBuffer &outBatch) {
+        const auto count = batch.size();
+        try {
+            // gather: [input0 of every request][input1 of every request]...
+            // a request holds one item, so each of its inputs starts one stride after the previous one
+            std::byte *dst = inBatch.Data();
+            size_t offset = 0;
+            for (size_t i = 0; i < model->GetInputNums(); ++i) {
+                auto len = model->GetInputBufferSizes()[i];
+                auto stride = model->GetInputBufferStrides()[i];
+                for (size_t r = 0; r < count; ++r) {
+                    std::memcpy(dst + r * len, batch[r].inBuffer + offset, len);
+                }
+                dst += count * stride;
+                offset += stride;
+            }
+
+            model->Run(inBatch.Data(), outBatch.Data(), static_cast<int64_t>(count));
+
+            const std::byte *src = outBatch.Data();
+            offset = 0;
+            for (size_t i = 0; i < model->GetOutputNums(); ++i) {
+                auto len = model->GetOutputBufferSizes()[i];
+                auto stride = model->GetOutputBufferStrides()[i];
+                for (size_t r = 0; r < count; ++r) {
+                    std::memcpy(batch[r].outBuffer + offset, src + r * len, len);
+                }
+                src += count * stride;
+                offset += stride;
+            }
+        } catch (...) {
+            for (auto &request: batch) {
+                request.promise.set_exception(std::current_exception());
+            }
+            return;
+        }
+
+        batchCount.fetch_add(1, std::memory_order_relaxed);
+        requestCount.fetch_add(count, std::memory_order_relaxed);
+        for (auto &request: batch) {
+            request.promise.set_value();
+        }
+    }
+}
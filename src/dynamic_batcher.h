@@ -0,0 +1,100 @@
+//
+// Created by antares on 4/9/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_DYNAMIC_BATCHER_H
+#define TESTPROJECT_DYNAMIC_BATCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "tensor_utils.h"
+
+namespace OnnxBenchmarks {
+    class OnnxModel;
+
+    /// Coalesces batch-1 requests from many threads into batched OnnxModel::Run calls.
+    /// A batch is dispatched once it holds maxBatch requests or its oldest request waited maxWait.
+    /// Inputs are packed into one contiguous buffer in the model's layout (each input tensor batched
+    /// separately), and the output slices are scattered back before the request's future is ready.
+    class DynamicBatcher {
+        using Clock = std::chrono::steady_clock;
+
+        struct Request {
+            const std::byte *inBuffer;
+            std::byte *outBuffer;
+            Clock::time_point arrival;
+            std::promise<void> promise;
+        };
+
+        OnnxModel *model;
+        const size_t maxBatch;
+        const Clock::duration maxWait;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<Request> queue;
+        bool stopping = false;
+
+        std::vector<std::thread> workers;
+
+        std::atomic<size_t> batchCount{0};
+        std::atomic<size_t> requestCount{0};
+
+    public:
+        /// `workerCount` batches may run concurrently, each worker owns its packing buffers. Throws
+        /// std::invalid_argument for models whose outputs are not all of known shape.
+        DynamicBatcher(OnnxModel *inModel, size_t inMaxBatch, std::chrono::microseconds inMaxWait,
+                       size_t workerCount = 1);
+
+        DynamicBatcher(const DynamicBatcher &) = delete;
+
+        DynamicBatcher &operator=(const DynamicBatcher &) = delete;
+
+        /// Finishes every queued request, then stops the workers.
+        ~DynamicBatcher();
+
+        /// `inBuffer` and `outBuffer` hold one batch item and must stay valid until the future is ready.
+        std::future<void> Submit(const void *inBuffer, void *outBuffer);
+
+        /// Average requests per dispatched batch so far
+        [[nodiscard]] double AverageBatchSize() const;
+
+    private:
+        /// Worker `index` is pinned to slot `index` of the placement
+        void _worker_loop(size_t index);
+
+        /// Take up to maxBatch requests, blocks until a batch is due. Returns empty only when stopping.
+        std::vector<Request> _take_batch();
+
+        void _run_batch(std::vector<Request> &batch, TensorBuffer &inBatch, TensorBuffer &outBatch);
+    };
+}
+
+#endif //TESTPROJECT_DYNAMIC_BATCHER_H
@@ -0,0 +1,594 @@
+//
+// Created by antares on 5/11/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "image_preprocess.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ONNX_BENCHMARK_X86_SIMD 1
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC 12 takes the deliberately undefined pass-through register of the AVX-512 conversions for a bug
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+#endif
+
+namespace OnnxBenchmarks {
+    namespace {
+        /// Per-channel out = in * mul + add
+        struct Affine {
+            std::array<float, 4> mul{};
+            std::array<float, 4> add{};
+        };
+
+        Affine MakeAffine(const Normalization &normalization, float scale) {
+            Affine affine;
+            for (size_t c = 0; c < 4; ++c) {
+                affine.mul[c] = scale / normalization.std[c];
+                affine.add[c] = -normalization.mean[c] / normalization.std[c];
+            }
+            return affine;
+        }
+
+        // Scalar kernels, also the tails of the vector ones from element `begin` on
+
+        void ConvertScalar(const uint8_t *src, float *dst, size_t begin, size_t count, float scale) {
+            for (size_t i = begin; i < count; ++i) {
+                dst[i] = static_cast<float>(src[i]) * scale;
+            }
+        }
+
+        void AffineScalar(float *data, size_t begin, size_t count, float mul, float add) {
+            for (size_t i = begin; i < count; ++i) {
+                data[i] = data[i] * mul + add;
+            }
+        }
+
+        void HwcToChwScalar(const uint8_t *src, uint8_t *dst, size_t begin, size_t pixels, size_t channels) {
+            for (size_t p = begin; p < pixels; ++p) {
+                for (size_t c = 0; c < channels; ++c) {
+                    dst[c * pixels + p] = src[p * channels + c];
+                }
+            }
+        }
+
+        void NormalizedScalar(const uint8_t *src, float *dst, size_t begin, size_t pixels, size_t channels,
+                              const Affine &affine) {
+            for (size_t p = begin; p < pixels; ++p) {
+                for (size_t c = 0; c < channels; ++c) {
+                    dst[c * pixels + p] = static_cast<float>(src[p * channels + c]) * affine.mul[c] + affine.add[c];
+                }
+            }
+        }
+
+        /// Rows scaled by 128 (Q7), weights in Q7, so the blend is exact in 32 bits and rounds once
+        void BlendScalar(const int16_t *row0, const int16_t *row1, int weight, uint8_t *out, size_t begin,
+                         size_t count) {
+            for (size_t i = begin; i < count; ++i) {
+                out[i] = static_cast<uint8_t>((row0[i] * (128 - weight) + row1[i] * weight + (1 << 13)) >> 14);
+            }
+        }
+
+#ifdef ONNX_BENCHMARK_X86_SIMD
+        /// pshufb masks that gather channel c of 16 RGB pixels from the i-th 16 of their 48 bytes
+        constexpr std::array<std::array<std::array<int8_t, 16>, 3>, 3> MakeRgbMasks() {
+            std::array<std::array<std::array<int8_t, 16>, 3>, 3> masks{};
+            for (int c = 0; c < 3; ++c) {
+                for (int part = 0; part < 3; ++part) {
+                    for (int i = 0; i < 16; ++i) {
+                        auto index = 3 * i + c;
+                        masks[c][part][i] = static_cast<int8_t>(index / 16 == part ? index % 16 : -128);
+                    }
+                }
+            }
+            return masks;
+        }
+
+        constexpr auto RgbMasks = MakeRgbMasks();
+
+        /// The R, G and B bytes of 16 interleaved pixels. The byte shuffles are 128 bits wide at every
+        /// level, only the float stages use the wider registers.
+        __attribute__((target("sse4.1")))
+        inline void DeinterleaveRgb(const uint8_t *src, __m128i (&planes)[3]) {
+            __m128i parts[3];
+            for (int part = 0; part < 3; ++part) {
+                parts[part] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16 * part));
+            }
+            for (int c = 0; c < 3; ++c) {
+                auto mask = [c](int part) {
+                    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(RgbMasks[c][part].data()));
+                };
+                planes[c] = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(parts[0], mask(0)),
+                                                      _mm_shuffle_epi8(parts[1], mask(1))),
+                                         _mm_shuffle_epi8(parts[2], mask(2)));
+            }
+        }
+
+        __attribute__((target("sse4.1")))
+        void ConvertSse41(const uint8_t *src, float *dst, size_t count, float scale) {
+            auto factor = _mm_set1_ps(scale);
+            size_t i = 0;
+            for (; i + 16 <= count; i += 16) {
+                auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(bytes)), factor));
+                _mm_storeu_ps(dst + i + 4,
+                              _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 4))), factor));
+                _mm_storeu_ps(dst + i + 8,
+                              _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 8))), factor));
+                _mm_storeu_ps(dst + i + 12,
+                              _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 12))), factor));
+            }
+            ConvertScalar(src, dst, i, count, scale);
+        }
+
+        __attribute__((target("avx2,fma")))
+        void ConvertAvx2(const uint8_t *src, float *dst, size_t count, float scale) {
+            auto factor = _mm256_set1_ps(scale);
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                auto bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i));
+                _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)), factor));
+            }
+            ConvertScalar(src, dst, i, count, scale);
+        }
+
+        __attribute__((target("avx512f")))
+        void ConvertAvx512(const uint8_t *src, float *dst, size_t count, float scale) {
+            auto factor = _mm512_set1_ps(scale);
+            size_t i = 0;
+            for (; i + 16 <= count; i += 16) {
+                auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                _mm512_storeu_ps(dst + i, _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(bytes)), factor));
+            }
+            ConvertScalar(src, dst, i, count, scale);
+        }
+
+        __attribute__((target("sse4.1")))
+        void AffineSse41(float *data, size_t count, float mul, float add) {
+            auto m = _mm_set1_ps(mul);
+            auto a = _mm_set1_ps(add);
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                _mm_storeu_ps(data + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(data + i), m), a));
+            }
+            AffineScalar(data, i, count, mul, add);
+        }
+
+        __attribute__((target("avx2,fma")))
+        void AffineAvx2(float *data, size_t count, float mul, float add) {
+            auto m = _mm256_set1_ps(mul);
+            auto a = _mm256_set1_ps(add);
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                _mm256_storeu_ps(data + i, _mm256_fmadd_ps(_mm256_loadu_ps(data + i), m, a));
+            }
+            AffineScalar(data, i, count, mul, add);
+        }
+
+        __attribute__((target("avx512f")))
+        void AffineAvx512(float *data, size_t count, float mul, float add) {
+            auto m = _mm512_set1_ps(mul);
+            auto a = _mm512_set1_ps(add);
+            size_t i = 0;
+            for (; i + 16 <= count; i += 16) {
+                _mm512_storeu_ps(data + i, _mm512_fmadd_ps(_mm512_loadu_ps(data + i), m, a));
+            }
+            AffineScalar(data, i, count, mul, add);
+        }
+
+        __attribute__((target("sse4.1")))
+        void HwcToChwRgbSse41(const uint8_t *src, uint8_t *dst, size_t pixels) {
+            size_t p = 0;
+            for (; p + 16 <= pixels; p += 16) {
+                __m128i planes[3];
+                DeinterleaveRgb(src + 3 * p, planes);
+                for (size_t c = 0; c < 3; ++c) {
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + c * pixels + p), planes[c]);
+                }
+            }
+            HwcToChwScalar(src, dst, p, pixels, 3);
+        }
+
+        __attribute__((target("sse4.1")))
+        void NormalizedRgbSse41(const uint8_t *src, float *dst, size_t pixels, const Affine &affine) {
+            size_t p = 0;
+            for (; p + 16 <= pixels; p += 16) {
+                __m128i planes[3];
+                DeinterleaveRgb(src + 3 * p, planes);
+                for (size_t c = 0; c < 3; ++c) {
+                    auto m = _mm_set1_ps(affine.mul[c]);
+                    auto a = _mm_set1_ps(affine.add[c]);
+                    auto *out = dst + c * pixels + p;
+                    auto bytes = planes[c];
+                    for (int k = 0; k < 4; ++k) {
+                        auto values = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(bytes));
+                        _mm_storeu_ps(out + 4 * k, _mm_add_ps(_mm_mul_ps(values, m), a));
+                        bytes = _mm_srli_si128(bytes, 4);
+                    }
+                }
+            }
+            NormalizedScalar(src, dst, p, pixels, 3, affine);
+        }
+
+        __attribute__((target("avx2,fma")))
+        void NormalizedRgbAvx2(const uint8_t *src, float *dst, size_t pixels, const Affine &affine) {
+            size_t p = 0;
+            for (; p + 16 <= pixels; p += 16) {
+                __m128i planes[3];
+                DeinterleaveRgb(src + 3 * p, planes);
+                for (size_t c = 0; c < 3; ++c) {
+                    auto m = _mm256_set1_ps(affine.mul[c]);
+                    auto a = _mm256_set1_ps(affine.add[c]);
+                    auto *out = dst + c * pixels + p;
+                    auto low = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(planes[c]));
+                    auto high = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(planes[c], 8)));
+                    _mm256_storeu_ps(out, _mm256_fmadd_ps(low, m, a));
+                    _mm256_storeu_ps(out + 8, _mm256_fmadd_ps(high, m, a));
+                }
+            }
+            NormalizedScalar(src, dst, p, pixels, 3, affine);
+        }
+
+        __attribute__((target("avx512f")))
+        void NormalizedRgbAvx512(const uint8_t *src, float *dst, size_t pixels, const Affine &affine) {
+            size_t p = 0;
+            for (; p + 16 <= pixels; p += 16) {
+                __m128i planes[3];
+                DeinterleaveRgb(src + 3 * p, planes);
+                for (size_t c = 0; c < 3; ++c) {
+                    auto values = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(planes[c]));
+                    _mm512_storeu_ps(dst + c * pixels + p, _mm512_fmadd_ps(values, _mm512_set1_ps(affine.mul[c]),
+                                                                           _mm512_set1_ps(affine.add[c])));
+                }
+            }
+            NormalizedScalar(src, dst, p, pixels, 3, affine);
+        }
+
+        __attribute__((target("sse4.1")))
+        void BlendSse41(const int16_t *row0, const int16_t *row1, int weight, uint8_t *out, size_t count) {
+            // madd pairs (row0[i], row1[i]) with (128 - weight, weight)
+            auto weights = _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(weight) << 16) |
+                                                           static_cast<uint32_t>(128 - weight)));
+            auto round = _mm_set1_epi32(1 << 13);
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + i));
+                auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + i));
+                auto low = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), weights), round), 14);
+                auto high = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), weights), round), 14);
+                auto words = _mm_packs_epi32(low, high);
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(words, words));
+            }
+            BlendScalar(row0, row1, weight, out, i, count);
+        }
+
+        /// Also the AVX-512 level: the blend is bound by the scalar horizontal pass, not by its width
+        __attribute__((target("avx2")))
+        void BlendAvx2(const int16_t *row0, const int16_t *row1, int weight, uint8_t *out, size_t count) {
+            auto weights = _mm256_set1_epi32(static_cast<int>((static_cast<uint32_t>(weight) << 16) |
+                                                              static_cast<uint32_t>(128 - weight)));
+            auto round = _mm256_set1_epi32(1 << 13);
+            size_t i = 0;
+            for (; i + 16 <= count; i += 16) {
+                auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row0 + i));
+                auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row1 + i));
+                // unpack and pack both work within 128-bit lanes, so the words come back in order
+                auto low = _mm256_srai_epi32(
+                        _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), weights), round), 14);
+                auto high = _mm256_srai_epi32(
+                        _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), weights), round), 14);
+                auto words = _mm256_packs_epi32(low, high);
+                auto bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), _MM_SHUFFLE(3, 1, 2, 0));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm256_castsi256_si128(bytes));
+            }
+            BlendScalar(row0, row1, weight, out, i, count);
+        }
+#endif
+
+        void Blend(const int16_t *row0, const int16_t *row1, int weight, uint8_t *out, size_t count,
+                   SimdLevel level) {
+#ifdef ONNX_BENCHMARK_X86_SIMD
+            switch (level) {
+                case SimdLevel::Avx512:
+                case SimdLevel::Avx2:
+                    return BlendAvx2(row0, row1, weight, out, count);
+                case SimdLevel::Sse41:
+                    return BlendSse41(row0, row1, weight, out, count);
+                case SimdLevel::Scalar:
+                    break;
+            }
+#endif
+            BlendScalar(row0, row1, weight, out, 0, count);
+        }
+
+        void NormalizedChw(const uint8_t *src, float *dst, size_t pixels, size_t channels, const Affine &affine,
+                           SimdLevel level) {
+#ifdef ONNX_BENCHMARK_X86_SIMD
+            if (channels == 3) {
+                switch (level) {
+                    case SimdLevel::Avx512:
+                        return NormalizedRgbAvx512(src, dst, pixels, affine);
+                    case SimdLevel::Avx2:
+                        return NormalizedRgbAvx2(src, dst, pixels, affine);
+                    case SimdLevel::Sse41:
+                        return NormalizedRgbSse41(src, dst, pixels, affine);
+                    case SimdLevel::Scalar:
+                        break;
+                }
+            }
+#endif
+            NormalizedScalar(src, dst, 0, pixels, channels, affine);
+        }
+    }
+
+    const char *SimdLevelName(SimdLevel level) {
+        switch (level) {
+            case SimdLevel::Scalar:
+                return "scalar";
+            case SimdLevel::Sse41:
+                return "sse4.1";
+            case SimdLevel::Avx2:
+                return "avx2";
+            case SimdLevel::Avx512:
+                return "avx512";
+        }
+        return "unknown";
+    }
+
+    SimdLevel DetectSimdLevel() {
+#ifdef ONNX_BENCHMARK_X86_SIMD
+        if (__builtin_cpu_supports("avx512f")) {
+            return SimdLevel::Avx512;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return SimdLevel::Avx2;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+            return SimdLevel::Sse41;
+        }
+#endif
+        return SimdLevel::Scalar;
+    }
+
+    std::vector<SimdLevel> SupportedSimdLevels() {
+        std::vector<SimdLevel> levels;
+        auto best = DetectSimdLevel();
+        for (auto level: {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2, SimdLevel::Avx512}) {
+            if (level <= best) {
+                levels.emplace_back(level);
+            }
+        }
+        return levels;
+    }
+
+    SimdLevel ParseSimdLevel(const std::string &name) {
+        if (name == "auto") {
+            return DetectSimdLevel();
+        }
+        for (auto level: {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2, SimdLevel::Avx512}) {
+            if (name == SimdLevelName(level)) {
+                if (level > DetectSimdLevel()) {
+                    throw std::invalid_argument("This CPU does not support " + name);
+                }
+                return level;
+            }
+        }
+        throw std::invalid_argument("Unknown SIMD level: " + name);
+    }
+
+    void ConvertU8ToFloat(const uint8_t *src, float *dst, size_t count, float scale, SimdLevel level) {
+#ifdef ONNX_BENCHMARK_X86_SIMD
+        switch (level) {
+            case SimdLevel::Avx512:
+                return ConvertAvx512(src, dst, count, scale);
+            case SimdLevel::Avx2:
+                return ConvertAvx2(src, dst, count, scale);
+            case SimdLevel::Sse41:
+                return ConvertSse41(src, dst, count, scale);
+            case SimdLevel::Scalar:
+                break;
+        }
+#endif
+        ConvertScalar(src, dst, 0, count, scale);
+    }
+
+    void NormalizePlanes(float *planes, size_t planeSize, size_t channels, const Normalization &normalization,
+                         SimdLevel level) {
+        auto affine = MakeAffine(normalization, 1);
+        for (size_t c = 0; c < channels; ++c) {
+            auto *plane = planes + c * planeSize;
+            auto mul = affine.mul[std::min<size_t>(c, 3)];
+            auto add = affine.add[std::min<size_t>(c, 3)];
+#ifdef ONNX_BENCHMARK_X86_SIMD
+            switch (level) {
+                case SimdLevel::Avx512:
+                    AffineAvx512(plane, planeSize, mul, add);
+                    continue;
+                case SimdLevel::Avx2:
+                    AffineAvx2(plane, planeSize, mul, add);
+                    continue;
+                case SimdLevel::Sse41:
+                    AffineSse41(plane, planeSize, mul, add);
+                    continue;
+                case SimdLevel::Scalar:
+                    break;
+            }
+#endif
+            AffineScalar(plane, 0, planeSize, mul, add);
+        }
+    }
+
+    void HwcToChw(const uint8_t *src, uint8_t *dst, size_t pixels, size_t channels, SimdLevel level) {
+#ifdef ONNX_BENCHMARK_X86_SIMD
+        if (channels == 3 && level != SimdLevel::Scalar) {
+            return HwcToChwRgbSse41(src, dst, pixels);
+        }
+#endif
+        if (channels == 1) {
+            std::memcpy(dst, src, pixels);
+            return;
+        }
+        HwcToChwScalar(src, dst, 0, pixels, channels);
+    }
+
+    void HwcToNormalizedChw(const uint8_t *src, float *dst, size_t pixels, size_t channels,
+                            const Normalization &normalization, SimdLevel level) {
+        if (channels == 1) {
+            // nothing to transpose, the two vector passes beat one scalar pass
+            ConvertU8ToFloat(src, dst, pixels, normalization.scale, level);
+            NormalizePlanes(dst, pixels, 1, normalization, level);
+            return;
+        }
+        NormalizedChw(src, dst, pixels, channels, MakeAffine(normalization, normalization.scale), level);
+    }
+
+    namespace {
+        constexpr size_t NoRow = std::numeric_limits<size_t>::max();
+        constexpr int WeightOne = 128;
+
+        /// Source index and Q7 weight of the second neighbour of every target index, half-pixel centers
+        void PlanAxis(size_t srcSize, size_t dstSize, size_t stride, std::vector<uint32_t> &first,
+                      std::vector<uint32_t> &second, std::vector<int16_t> &weight) {
+            first.resize(dstSize);
+            second.resize(dstSize);
+            weight.resize(dstSize);
+            auto ratio = static_cast<double>(srcSize) / static_cast<double>(dstSize);
+            for (size_t d = 0; d < dstSize; ++d) {
+                auto position = std::max(0., (static_cast<double>(d) + 0.5) * ratio - 0.5);
+                auto index = std::min(static_cast<size_t>(position), srcSize - 1);
+                auto next = std::min(index + 1, srcSize - 1);
+                first[d] = static_cast<uint32_t>(index * stride);
+                second[d] = static_cast<uint32_t>(next * stride);
+                weight[d] = static_cast<int16_t>(
+                        next == index ? 0 : std::lround((position - static_cast<double>(index)) * WeightOne));
+            }
+        }
+    }
+
+    ImagePreprocessor::ImagePreprocessor(size_t inSrcHeight, size_t inSrcWidth, size_t inChannels,
+                                         size_t inDstHeight, size_t inDstWidth, const Normalization &inNormalization,
+                                         SimdLevel inLevel)
+            : srcHeight(inSrcHeight), srcWidth(inSrcWidth), channels(inChannels), dstHeight(inDstHeight),
+              dstWidth(inDstWidth), normalization(inNormalization), level(inLevel), rowOf{NoRow, NoRow} {
+        if (srcHeight == 0 || srcWidth == 0 || dstHeight == 0 || dstWidth == 0 || channels == 0 || channels > 4) {
+            throw std::invalid_argument("Image sizes must be positive with 1 to 4 channels");
+        }
+        PlanAxis(srcWidth, dstWidth, channels, xOffset0, xOffset1, xWeight);
+        PlanAxis(srcHeight, dstHeight, 1, yRow0, yRow1, yWeight);
+        for (auto &row: rows) {
+            row.resize(dstWidth * channels);
+        }
+        resized.resize(dstHeight * dstWidth * channels);
+        planar.resize(dstHeight * dstWidth * channels);
+    }
+
+    size_t ImagePreprocessor::_horizontal_row(const uint8_t *image, size_t srcRow, size_t busySlot) {
+        for (size_t slot = 0; slot < rows.size(); ++slot) {
+            if (rowOf[slot] == srcRow) {
+                return slot;
+            }
+        }
+        // rows are visited top down, so the upper cached row is the one not needed again
+        size_t slot;
+        if (busySlot < rows.size()) {
+            slot = 1 - busySlot;
+        } else if (rowOf[0] == NoRow || rowOf[1] == NoRow) {
+            slot = rowOf[0] == NoRow ? 0 : 1;
+        } else {
+            slot = rowOf[0] < rowOf[1] ? 0 : 1;
+        }
+        const auto *src = image + srcRow * srcWidth * channels;
+        auto *row = rows[slot].data();
+        // a constant channel count lets the compiler unroll the pixel
+        auto pass = [&](auto channelCount) {
+            constexpr size_t Channels = decltype(channelCount)::value;
+            for (size_t x = 0; x < dstWidth; ++x) {
+                const auto *left = src + xOffset0[x];
+                const auto *right = src + xOffset1[x];
+                int weight = xWeight[x];
+                for (size_t c = 0; c < Channels; ++c) {
+                    row[x * Channels + c] = static_cast<int16_t>(left[c] * (WeightOne - weight) + right[c] * weight);
+                }
+            }
+        };
+        switch (channels) {
+            case 1:
+                pass(std::integral_constant<size_t, 1>{});
+                break;
+            case 2:
+                pass(std::integral_constant<size_t, 2>{});
+                break;
+            case 3:
+                pass(std::integral_constant<size_t, 3>{});
+                break;
+            default:
+                pass(std::integral_constant<size_t, 4>{});
+                break;
+        }
+        rowOf[slot] = srcRow;
+        return slot;
+    }
+
+    void ImagePreprocessor::Resize(const uint8_t *image, uint8_t *out) {
+        if (srcHeight == dstHeight && srcWidth == dstWidth) {
+            std::memcpy(out, image, SourceBytes());
+            return;
+        }
+        // the cache holds rows of the previous image
+        rowOf = {NoRow, NoRow};
+        auto rowBytes = dstWidth * channels;
+        for (size_t y = 0; y < dstHeight; ++y) {
+            auto top = _horizontal_row(image, yRow0[y], rows.size());
+            auto bottom = _horizontal_row(image, yRow1[y], top);
+            Blend(rows[top].data(), rows[bottom].data(), yWeight[y], out + y * rowBytes, rowBytes, level);
+        }
+    }
+
+    void ImagePreprocessor::Run(const uint8_t *image, float *out) {
+        const uint8_t *source = image;
+        if (srcHeight != dstHeight || srcWidth != dstWidth) {
+            Resize(image, resized.data());
+            source = resized.data();
+        }
+        HwcToNormalizedChw(source, out, dstHeight * dstWidth, channels, normalization, level);
+    }
+
+    void ImagePreprocessor::RunStaged(const uint8_t *image, float *out) {
+        const uint8_t *source = image;
+        if (srcHeight != dstHeight || srcWidth != dstWidth) {
+            Resize(image, resized.data());
+            source = resized.data();
+        }
+        auto pixels = dstHeight * dstWidth;
+        HwcToChw(source, planar.data(), pixels, channels, level);
+        ConvertU8ToFloat(planar.data(), out, pixels * channels, normalization.scale, level);
+        NormalizePlanes(out, pixels, channels, normalization, level);
+    }
+}
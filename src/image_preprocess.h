@@ -0,0 +1,132 @@
+//
+// Created by antares on 5/11/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_IMAGE_PREPROCESS_H
+#define TESTPROJECT_IMAGE_PREPROCESS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace OnnxBenchmarks {
+    /// Instruction sets of the preprocessing kernels. Each kernel is compiled for all of them (function
+    /// target attributes, no build flags) and picked at run time.
+    enum class SimdLevel {
+        Scalar,
+        Sse41,
+        Avx2,
+        Avx512,
+    };
+
+    const char *SimdLevelName(SimdLevel level);
+
+    /// "auto" for DetectSimdLevel(), else one of the SimdLevelName() names; throws std::invalid_argument
+    /// for unknown names and levels the CPU does not support
+    SimdLevel ParseSimdLevel(const std::string &name);
+
+    /// Best level of this CPU, Scalar off x86
+    SimdLevel DetectSimdLevel();
+
+    /// Levels this CPU supports, Scalar first
+    std::vector<SimdLevel> SupportedSimdLevels();
+
+    /// out = (in * scale - mean[c]) / std[c], ImageNet values by default
+    struct Normalization {
+        std::array<float, 4> mean{0.485f, 0.456f, 0.406f, 0.f};
+        std::array<float, 4> std{0.229f, 0.224f, 0.225f, 1.f};
+        float scale = 1.f / 255.f;
+    };
+
+    // The kernels, all of them also used by ImagePreprocessor. Buffers need no alignment.
+
+    /// dst[i] = src[i] * scale
+    void ConvertU8ToFloat(const uint8_t *src, float *dst, size_t count, float scale, SimdLevel level);
+
+    /// Planes of `planeSize` floats, already scaled: plane[c][i] = (plane[c][i] - mean[c]) / std[c]
+    void NormalizePlanes(float *planes, size_t planeSize, size_t channels, const Normalization &normalization,
+                         SimdLevel level);
+
+    /// Interleaved HWC bytes to planar CHW bytes; 3 channels are vectorized, others are scalar
+    void HwcToChw(const uint8_t *src, uint8_t *dst, size_t pixels, size_t channels, SimdLevel level);
+
+    /// HwcToChw, ConvertU8ToFloat and NormalizePlanes in one pass, the bytes are read once
+    void HwcToNormalizedChw(const uint8_t *src, float *dst, size_t pixels, size_t channels,
+                            const Normalization &normalization, SimdLevel level);
+
+    /// Bilinear resize of an HWC uint8 image (half-pixel centers, like OpenCV INTER_LINEAR and ONNX Resize
+    /// with half_pixel), with its tables and row buffers planned once for a source and target size.
+    /// Then turns the resized image into the normalized CHW floats a vision model takes, either fused or
+    /// in separate passes; neither allocates per image.
+    class ImagePreprocessor {
+        size_t srcHeight;
+        size_t srcWidth;
+        size_t channels;
+        size_t dstHeight;
+        size_t dstWidth;
+        Normalization normalization;
+        SimdLevel level;
+
+        /// Byte offsets of the two source pixels of every target column and the weight of the second (Q7)
+        std::vector<uint32_t> xOffset0;
+        std::vector<uint32_t> xOffset1;
+        std::vector<int16_t> xWeight;
+        std::vector<uint32_t> yRow0;
+        std::vector<uint32_t> yRow1;
+        std::vector<int16_t> yWeight;
+
+        /// Horizontally resized source rows, values scaled by 128, and the source row each one holds
+        std::array<std::vector<int16_t>, 2> rows;
+        std::array<size_t, 2> rowOf;
+
+        std::vector<uint8_t> resized;
+        std::vector<uint8_t> planar;
+
+        /// The row buffer holding source row `srcRow` resized horizontally, computed unless it is cached;
+        /// the buffer `busySlot` is in use and not replaced
+        size_t _horizontal_row(const uint8_t *image, size_t srcRow, size_t busySlot);
+
+    public:
+        ImagePreprocessor(size_t inSrcHeight, size_t inSrcWidth, size_t inChannels, size_t inDstHeight,
+                          size_t inDstWidth, const Normalization &inNormalization, SimdLevel inLevel);
+
+        [[nodiscard]] size_t SourceBytes() const { return srcHeight * srcWidth * channels; }
+
+        /// Floats written by Run and RunStaged
+        [[nodiscard]] size_t OutputCount() const { return dstHeight * dstWidth * channels; }
+
+        /// Resize `image` into `out` (HWC, target size); copies when the sizes are equal
+        void Resize(const uint8_t *image, uint8_t *out);
+
+        /// Resize, then HwcToNormalizedChw into `out`, e.g. a batch item of the model input buffer
+        void Run(const uint8_t *image, float *out);
+
+        /// Resize, HwcToChw, ConvertU8ToFloat and NormalizePlanes one after another, the usual pipeline
+        void RunStaged(const uint8_t *image, float *out);
+    };
+}
+
+#endif //TESTPROJECT_IMAGE_PREPROCESS_H
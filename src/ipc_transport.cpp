@@ -0,0 +1,339 @@
+//
+// Created by antares on 5/10/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "ipc_transport.h"
+#include "benchmark_utils.h"
+#include "benchmarks.h"
+#include "model_wrapper.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace OnnxBenchmarks {
+    namespace {
+        constexpr uint32_t IpcMagic = 0x4f4e5831;
+        /// Slot buffers start on their own cache lines, so the two ends never share a line across buffers
+        constexpr size_t SlotAlignment = 64;
+        /// Largest ring a client may ask for, the sizes in its hello are not trusted
+        constexpr uint64_t MaxRingBytes = uint64_t{4} << 30;
+
+        size_t AlignUp(size_t n) {
+            return (n + SlotAlignment - 1) / SlotAlignment * SlotAlignment;
+        }
+
+        std::runtime_error SystemError(const std::string &what) {
+            return std::runtime_error(what + ": " + std::strerror(errno));
+        }
+
+        /// False when the peer closed the connection before the first byte
+        bool ReceiveAll(int fd, void *data, size_t size) {
+            auto *bytes = static_cast<std::byte *>(data);
+            size_t done = 0;
+            while (done < size) {
+                auto n = recv(fd, bytes + done, size - done, 0);
+                if (n == 0 && done == 0) {
+                    return false;
+                }
+                if (n == 0) {
+                    throw std::runtime_error("IPC connection closed in the middle of a record");
+                }
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw SystemError("IPC receive failed");
+                }
+                done += static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+        void SendAll(int fd, const void *data, size_t size) {
+            const auto *bytes = static_cast<const std::byte *>(data);
+            size_t done = 0;
+            while (done < size) {
+                auto n = send(fd, bytes + done, size - done, MSG_NOSIGNAL);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw SystemError("IPC send failed");
+                }
+                done += static_cast<size_t>(n);
+            }
+        }
+
+        sockaddr_un SocketAddress(const std::string &path) {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+                throw std::invalid_argument("IPC socket path must be 1 to " +
+                                            std::to_string(sizeof(address.sun_path) - 1) + " bytes: " + path);
+            }
+            std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+            return address;
+        }
+    }
+
+    SharedSlots::SharedSlots(uint32_t slots, size_t inBytes, size_t outBytes)
+            : inCapacity(AlignUp(inBytes)), slotBytes(AlignUp(inBytes) + AlignUp(outBytes)), count(slots) {
+        fd = memfd_create("onnxbenchmark-ring", MFD_CLOEXEC);
+        if (fd < 0) {
+            throw SystemError("Can not create the IPC ring");
+        }
+        mappedBytes = std::max<size_t>(slotBytes * count, 1);
+        if (ftruncate(fd, static_cast<off_t>(mappedBytes)) != 0) {
+            close(fd);
+            throw SystemError("Can not size the IPC ring");
+        }
+        _map();
+    }
+
+    SharedSlots::SharedSlots(int inFd, uint32_t slots, size_t inBytes, size_t outBytes)
+            : fd(inFd), inCapacity(AlignUp(inBytes)), slotBytes(AlignUp(inBytes) + AlignUp(outBytes)),
+              count(slots) {
+        mappedBytes = std::max<size_t>(slotBytes * count, 1);
+        _map();
+    }
+
+    void SharedSlots::_map() {
+        auto *mapped = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            throw SystemError("Can not map the IPC ring");
+        }
+        base = static_cast<std::byte *>(mapped);
+    }
+
+    SharedSlots::~SharedSlots() {
+        munmap(base, mappedBytes);
+        close(fd);
+    }
+
+    IpcServer::IpcServer(OnnxModel &inModel, std::string inSocketPath)
+            : model(inModel), socketPath(std::move(inSocketPath)) {
+        auto address = SocketAddress(socketPath);
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) {
+            throw SystemError("Can not create the IPC socket");
+        }
+        unlink(socketPath.c_str());
+        if (bind(listenFd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+            listen(listenFd, SOMAXCONN) != 0) {
+            auto error = SystemError("Can not listen on " + socketPath);
+            close(listenFd);
+            throw error;
+        }
+    }
+
+    IpcServer::~IpcServer() {
+        close(listenFd);
+        unlink(socketPath.c_str());
+    }
+
+    void IpcServer::Serve(const std::atomic<bool> &stop, double seconds) {
+        static constexpr int PollMilliseconds = 100;
+        auto deadline = Clock::now() +
+                        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+        while (!stop.load() && (seconds <= 0 || Clock::now() < deadline)) {
+            pollfd listening{listenFd, POLLIN, 0};
+            if (poll(&listening, 1, PollMilliseconds) <= 0) {
+                continue;
+            }
+            auto fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                continue;
+            }
+            ++connections;
+            std::lock_guard lock(mutex);
+            auto index = connectionFds.size();
+            connectionFds.emplace_back(fd);
+            threads.emplace_back([this, fd, index] { _serve_connection(fd, index); });
+        }
+
+        std::vector<std::thread> finished;
+        {
+            std::lock_guard lock(mutex);
+            // wakes up the connection threads blocked in recv
+            for (auto fd: connectionFds) {
+                if (fd >= 0) {
+                    shutdown(fd, SHUT_RDWR);
+                }
+            }
+            finished.swap(threads);
+        }
+        for (auto &thread: finished) {
+            thread.join();
+        }
+        std::lock_guard lock(mutex);
+        connectionFds.clear();
+    }
+
+    void IpcServer::_serve_connection(int fd, size_t index) {
+        GetThreadPlacement().PinCurrentThread(index);
+        auto &histogram = runLatency.Local();
+        // however the connection ends, its fd is closed here; Serve only shuts down the open ones
+        struct Closer {
+            IpcServer &server;
+            int fd;
+            size_t index;
+
+            ~Closer() {
+                std::lock_guard lock(server.mutex);
+                close(fd);
+                server.connectionFds[index] = -1;
+            }
+        } closer{*this, fd, index};
+        try {
+            IpcHello hello{};
+            if (!ReceiveAll(fd, &hello, sizeof(hello))) {
+                return;
+            }
+            if (hello.magic != IpcMagic || hello.slots == 0 || hello.maxBatch == 0) {
+                Warning("IPC connection ", index, " sent an invalid hello, closing it");
+                return;
+            }
+            auto inBytes = model.GetInputBufferSize();
+            auto outBytes = model.GetOutputBufferSize();
+            auto items = static_cast<uint64_t>(hello.slots) * hello.maxBatch;
+            auto bytesPerItem = std::max<uint64_t>(AlignUp(inBytes) + AlignUp(outBytes), 1);
+            if (items > MaxRingBytes / bytesPerItem) {
+                Warning("IPC connection ", index, " asked for ", hello.slots, " slots of batch ", hello.maxBatch,
+                        ", more than ", MaxRingBytes >> 20, " MiB, closing it");
+                return;
+            }
+            SharedSlots ring(hello.slots, inBytes * hello.maxBatch, outBytes * hello.maxBatch);
+
+            IpcHandshake handshake{IpcMagic, hello.slots, hello.maxBatch, 0, inBytes, outBytes};
+            iovec payload{&handshake, sizeof(handshake)};
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+            msghdr message{};
+            message.msg_iov = &payload;
+            message.msg_iovlen = 1;
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+            auto *header = CMSG_FIRSTHDR(&message);
+            header->cmsg_level = SOL_SOCKET;
+            header->cmsg_type = SCM_RIGHTS;
+            header->cmsg_len = CMSG_LEN(sizeof(int));
+            auto ringFd = ring.Fd();
+            std::memcpy(CMSG_DATA(header), &ringFd, sizeof(int));
+            if (sendmsg(fd, &message, MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(handshake))) {
+                throw SystemError("Can not send the IPC ring");
+            }
+
+            IpcRequest request{};
+            while (ReceiveAll(fd, &request, sizeof(request))) {
+                IpcResponse response{request.slot, 0, 0};
+                if (request.slot < ring.Count() && request.batch > 0 && request.batch <= hello.maxBatch) {
+                    try {
+                        auto start = Clock::now();
+                        model.Run(ring.Input(request.slot), ring.Output(request.slot),
+                                  static_cast<int64_t>(request.batch));
+                        response.serverNanoseconds = DurationToNanoseconds(Clock::now() - start);
+                        response.ok = 1;
+                        histogram.Record(response.serverNanoseconds);
+                    } catch (const std::exception &e) {
+                        if (failures.fetch_add(1) == 0) {
+                            Warning("IPC request failed: ", e.what());
+                        }
+                    }
+                } else if (failures.fetch_add(1) == 0) {
+                    Warning("IPC request for slot ", request.slot, " with batch ", request.batch, " is out of range");
+                }
+                ++requests;
+                SendAll(fd, &response, sizeof(response));
+            }
+        } catch (const std::exception &e) {
+            // a client that goes away mid-request only ends its own connection
+            Warning("IPC connection ", index, " closed: ", e.what());
+        }
+    }
+
+    IpcClient::IpcClient(const std::string &socketPath, uint32_t slots, uint32_t maxBatch) {
+        auto address = SocketAddress(socketPath);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            throw SystemError("Can not create the IPC socket");
+        }
+        try {
+            if (connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+                throw SystemError("Can not connect to " + socketPath);
+            }
+            IpcHello hello{IpcMagic, slots, maxBatch, 0};
+            SendAll(fd, &hello, sizeof(hello));
+
+            iovec payload{&handshake, sizeof(handshake)};
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+            msghdr message{};
+            message.msg_iov = &payload;
+            message.msg_iovlen = 1;
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+            ssize_t n;
+            do {
+                n = recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+            } while (n < 0 && errno == EINTR);
+            auto *header = CMSG_FIRSTHDR(&message);
+            if (n != static_cast<ssize_t>(sizeof(handshake)) || handshake.magic != IpcMagic || header == nullptr ||
+                header->cmsg_type != SCM_RIGHTS) {
+                throw std::runtime_error("The IPC server at " + socketPath + " did not send its ring");
+            }
+            int ringFd;
+            std::memcpy(&ringFd, CMSG_DATA(header), sizeof(int));
+            ring = std::make_unique<SharedSlots>(ringFd, handshake.slots, handshake.inBytesPerItem * maxBatch,
+                                                 handshake.outBytesPerItem * maxBatch);
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+    }
+
+    IpcClient::~IpcClient() {
+        close(fd);
+    }
+
+    void IpcClient::Submit(uint32_t slot, uint32_t batch) {
+        IpcRequest request{slot, batch};
+        SendAll(fd, &request, sizeof(request));
+    }
+
+    IpcResponse IpcClient::Receive() {
+        IpcResponse response{};
+        if (!ReceiveAll(fd, &response, sizeof(response))) {
+            throw std::runtime_error("The IPC server closed the connection");
+        }
+        if (response.ok == 0) {
+            throw std::runtime_error("The IPC server failed the request of slot " + std::to_string(response.slot));
+        }
+        return response;
+    }
+}
@@ -0,0 +1,190 @@
+//
+// Created by antares on 5/10/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_IPC_TRANSPORT_H
+#define TESTPROJECT_IPC_TRANSPORT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "latency_histogram.h"
+
+namespace OnnxBenchmarks {
+    class OnnxModel;
+
+    // Control records of the transport, sent as they are over the Unix domain socket (both ends are the
+    // same binary on the same machine). Tensors never pass through the socket.
+
+    /// First record of a client: the ring it wants
+    struct IpcHello {
+        uint32_t magic;
+        uint32_t slots;
+        uint32_t maxBatch;
+        uint32_t reserved;
+    };
+
+    /// Answer to IpcHello, sent together with the memfd of the ring
+    struct IpcHandshake {
+        uint32_t magic;
+        uint32_t slots;
+        uint32_t maxBatch;
+        uint32_t reserved;
+        uint64_t inBytesPerItem;
+        uint64_t outBytesPerItem;
+    };
+
+    /// Run the model on the input of `slot`, writing the output into the same slot
+    struct IpcRequest {
+        uint32_t slot;
+        uint32_t batch;
+    };
+
+    struct IpcResponse {
+        uint32_t slot;
+        /// 0 when the run threw, the server logs why
+        uint32_t ok;
+        /// Time of the run alone, as the server measured it
+        uint64_t serverNanoseconds;
+    };
+
+    /// A ring of tensor slots in a memfd shared by a server connection and its client. Every slot holds
+    /// the input and the output buffer of one batch, and the server runs the model directly on them
+    /// (OnnxModel::Run wraps the buffers with CreateTensor), so a request copies no tensor data.
+    class SharedSlots {
+        int fd = -1;
+        std::byte *base = nullptr;
+        size_t inCapacity = 0;
+        size_t slotBytes = 0;
+        size_t mappedBytes = 0;
+        uint32_t count = 0;
+
+        void _map();
+
+    public:
+        /// Create the memfd
+        SharedSlots(uint32_t slots, size_t inBytes, size_t outBytes);
+
+        /// Map a memfd received from the other end, taking ownership of `fd`
+        SharedSlots(int fd, uint32_t slots, size_t inBytes, size_t outBytes);
+
+        SharedSlots(const SharedSlots &) = delete;
+
+        SharedSlots &operator=(const SharedSlots &) = delete;
+
+        ~SharedSlots();
+
+        [[nodiscard]] int Fd() const { return fd; }
+
+        [[nodiscard]] uint32_t Count() const { return count; }
+
+        [[nodiscard]] void *Input(uint32_t slot) const { return base + slot * slotBytes; }
+
+        [[nodiscard]] void *Output(uint32_t slot) const { return base + slot * slotBytes + inCapacity; }
+    };
+
+    /// Serves an OnnxModel on a Unix domain socket. Every connection gets its own ring and thread, which
+    /// runs the requests of the connection in order; sessions are shared, as ORT runs are thread-safe.
+    class IpcServer {
+        OnnxModel &model;
+        std::string socketPath;
+        int listenFd = -1;
+
+        std::mutex mutex;
+        std::vector<int> connectionFds;
+        std::vector<std::thread> threads;
+
+        ConcurrentLatencyHistogram runLatency;
+        std::atomic<size_t> connections{0};
+        std::atomic<size_t> requests{0};
+        std::atomic<size_t> failures{0};
+
+        void _serve_connection(int fd, size_t index);
+
+    public:
+        /// Listen on `inSocketPath`, replacing a stale socket file
+        IpcServer(OnnxModel &inModel, std::string inSocketPath);
+
+        IpcServer(const IpcServer &) = delete;
+
+        IpcServer &operator=(const IpcServer &) = delete;
+
+        ~IpcServer();
+
+        /// Accept and serve clients until `stop` is set or `seconds` have passed (0 for no limit), then
+        /// close all connections
+        void Serve(const std::atomic<bool> &stop, double seconds);
+
+        /// Clients accepted so far
+        [[nodiscard]] size_t Connections() const { return connections.load(); }
+
+        [[nodiscard]] size_t Requests() const { return requests.load(); }
+
+        [[nodiscard]] size_t Failures() const { return failures.load(); }
+
+        /// Run latency of all requests served, call it after Serve
+        [[nodiscard]] LatencyHistogram RunLatency() { return runLatency.Merge(); }
+    };
+
+    /// One connection to an IpcServer with a ring of `slots` slots for batches up to `maxBatch`.
+    /// Requests may be pipelined: Submit up to Slots() of them before the first Receive.
+    class IpcClient {
+        int fd = -1;
+        IpcHandshake handshake{};
+        std::unique_ptr<SharedSlots> ring;
+
+    public:
+        IpcClient(const std::string &socketPath, uint32_t slots, uint32_t maxBatch);
+
+        IpcClient(const IpcClient &) = delete;
+
+        IpcClient &operator=(const IpcClient &) = delete;
+
+        ~IpcClient();
+
+        [[nodiscard]] uint32_t Slots() const { return ring->Count(); }
+
+        [[nodiscard]] size_t InputBytesPerItem() const { return handshake.inBytesPerItem; }
+
+        [[nodiscard]] size_t OutputBytesPerItem() const { return handshake.outBytesPerItem; }
+
+        /// Input buffer of the slot, write the request's batch here before Submit
+        [[nodiscard]] void *Input(uint32_t slot) const { return ring->Input(slot); }
+
+        /// Output buffer of the slot, valid once Receive returned its response
+        [[nodiscard]] void *Output(uint32_t slot) const { return ring->Output(slot); }
+
+        void Submit(uint32_t slot, uint32_t batch);
+
+        /// Block for the next response; throws when the server failed the run or went away
+        IpcResponse Receive();
+    };
+}
+
+#endif //TESTPROJECT_IPC_TRANSPORT_H
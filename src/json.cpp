@@ -0,0 +1,428 @@
+//
+// Created by antares on 4/25/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "json.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace OnnxBenchmarks {
+    namespace {
+        class JsonParser {
+            std::string_view text;
+            size_t pos = 0;
+
+        public:
+            explicit JsonParser(std::string_view inText) : text(inText) {}
+
+            JsonValue ParseDocument() {
+                auto value = ParseValue(0);
+                SkipSpace();
+                if (pos != text.size()) {
+                    Fail("trailing characters");
+                }
+                return value;
+            }
+
+        private:
+            static constexpr int MaxDepth = 512;
+
+            [[noreturn]] void Fail(const std::string &what) const {
+                throw std::runtime_error("Malformed JSON at offset " + std::to_string(pos) + ": " + what);
+            }
+
+            void SkipSpace() {
+                while (pos < text.size() &&
+                       (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')) {
+                    ++pos;
+                }
+            }
+
+            void Expect(char c) {
+                SkipSpace();
+                if (pos >= text.size() || text[pos] != c) {
+                    Fail(std::string("expected '") + c + "'");
+                }
+                ++pos;
+            }
+
+            bool Consume(std::string_view literal) {
+                if (text.substr(pos, literal.size()) == literal) {
+                    pos += literal.size();
+                    return true;
+                }
+                return false;
+            }
+
+            JsonValue ParseValue(int depth) {
+                if (depth > MaxDepth) {
+                    Fail("nested too deeply");
+                }
+                SkipSpace();
+                if (pos >= text.size()) {
+                    Fail("unexpected end of input");
+                }
+                switch (text[pos]) {
+                    case '{':
+                        return ParseObject(depth);
+                    case '[':
+                        return ParseArray(depth);
+                    case '"':
+                        return ParseString();
+                    default:
+                        break;
+                }
+                if (Consume("true")) return true;
+                if (Consume("false")) return false;
+                if (Consume("null")) return nullptr;
+                return ParseNumber();
+            }
+
+            JsonValue ParseObject(int depth) {
+                JsonValue::Object object;
+                Expect('{');
+                SkipSpace();
+                if (pos < text.size() && text[pos] == '}') {
+                    ++pos;
+                    return object;
+                }
+                while (true) {
+                    SkipSpace();
+                    auto key = ParseString();
+                    Expect(':');
+                    object.emplace_back(std::move(key), ParseValue(depth + 1));
+                    SkipSpace();
+                    if (pos < text.size() && text[pos] == ',') {
+                        ++pos;
+                        continue;
+                    }
+                    Expect('}');
+                    return object;
+                }
+            }
+
+            JsonValue ParseArray(int depth) {
+                JsonValue::Array array;
+                Expect('[');
+                SkipSpace();
+                if (pos < text.size() && text[pos] == ']') {
+                    ++pos;
+                    return array;
+                }
+                while (true) {
+                    array.emplace_back(ParseValue(depth + 1));
+                    SkipSpace();
+                    if (pos < text.size() && text[pos] == ',') {
+                        ++pos;
+                        continue;
+                    }
+                    Expect(']');
+                    return array;
+                }
+            }
+
+            unsigned ParseHex4() {
+                if (pos + 4 > text.size()) {
+                    Fail("truncated \\u escape");
+                }
+                unsigned code = 0;
+                for (int i = 0; i < 4; ++i) {
+                    char c = text[pos++];
+                    code <<= 4;
+                    if (c >= '0' && c <= '9') code |= static_cast<unsigned>(c - '0');
+                    else if (c >= 'a' && c <= 'f') code |= static_cast<unsigned>(c - 'a' + 10);
+                    else if (c >= 'A' && c <= 'F') code |= static_cast<unsigned>(c - 'A' + 10);
+                    else Fail("bad \\u escape");
+                }
+                return code;
+            }
+
+            static void AppendUtf8(std::string &out, unsigned code) {
+                if (code < 0x80) {
+                    out += static_cast<char>(code);
+                } else if (code < 0x800) {
+                    out += static_cast<char>(0xC0 | code >> 6);
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                } else if (code < 0x10000) {
+                    out += static_cast<char>(0xE0 | code >> 12);
+                    out += static_cast<char>(0x80 | (code >> 6 & 0x3F));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                } else {
+                    out += static_cast<char>(0xF0 | code >> 18);
+                    out += static_cast<char>(0x80 | (code >> 12 & 0x3F));
+                    out += static_cast<char>(0x80 | (code >> 6 & 0x3F));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                }
+            }
+
+            std::string ParseString() {
+                if (pos >= text.size() || text[pos] != '"') {
+                    Fail("expected a string");
+                }
+                ++pos;
+                std::string out;
+                while (true) {
+                    if (pos >= text.size()) {
+                        Fail("unterminated string");
+                    }
+                    char c = text[pos++];
+                    if (c == '"') {
+                        return out;
+                    }
+                    if (c != '\\') {
+                        out += c;
+                        continue;
+                    }
+                    if (pos >= text.size()) {
+                        Fail("unterminated string");
+                    }
+                    switch (text[pos++]) {
+                        case '"': out += '"'; break;
+                        case '\\': out += '\\'; break;
+                        case '/': out += '/'; break;
+                        case 'b': out += '\b'; break;
+                        case 'f': out += '\f'; break;
+                        case 'n': out += '\n'; break;
+                        case 'r': out += '\r'; break;
+                        case 't': out += '\t'; break;
+                        case 'u': {
+                            auto code = ParseHex4();
+                            if (code >= 0xD800 && code < 0xDC00 && Consume("\\u")) {
+                                auto low = ParseHex4();
+                                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                            }
+                            AppendUtf8(out, code);
+                            break;
+                        }
+                        default:
+                            Fail("bad escape");
+                    }
+                }
+            }
+
+            JsonValue ParseNumber() {
+                auto begin = pos;
+                while (pos < text.size() && (std::isdigit(static_cast<unsigned char>(text[pos])) || text[pos] == '-' ||
+                                             text[pos] == '+' || text[pos] == '.' || text[pos] == 'e' ||
+                                             text[pos] == 'E')) {
+                    ++pos;
+                }
+                if (begin == pos) {
+                    Fail("unexpected character");
+                }
+                std::string token(text.substr(begin, pos - begin));
+                char *end = nullptr;
+                double number = std::strtod(token.c_str(), &end);
+                if (end != token.c_str() + token.size()) {
+                    pos = begin;
+                    Fail("bad number");
+                }
+                return number;
+            }
+        };
+
+        void DumpString(std::ostream &os, const std::string &s) {
+            os << '"';
+            for (char c: s) {
+                switch (c) {
+                    case '"': os << "\\\""; break;
+                    case '\\': os << "\\\\"; break;
+                    case '\n': os << "\\n"; break;
+                    case '\r': os << "\\r"; break;
+                    case '\t': os << "\\t"; break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20) {
+                            char buffer[8];
+                            std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                            os << buffer;
+                        } else {
+                            os << c;
+                        }
+                }
+            }
+            os << '"';
+        }
+
+        void DumpNumber(std::ostream &os, double d) {
+            if (!std::isfinite(d)) {
+                os << "null";
+                return;
+            }
+            char buffer[32];
+            if (d == std::floor(d) && std::fabs(d) < 1e15) {
+                std::snprintf(buffer, sizeof(buffer), "%.0f", d);
+            } else {
+                std::snprintf(buffer, sizeof(buffer), "%.15g", d);
+            }
+            os << buffer;
+        }
+    }
+
+    bool JsonValue::AsBool() const {
+        if (auto b = std::get_if<bool>(&value)) return *b;
+        throw std::runtime_error("JSON value is not a boolean");
+    }
+
+    double JsonValue::AsNumber() const {
+        if (auto d = std::get_if<double>(&value)) return *d;
+        throw std::runtime_error("JSON value is not a number");
+    }
+
+    const std::string &JsonValue::AsString() const {
+        if (auto s = std::get_if<std::string>(&value)) return *s;
+        throw std::runtime_error("JSON value is not a string");
+    }
+
+    const JsonValue::Array &JsonValue::AsArray() const {
+        if (auto a = std::get_if<Array>(&value)) return *a;
+        throw std::runtime_error("JSON value is not an array");
+    }
+
+    JsonValue::Array &JsonValue::AsArray() {
+        if (auto a = std::get_if<Array>(&value)) return *a;
+        throw std::runtime_error("JSON value is not an array");
+    }
+
+    const JsonValue::Object &JsonValue::AsObject() const {
+        if (auto o = std::get_if<Object>(&value)) return *o;
+        throw std::runtime_error("JSON value is not an object");
+    }
+
+    const JsonValue *JsonValue::Find(std::string_view key) const {
+        for (const auto &[name, member]: AsObject()) {
+            if (name == key) {
+                return &member;
+            }
+        }
+        return nullptr;
+    }
+
+    const JsonValue &JsonValue::At(std::string_view key) const {
+        if (auto member = Find(key)) {
+            return *member;
+        }
+        throw std::runtime_error("JSON object has no member \"" + std::string(key) + "\"");
+    }
+
+    JsonValue &JsonValue::operator[](std::string_view key) {
+        if (IsNull()) {
+            value = Object{};
+        }
+        auto object = std::get_if<Object>(&value);
+        if (!object) {
+            throw std::runtime_error("JSON value is not an object");
+        }
+        for (auto &[name, member]: *object) {
+            if (name == key) {
+                return member;
+            }
+        }
+        return object->emplace_back(std::string(key), JsonValue()).second;
+    }
+
+    JsonValue &JsonValue::Push(JsonValue element) {
+        if (IsNull()) {
+            value = Array{};
+        }
+        return AsArray().emplace_back(std::move(element));
+    }
+
+    JsonValue JsonValue::Parse(std::string_view text) {
+        return JsonParser(text).ParseDocument();
+    }
+
+    JsonValue JsonValue::ParseFile(const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Can not open " + path);
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        try {
+            return Parse(buffer.str());
+        } catch (const std::runtime_error &e) {
+            throw std::runtime_error(path + ": " + e.what());
+        }
+    }
+
+    void JsonValue::Dump(std::ostream &os, int indent) const {
+        _dump(os, indent, 0);
+        if (indent > 0) {
+            os << '\n';
+        }
+    }
+
+    void JsonValue::_dump(std::ostream &os, int indent, int depth) const {
+        auto newline = [&](int level) {
+            if (indent > 0) {
+                os << '\n' << std::string(static_cast<size_t>(indent * level), ' ');
+            }
+        };
+        std::visit([&](const auto &v) {
+            using T = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, std::nullptr_t>) {
+                os << "null";
+            } else if constexpr (std::is_same_v<T, bool>) {
+                os << (v ? "true" : "false");
+            } else if constexpr (std::is_same_v<T, double>) {
+                DumpNumber(os, v);
+            } else if constexpr (std::is_same_v<T, std::string>) {
+                DumpString(os, v);
+            } else if constexpr (std::is_same_v<T, Array>) {
+                // arrays of scalars stay on one line
+                bool flat = std::all_of(v.begin(), v.end(), [](const JsonValue &e) {
+                    return !e.IsArray() && !e.IsObject();
+                }) || std::all_of(v.begin(), v.end(), [](const JsonValue &e) {
+                    return e.IsArray() && e.AsArray().size() <= 4 &&
+                           std::none_of(e.AsArray().begin(), e.AsArray().end(),
+                                        [](const JsonValue &x) { return x.IsArray() || x.IsObject(); });
+                });
+                os << '[';
+                for (size_t i = 0; i < v.size(); ++i) {
+                    if (i > 0) os << (flat && indent > 0 ? ", " : ",");
+                    if (!flat) newline(depth + 1);
+                    v[i]._dump(os, flat ? 0 : indent, depth + 1);
+                }
+                if (!flat && !v.empty()) newline(depth);
+                os << ']';
+            } else {
+                os << '{';
+                for (size_t i = 0; i < v.size(); ++i) {
+                    if (i > 0) os << ',';
+                    newline(depth + 1);
+                    DumpString(os, v[i].first);
+                    os << (indent > 0 ? ": " : ":");
+                    v[i].second._dump(os, indent, depth + 1);
+                }
+                if (!v.empty()) newline(depth);
+                os << '}';
+            }
+        }, value);
+    }
+}
@@ -0,0 +1,121 @@
+//
+// Created by antares on 4/25/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_JSON_H
+#define TESTPROJECT_JSON_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace OnnxBenchmarks {
+    /// A small JSON document model for result files and ORT profiles.
+    /// Objects keep their members in insertion order; numbers are doubles.
+    class JsonValue {
+    public:
+        using Array = std::vector<JsonValue>;
+        using Object = std::vector<std::pair<std::string, JsonValue>>;
+
+    private:
+        std::variant<std::nullptr_t, bool, double, std::string, Array, Object> value;
+
+    public:
+        JsonValue() : value(nullptr) {}
+
+        JsonValue(std::nullptr_t) : value(nullptr) {}
+
+        JsonValue(bool b) : value(b) {}
+
+        JsonValue(double d) : value(d) {}
+
+        JsonValue(int i) : value(static_cast<double>(i)) {}
+
+        JsonValue(int64_t i) : value(static_cast<double>(i)) {}
+
+        JsonValue(uint64_t i) : value(static_cast<double>(i)) {}
+
+        JsonValue(const char *s) : value(std::string(s)) {}
+
+        JsonValue(std::string s) : value(std::move(s)) {}
+
+        JsonValue(Array a) : value(std::move(a)) {}
+
+        JsonValue(Object o) : value(std::move(o)) {}
+
+        [[nodiscard]] bool IsNull() const { return std::holds_alternative<std::nullptr_t>(value); }
+
+        [[nodiscard]] bool IsBool() const { return std::holds_alternative<bool>(value); }
+
+        [[nodiscard]] bool IsNumber() const { return std::holds_alternative<double>(value); }
+
+        [[nodiscard]] bool IsString() const { return std::holds_alternative<std::string>(value); }
+
+        [[nodiscard]] bool IsArray() const { return std::holds_alternative<Array>(value); }
+
+        [[nodiscard]] bool IsObject() const { return std::holds_alternative<Object>(value); }
+
+        // accessors throw std::runtime_error on a type mismatch
+        [[nodiscard]] bool AsBool() const;
+
+        [[nodiscard]] double AsNumber() const;
+
+        [[nodiscard]] const std::string &AsString() const;
+
+        [[nodiscard]] const Array &AsArray() const;
+
+        [[nodiscard]] Array &AsArray();
+
+        [[nodiscard]] const Object &AsObject() const;
+
+        /// Member `key` of an object, nullptr when absent
+        [[nodiscard]] const JsonValue *Find(std::string_view key) const;
+
+        /// Member `key` of an object, throws when absent
+        [[nodiscard]] const JsonValue &At(std::string_view key) const;
+
+        /// Member `key` of an object, inserted as null when absent; a null value becomes an empty object
+        JsonValue &operator[](std::string_view key);
+
+        /// Append to an array; a null value becomes an empty array
+        JsonValue &Push(JsonValue element);
+
+        /// Throws std::runtime_error with the offset of malformed input
+        static JsonValue Parse(std::string_view text);
+
+        static JsonValue ParseFile(const std::string &path);
+
+        /// Pretty-print with `indent` spaces per level, 0 writes everything on one line
+        void Dump(std::ostream &os, int indent = 2) const;
+
+    private:
+        void _dump(std::ostream &os, int indent, int depth) const;
+    };
+}
+
+#endif //TESTPROJECT_JSON_H
@@ -0,0 +1,167 @@
+//
+// Created by antares on 4/2/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "latency_histogram.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+#include <utility>
+
+namespace OnnxBenchmarks {
+    uint64_t LatencyHistogram::LowestEquivalent(size_t index) {
+        if (index < SubBucketCount) {
+            return index;
+        }
+        auto shift = index / SubBucketHalfCount - 1;
+        auto mantissa = index - shift * SubBucketHalfCount;
+        return static_cast<uint64_t>(mantissa) << shift;
+    }
+
+    uint64_t LatencyHistogram::HighestEquivalent(size_t index) {
+        if (index < SubBucketCount) {
+            return index;
+        }
+        auto shift = index / SubBucketHalfCount - 1;
+        auto mantissa = index - shift * SubBucketHalfCount;
+        return ((static_cast<uint64_t>(mantissa) + 1) << shift) - 1;
+    }
+
+    void LatencyHistogram::Record(uint64_t nanoseconds, uint64_t count) {
+        if (count == 0) {
+            return;
+        }
+        counts[IndexOf(nanoseconds)] += count;
+        totalCount += count;
+        sum += static_cast<long double>(nanoseconds) * static_cast<long double>(count);
+        minValue = std::min(minValue, nanoseconds);
+        maxValue = std::max(maxValue, nanoseconds);
+    }
+
+    void LatencyHistogram::Merge(const LatencyHistogram &other) {
+        if (other.totalCount == 0) {
+            return;
+        }
+        for (size_t i = 0; i < BucketCount; ++i) {
+            counts[i] += other.counts[i];
+        }
+        totalCount += other.totalCount;
+        sum += other.sum;
+        minValue = std::min(minValue, other.minValue);
+        maxValue = std::max(maxValue, other.maxValue);
+    }
+
+    void LatencyHistogram::Reset() {
+        counts.fill(0);
+        totalCount = 0;
+        sum = 0;
+        minValue = std::numeric_limits<uint64_t>::max();
+        maxValue = 0;
+    }
+
+    double LatencyHistogram::Mean() const {
+        if (totalCount == 0) {
+            return 0;
+        }
+        return static_cast<double>(sum / static_cast<long double>(totalCount));
+    }
+
+    uint64_t LatencyHistogram::Percentile(double percentile) const {
+        if (totalCount == 0) {
+            return 0;
+        }
+        percentile = std::clamp(percentile, 0., 100.);
+        auto target = static_cast<uint64_t>(std::ceil(percentile / 100. * static_cast<double>(totalCount)));
+        target = std::max<uint64_t>(target, 1);
+
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < BucketCount; ++i) {
+            cumulative += counts[i];
+            if (cumulative >= target) {
+                auto low = LowestEquivalent(i);
+                auto value = low + (HighestEquivalent(i) - low) / 2;
+                return std::clamp(value, Min(), Max());
+            }
+        }
+        return Max();
+    }
+
+    namespace {
+        std::atomic<uint64_t> nextHistogramId{1};
+        /// Bumped by every destroyed collector, so that threads know when to drop their stale shard entries
+        std::atomic<uint64_t> destroyedGeneration{0};
+        std::mutex liveMutex;
+        std::unordered_set<uint64_t> liveIds;
+
+        /// The shards of the calling thread by collector id, as of a generation
+        struct LocalShards {
+            std::vector<std::pair<uint64_t, LatencyHistogram *>> entries;
+            uint64_t generation = 0;
+        };
+    }
+
+    ConcurrentLatencyHistogram::ConcurrentLatencyHistogram() : id(nextHistogramId.fetch_add(1)) {
+        std::lock_guard lock(liveMutex);
+        liveIds.insert(id);
+    }
+
+    ConcurrentLatencyHistogram::~ConcurrentLatencyHistogram() {
+        {
+            std::lock_guard lock(liveMutex);
+            liveIds.erase(id);
+        }
+        destroyedGeneration.fetch_add(1, std::memory_order_release);
+    }
+
+    LatencyHistogram &ConcurrentLatencyHistogram::Local() {
+        // ids are never reused, so a stale entry of a destroyed collector can not alias a new one; the
+        // stale entries are still dropped, or a long-lived thread would collect one per measurement
+        thread_local LocalShards localShards;
+        auto generation = destroyedGeneration.load(std::memory_order_acquire);
+        if (generation != localShards.generation) {
+            std::lock_guard lock(liveMutex);
+            std::erase_if(localShards.entries, [](const auto &entry) { return liveIds.count(entry.first) == 0; });
+            localShards.generation = generation;
+        }
+        for (auto it = localShards.entries.rbegin(); it != localShards.entries.rend(); ++it) {
+            if (it->first == id) {
+                return *it->second;
+            }
+        }
+
+        std::lock_guard lock(mutex);
+        auto &shard = shards.emplace_back(std::make_unique<LatencyHistogram>());
+        localShards.entries.emplace_back(id, shard.get());
+        return *shard;
+    }
+
+    LatencyHistogram ConcurrentLatencyHistogram::Merge() {
+        LatencyHistogram merged;
+        std::lock_guard lock(mutex);
+        for (const auto &shard: shards) {
+            merged.Merge(*shard);
+        }
+        return merged;
+    }
+}
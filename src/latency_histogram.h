@@ -0,0 +1,127 @@
+//
+// Created by antares on 4/2/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_LATENCY_HISTOGRAM_H
+#define TESTPROJECT_LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace OnnxBenchmarks {
+    /// HDR-style log-linear histogram of nanosecond latencies.
+    /// Every power of two is split into 2^(PrecisionBits-1) linear sub-buckets, so the relative error of a
+    /// reported value is below 2^-(PrecisionBits-1) (< 1% with the default). Recording is a couple of bit
+    /// operations and one increment, no allocation and no locking; use one instance per thread and Merge().
+    class LatencyHistogram {
+    public:
+        static constexpr unsigned PrecisionBits = 8;
+        static constexpr uint64_t SubBucketCount = uint64_t(1) << PrecisionBits;
+        static constexpr uint64_t SubBucketHalfCount = SubBucketCount / 2;
+        static constexpr size_t BucketCount = (64 - PrecisionBits + 1) * SubBucketHalfCount + SubBucketHalfCount;
+
+    private:
+        std::array<uint64_t, BucketCount> counts{};
+        uint64_t totalCount = 0;
+        uint64_t minValue = std::numeric_limits<uint64_t>::max();
+        uint64_t maxValue = 0;
+        long double sum = 0;
+
+    public:
+        static size_t IndexOf(uint64_t value) {
+            if (value < SubBucketCount) {
+                return static_cast<size_t>(value);
+            }
+            auto shift = static_cast<unsigned>(63 - __builtin_clzll(value)) - (PrecisionBits - 1);
+            return static_cast<size_t>(shift * SubBucketHalfCount + (value >> shift));
+        }
+
+        /// Smallest value mapped to the bucket
+        static uint64_t LowestEquivalent(size_t index);
+
+        /// Largest value mapped to the bucket
+        static uint64_t HighestEquivalent(size_t index);
+
+        void Record(uint64_t nanoseconds) {
+            ++counts[IndexOf(nanoseconds)];
+            ++totalCount;
+            sum += static_cast<long double>(nanoseconds);
+            if (nanoseconds < minValue) minValue = nanoseconds;
+            if (nanoseconds > maxValue) maxValue = nanoseconds;
+        }
+
+        /// Record `count` samples of the same value, e.g. to rebuild a histogram from its buckets
+        void Record(uint64_t nanoseconds, uint64_t count);
+
+        /// Samples in the bucket, see IndexOf
+        [[nodiscard]] uint64_t CountAt(size_t index) const { return counts[index]; }
+
+        void Merge(const LatencyHistogram &other);
+
+        void Reset();
+
+        [[nodiscard]] uint64_t Count() const { return totalCount; }
+
+        [[nodiscard]] uint64_t Min() const { return totalCount == 0 ? 0 : minValue; }
+
+        [[nodiscard]] uint64_t Max() const { return maxValue; }
+
+        [[nodiscard]] double Mean() const;
+
+        /// Value at the given percentile in [0, 100], reported as the middle of its bucket
+        /// and clamped to the exact min/max.
+        [[nodiscard]] uint64_t Percentile(double percentile) const;
+    };
+
+    /// A set of per-thread histograms that are merged when the measurement is over.
+    /// Local() hands every thread its own shard, so recording from many workers never contends.
+    class ConcurrentLatencyHistogram {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<LatencyHistogram>> shards;
+        const uint64_t id;
+
+    public:
+        ConcurrentLatencyHistogram();
+
+        ~ConcurrentLatencyHistogram();
+
+        ConcurrentLatencyHistogram(const ConcurrentLatencyHistogram &) = delete;
+
+        ConcurrentLatencyHistogram &operator=(const ConcurrentLatencyHistogram &) = delete;
+
+        /// The shard of the calling thread; only the first call of a thread, and the first after some
+        /// collector was destroyed, take a lock.
+        LatencyHistogram &Local();
+
+        /// Merge all shards, call it after every recording thread has finished.
+        [[nodiscard]] LatencyHistogram Merge();
+    };
+}
+
+#endif //TESTPROJECT_LATENCY_HISTOGRAM_H
@@ -5,6 +5,9 @@
 #include "lockfree-threadpool/src/ThreadPool.h"
 #include "model_wrapper.h"
 #include "benchmarks.h"
+#include "options.h"
+#include "model_cache.h"
+#include "cpu_topology.h"
 
 
 int main(int argc, char *argv[]) {
@@ -15,13 +18,42 @@ int main(int argc, char *argv[]) {
                 << std::endl;
         exit(1);
     }
+    if (std::string(argv[1]) == "--help" || std::string(argv[1]) == "-h") {
+        PrintUsage(argv[0]);
+        return 0;
+    }
+
+    BenchmarkOptions options;
+    try {
+        options = ParseOptions(argc, argv);
+    } catch (const std::invalid_argument &e) {
+        std::cerr << e.what() << std::endl << std::endl;
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    // before any session exists, their intra-op threads are placed by it
+    GetThreadPlacement() = ThreadPlacement(options.placement, CpuTopology::Detect());
 
-    OnnxModel model;
-    BenchMark benchMark(&model);
+    SessionConfig config;
+    std::string modelPath = options.modelPath;
+    if (!options.modelCacheDir.empty()) {
+        modelPath = ModelCache(options.modelCacheDir, options.cacheFormat).Prepare(options.modelPath, config);
+    }
+
+    // ORT keeps one Env per process and later Envs share it, so the first one decides whether there are
+    // global thread pools; the main model still runs on its own threads
+    std::shared_ptr<Ort::Env> env;
+    if (NeedsGlobalThreadPools(options)) {
+        auto cores = static_cast<int>(std::thread::hardware_concurrency());
+        env = OnnxModel::CreateEnvWithGlobalThreadPools(cores, 1);
+    }
 
-    model.Initialize(argc, argv);
+    OnnxModel model(config, env);
+    BenchMark benchMark(&model, options);
 
-    benchMark.RunBenchmark();
+    model.SetDynamicDims(DynamicDims{options.shapes, options.dims});
+    model.Load(modelPath.c_str());
 
-    return 0;
+    return benchMark.RunBenchmark();
 }
\ No newline at end of file
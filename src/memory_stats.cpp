@@ -0,0 +1,185 @@
+//
+// Created by antares on 4/28/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "memory_stats.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <malloc.h>
+
+namespace OnnxBenchmarks {
+    namespace {
+        // constant-initialized, so usable by allocations before main
+        std::atomic<bool> countingEnabled{false};
+        std::atomic<uint64_t> allocationCount{0};
+        std::atomic<uint64_t> allocatedBytes{0};
+
+        void CountAllocation(size_t size) {
+            if (countingEnabled.load(std::memory_order_relaxed)) {
+                allocationCount.fetch_add(1, std::memory_order_relaxed);
+                allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    MemoryUsage ReadMemoryUsage() {
+        MemoryUsage usage;
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            size_t kb = 0;
+            if (std::sscanf(line.c_str(), "VmRSS: %zu kB", &kb) == 1) {
+                usage.rss = kb * 1024;
+            } else if (std::sscanf(line.c_str(), "VmHWM: %zu kB", &kb) == 1) {
+                usage.peakRss = kb * 1024;
+            }
+        }
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+        auto info = mallinfo2();
+        usage.heapInUse = info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+        auto info = mallinfo();
+        usage.heapInUse = static_cast<size_t>(static_cast<unsigned>(info.uordblks)) +
+                          static_cast<size_t>(static_cast<unsigned>(info.hblkhd));
+#endif
+        return usage;
+    }
+
+    bool ResetPeakRss() {
+        std::ofstream clearRefs("/proc/self/clear_refs");
+        clearRefs << "5";
+        return static_cast<bool>(clearRefs.flush());
+    }
+
+    bool AllocationCountingSupported() {
+#ifdef __GLIBC__
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void EnableAllocationCounting(bool enable) {
+        countingEnabled.store(enable, std::memory_order_relaxed);
+    }
+
+    AllocationCount ReadAllocationCount() {
+        return {allocationCount.load(std::memory_order_relaxed), allocatedBytes.load(std::memory_order_relaxed)};
+    }
+
+    AllocationCountingScope::AllocationCountingScope() {
+        start = ReadAllocationCount();
+        EnableAllocationCounting(true);
+    }
+
+    AllocationCountingScope::~AllocationCountingScope() {
+        EnableAllocationCounting(false);
+    }
+
+    AllocationCount AllocationCountingScope::Count() const {
+        auto now = ReadAllocationCount();
+        return {now.allocations - start.allocations, now.bytes - start.bytes};
+    }
+}
+
+#ifdef __GLIBC__
+// The executable's definitions take precedence over libc's for every shared library as well. They
+// forward to glibc's allocator, which stays the one that frees the memory.
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+void *__libc_memalign(size_t alignment, size_t size);
+void *__libc_valloc(size_t size);
+void *__libc_pvalloc(size_t size);
+
+void *malloc(size_t size) __THROW {
+    OnnxBenchmarks::CountAllocation(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) __THROW {
+    OnnxBenchmarks::CountAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) __THROW {
+    OnnxBenchmarks::CountAllocation(size);
+    return __libc_realloc(ptr, size);
+}
+
+void *reallocarray(void *ptr, size_t count, size_t size) __THROW {
+    size_t bytes;
+    if (__builtin_mul_overflow(count, size, &bytes)) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    OnnxBenchmarks::CountAllocation(bytes);
+    return __libc_realloc(ptr, bytes);
+}
+
+void free(void *ptr) __THROW {
+    __libc_free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size) __THROW {
+    OnnxBenchmarks::CountAllocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) __THROW {
+    OnnxBenchmarks::CountAllocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) __THROW {
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    OnnxBenchmarks::CountAllocation(size);
+    void *result = __libc_memalign(alignment, size);
+    if (result == nullptr && size != 0) {
+        return ENOMEM;
+    }
+    *ptr = result;
+    return 0;
+}
+
+void *valloc(size_t size) __THROW {
+    OnnxBenchmarks::CountAllocation(size);
+    return __libc_valloc(size);
+}
+
+void *pvalloc(size_t size) __THROW {
+    OnnxBenchmarks::CountAllocation(size);
+    return __libc_pvalloc(size);
+}
+}
+#endif
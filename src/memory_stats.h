@@ -0,0 +1,80 @@
+//
+// Created by antares on 4/28/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_MEMORY_STATS_H
+#define TESTPROJECT_MEMORY_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace OnnxBenchmarks {
+    struct MemoryUsage {
+        size_t rss = 0;
+        /// Peak RSS since the start or the last ResetPeakRss()
+        size_t peakRss = 0;
+        /// Bytes handed out by malloc (including mmapped chunks), where the ORT CPU arena reserves its memory
+        size_t heapInUse = 0;
+    };
+
+    /// Read from /proc/self/status and mallinfo, zeros where unavailable
+    MemoryUsage ReadMemoryUsage();
+
+    /// Reset the peak RSS to the current RSS (/proc/self/clear_refs), returns false where unsupported
+    bool ResetPeakRss();
+
+    struct AllocationCount {
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+    };
+
+    /// The malloc family is interposed (glibc only), so every heap allocation of the process is seen,
+    /// including operator new and ORT's own allocators. Counting costs one relaxed load per allocation
+    /// while disabled and two atomic increments while enabled.
+    bool AllocationCountingSupported();
+
+    void EnableAllocationCounting(bool enable);
+
+    /// Allocations since the start of the process, counted while enabled
+    AllocationCount ReadAllocationCount();
+
+    /// Counts allocations for its lifetime
+    class AllocationCountingScope {
+        AllocationCount start;
+
+    public:
+        AllocationCountingScope();
+
+        AllocationCountingScope(const AllocationCountingScope &) = delete;
+
+        AllocationCountingScope &operator=(const AllocationCountingScope &) = delete;
+
+        ~AllocationCountingScope();
+
+        /// Allocations since the scope began
+        [[nodiscard]] AllocationCount Count() const;
+    };
+}
+
+#endif //TESTPROJECT_MEMORY_STATS_H
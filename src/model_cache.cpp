@@ -0,0 +1,99 @@
+//
+// Created by antares on 4/26/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "model_cache.h"
+#include "benchmarks.h"
+#include "dataset.h"
+#include <cstdio>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace OnnxBenchmarks {
+    namespace {
+        constexpr uint64_t FnvOffsetBasis = 14695981039346656037ull;
+        constexpr uint64_t FnvPrime = 1099511628211ull;
+
+        uint64_t Fnv1a(const void *data, size_t size, uint64_t hash = FnvOffsetBasis) {
+            auto bytes = static_cast<const unsigned char *>(data);
+            for (size_t i = 0; i < size; ++i) {
+                hash = (hash ^ bytes[i]) * FnvPrime;
+            }
+            return hash;
+        }
+
+        uint64_t Fnv1a(const std::string &s, uint64_t hash) {
+            return Fnv1a(s.data(), s.size() + 1, hash);
+        }
+    }
+
+    ModelCache::ModelCache(std::string inDirectory, CacheFormat inFormat) : directory(std::move(inDirectory)),
+                                                                            format(inFormat) {
+        std::filesystem::create_directories(directory);
+    }
+
+    std::string ModelCache::EntryPath(const std::string &modelPath, const SessionConfig &config) const {
+        MappedFile file(modelPath);
+        auto hash = Fnv1a(file.Data(), file.Size());
+        hash = Fnv1a(Ort::GetVersionString(), hash);
+        hash = Fnv1a(std::to_string(static_cast<int>(config.optimizationLevel)), hash);
+#ifdef CUDA_ENABLED
+        hash = Fnv1a("cuda", hash);
+#endif
+        hash = Fnv1a(config.executionProvider, hash);
+        const char *extension = format == CacheFormat::Ort ? ".ort" : ".onnx";
+        hash = Fnv1a(extension, hash);
+
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+        auto stem = std::filesystem::path(modelPath).stem().string();
+        return (std::filesystem::path(directory) / (stem + "-" + hex + extension)).string();
+    }
+
+    std::string ModelCache::Prepare(const std::string &modelPath, SessionConfig &config) const {
+        auto entry = EntryPath(modelPath, config);
+        if (std::filesystem::exists(entry)) {
+            Logging("Loading optimized model from cache: ", entry);
+            config.optimizationLevel = ORT_DISABLE_ALL;
+            config.optimizedModelPath.clear();
+            return entry;
+        }
+        Logging("Optimized model not cached yet, saving it to ", entry);
+        config.optimizedModelPath = entry;
+        return modelPath;
+    }
+
+    void EvictFromPageCache(const std::string &path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        fdatasync(fd);
+        if (posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) != 0) {
+            Warning("Can not evict ", path, " from the page cache, cold loads may be warm");
+        }
+        close(fd);
+    }
+}
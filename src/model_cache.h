@@ -0,0 +1,56 @@
+//
+// Created by antares on 4/26/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_MODEL_CACHE_H
+#define TESTPROJECT_MODEL_CACHE_H
+
+#include <string>
+#include "model_wrapper.h"
+#include "options.h"
+
+namespace OnnxBenchmarks {
+    /// On-disk cache of optimized models. Entries are keyed by a hash of the model file and of everything
+    /// that changes the optimized graph (ORT version, optimization level, execution providers, format),
+    /// so a stale entry is never picked up after an upgrade.
+    class ModelCache {
+        std::string directory;
+        CacheFormat format;
+
+    public:
+        ModelCache(std::string inDirectory, CacheFormat inFormat);
+
+        /// Path of the cache entry of `modelPath` loaded with `config`; it may not exist yet.
+        [[nodiscard]] std::string EntryPath(const std::string &modelPath, const SessionConfig &config) const;
+
+        /// Set up `config` to use the cache: returns the entry to load with graph optimizations off when it
+        /// exists, otherwise `modelPath` with `config` set to write the entry while loading.
+        std::string Prepare(const std::string &modelPath, SessionConfig &config) const;
+    };
+
+    /// Drop the clean page cache pages of a file, so that the next read comes from disk
+    void EvictFromPageCache(const std::string &path);
+}
+
+#endif //TESTPROJECT_MODEL_CACHE_H
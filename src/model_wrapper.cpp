@@ -25,8 +25,11 @@
 
 #include "model_wrapper.h"
 #include <thread>
+#include <algorithm>
 #include "lockfree-threadpool/src/MemoryPool/src/MemoryPool.h"
 #include "benchmarks.h"
+#include "tensor_utils.h"
+#include "cpu_topology.h"
 
 namespace OnnxBenchmarks {
     struct Defer {
@@ -43,34 +46,164 @@ namespace OnnxBenchmarks {
         return memoryInfo;
     }
 
-    OnnxModel::OnnxModel() { // NOLINT(cppcoreguidelines-pro-type-member-init)
-        env = Ort::Env(ORT_LOGGING_LEVEL_WARNING, "test");
+    namespace {
+        /// Our names of the CPU execution providers and ORT's
+        const std::map<std::string, std::string> &ProviderIds() {
+            static const std::map<std::string, std::string> ids{
+                    {"cpu",      "CPUExecutionProvider"},
+                    {"xnnpack",  "XnnpackExecutionProvider"},
+                    {"dnnl",     "DnnlExecutionProvider"},
+                    {"openvino", "OpenVINOExecutionProvider"},
+            };
+            return ids;
+        }
+
+        void AppendExecutionProvider(Ort::SessionOptions &sessionOptions, const std::string &provider,
+                                     const std::map<std::string, std::string> &providerOptions) {
+            if (provider == "xnnpack") {
+                sessionOptions.AppendExecutionProvider("XNNPACK", {providerOptions.begin(), providerOptions.end()});
+            } else if (provider == "dnnl") {
+                const auto &api = Ort::GetApi();
+                OrtDnnlProviderOptions *dnnlOptions = nullptr;
+                Ort::ThrowOnError(api.CreateDnnlProviderOptions(&dnnlOptions));
+                Defer release([&api, dnnlOptions] { api.ReleaseDnnlProviderOptions(dnnlOptions); });
+                std::vector<const char *> keys, values;
+                for (const auto &[key, value]: providerOptions) {
+                    keys.emplace_back(key.c_str());
+                    values.emplace_back(value.c_str());
+                }
+                Ort::ThrowOnError(api.UpdateDnnlProviderOptions(dnnlOptions, keys.data(), values.data(), keys.size()));
+                Ort::ThrowOnError(api.SessionOptionsAppendExecutionProvider_Dnnl(sessionOptions, dnnlOptions));
+            } else if (provider == "openvino") {
+                std::unordered_map<std::string, std::string> openVinoOptions{{"device_type", "CPU"}};
+                for (const auto &[key, value]: providerOptions) {
+                    openVinoOptions[key] = value;
+                }
+                sessionOptions.AppendExecutionProvider_OpenVINO_V2(openVinoOptions);
+            } else if (!provider.empty() && provider != "cpu") {
+                throw std::invalid_argument("Unknown execution provider: " + provider);
+            }
+        }
+    }
+
+    bool ExecutionProviderAvailable(const std::string &provider) {
+        if (provider.empty()) {
+            return true;
+        }
+        auto id = ProviderIds().find(provider);
+        if (id == ProviderIds().end()) {
+            return false;
+        }
+        auto available = Ort::GetAvailableProviders();
+        return std::find(available.begin(), available.end(), id->second) != available.end();
+    }
+
+    OnnxModel::OnnxModel() : OnnxModel(SessionConfig{}) {}
+
+    OnnxModel::OnnxModel(const SessionConfig &config, std::shared_ptr<Ort::Env> sharedEnv) // NOLINT(cppcoreguidelines-pro-type-member-init)
+            : env(std::move(sharedEnv)), sessionConfig(config) {
+        // saving the optimized graph is a side effect of this load, sessions copied from the config skip it
+        sessionConfig.optimizedModelPath.clear();
+        if (!env) {
+            if (config.useGlobalThreadPools) {
+                throw std::invalid_argument("Global thread pools need a shared Env");
+            }
+            env = std::make_shared<Ort::Env>(ORT_LOGGING_LEVEL_WARNING, "test");
+        }
 #ifdef CUDA_ENABLED
         Logging("Note: CUDA enabled");
         OrtCUDAProviderOptions options;
         options.device_id = 0;
         session_options.AppendExecutionProvider_CUDA(options);
 #endif
-        session_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
-        session_options.EnableCpuMemArena();
-        session_options.EnableMemPattern();
-        auto maxThread = std::thread::hardware_concurrency();
-        session_options.SetIntraOpNumThreads(static_cast<int>(maxThread));
-        session_options.SetInterOpNumThreads(static_cast<int>(maxThread));
+        AppendExecutionProvider(session_options, config.executionProvider, config.providerOptions);
+        session_options.SetGraphOptimizationLevel(config.optimizationLevel);
+        session_options.SetExecutionMode(config.executionMode);
+        if (config.allowSpinning >= 0) {
+            const char *spinning = config.allowSpinning ? "1" : "0";
+            session_options.AddConfigEntry("session.intra_op.allow_spinning", spinning);
+            session_options.AddConfigEntry("session.inter_op.allow_spinning", spinning);
+        }
+        if (config.denormalAsZero) {
+            session_options.AddConfigEntry("session.set_denormal_as_zero", "1");
+        }
+        if (!config.optimizedModelPath.empty()) {
+            session_options.SetOptimizedModelFilePath(config.optimizedModelPath.c_str());
+        }
+        if (!config.profilePrefix.empty()) {
+            session_options.EnableProfiling(config.profilePrefix.c_str());
+        }
+        if (config.memArena) {
+            session_options.EnableCpuMemArena();
+        } else {
+            session_options.DisableCpuMemArena();
+        }
+        if (config.memPattern) {
+            session_options.EnableMemPattern();
+        } else {
+            session_options.DisableMemPattern();
+        }
+        if (config.memArena && config.arenaExtendStrategy >= 0) {
+            // the CPU EP takes its arena settings only from an allocator registered on the Env
+            Ort::ArenaCfg arenaCfg(0, config.arenaExtendStrategy, -1, -1);
+            env->CreateAndRegisterAllocator(GetMemoryInfo(), arenaCfg);
+            envAllocatorRegistered = true;
+            session_options.AddConfigEntry("session.use_env_allocators", "1");
+        }
+        if (config.useGlobalThreadPools) {
+            session_options.DisablePerSessionThreads();
+        } else {
+            auto maxThread = static_cast<int>(std::thread::hardware_concurrency());
+            auto intraOpThreads = config.intraOpThreads > 0 ? config.intraOpThreads : maxThread;
+            session_options.SetIntraOpNumThreads(intraOpThreads);
+            session_options.SetInterOpNumThreads(config.interOpThreads > 0 ? config.interOpThreads : maxThread);
+
+            auto affinities = config.intraOpThreadAffinities;
+            if (affinities.empty() && !config.unpinnedThreads) {
+                affinities = GetThreadPlacement().IntraOpAffinities(static_cast<size_t>(intraOpThreads), 1);
+            }
+            if (!affinities.empty()) {
+                session_options.AddConfigEntry("session.intra_op_thread_affinities", affinities.c_str());
+            }
+        }
     }
 
     OnnxModel::~OnnxModel() {
+        if (envAllocatorRegistered) {
+            session.reset();
+            Ort::Status status(Ort::GetApi().UnregisterAllocator(*env, GetMemoryInfo()));
+            if (!status.IsOK()) {
+                Warning("Can not unregister the arena allocator: ", status.GetErrorMessage());
+            }
+        }
         delete[] inNamePointers;
         delete[] outNamePointers;
     }
 
+    std::shared_ptr<Ort::Env> OnnxModel::CreateEnvWithGlobalThreadPools(int intraOpThreads, int interOpThreads) {
+        Ort::ThreadingOptions threadingOptions;
+        threadingOptions.SetGlobalIntraOpNumThreads(intraOpThreads);
+        threadingOptions.SetGlobalInterOpNumThreads(interOpThreads);
+        auto affinities = GetThreadPlacement().IntraOpAffinities(static_cast<size_t>(intraOpThreads), 1);
+        if (!affinities.empty()) {
+            Ort::ThrowOnError(Ort::GetApi().SetGlobalIntraOpThreadAffinity(threadingOptions, affinities.c_str()));
+        }
+        // the global threads are created here and would inherit the affinity of a pinned caller
+        UnpinnedScope unpinned;
+        return std::make_shared<Ort::Env>(threadingOptions, ORT_LOGGING_LEVEL_WARNING, "test");
+    }
+
     void OnnxModel::Initialize(size_t argc, char **argv) {
         if (argc <= 1) {
             throw std::length_error("Not enough arguments");
         }
 
+        Load(argv[1]);
+    }
 
+    void OnnxModel::Load(const char *modelPath) {
         std::chrono::high_resolution_clock::duration duration;
+        loadedPath = modelPath;
 
         {
             std::unique_ptr<BenchMark::ClockGuard> clockGuard;
@@ -78,11 +211,13 @@ namespace OnnxBenchmarks {
                 clockGuard = std::make_unique<BenchMark::ClockGuard>(duration);
             }
 
-            session = std::make_unique<Ort::Session>(env, argv[1], session_options);
+            // ORT threads without an explicit affinity would inherit the one of a pinned caller
+            UnpinnedScope unpinned;
+            session = std::make_unique<Ort::Session>(*env, modelPath, session_options);
         }
 
         if (benchMark) {
-            Logging("Time used to load model ", argv[1], ": ",
+            Logging("Time used to load model ", modelPath, ": ",
                     std::chrono::duration_cast<std::chrono::milliseconds>(duration).count(), "ms");
         }
 
@@ -91,10 +226,12 @@ namespace OnnxBenchmarks {
         outputLen = session->GetOutputCount();
         inputNames.reserve(inputLen);
         outputNames.reserve(outputLen);
-        inputDims.resize(inputLen);
-        outputDims.resize(outputLen);
-        inBufferLenEachDim.reserve(inputLen);
-        outBufferLenEachDim.reserve(outputLen);
+        inputModelDims.resize(inputLen);
+        outputModelDims.resize(outputLen);
+        inputSymbols.resize(inputLen);
+        outputSymbols.resize(outputLen);
+        inputTypes.reserve(inputLen);
+        outputTypes.reserve(outputLen);
 
         {
             auto allocator = Ort::AllocatorWithDefaultOptions();
@@ -112,10 +249,6 @@ namespace OnnxBenchmarks {
         for (size_t i = 0; i < inputNames.size(); i++) {
             auto inputTypeInfo = session->GetInputTypeInfo(i);
             auto tensorInfo = inputTypeInfo.GetTensorTypeAndShapeInfo();
-            auto sizeLen = tensorInfo.GetDimensionsCount();
-            auto &dim = inputDims[i];
-            dim.reserve(sizeLen);
-            size_t bufferLen = 1;
 
             if (i == 0) {
                 batchSupported = tensorInfo.GetShape()[0] == -1;
@@ -123,42 +256,131 @@ namespace OnnxBenchmarks {
                 batchSupported = batchSupported && tensorInfo.GetShape()[0] == -1;
             }
 
-            for (size_t j = 0; j < sizeLen; ++j) {
-                auto val = tensorInfo.GetShape()[j];
-                dim.emplace_back(val);
-                if (val > 0) {
-                    bufferLen *= val;
-                }
+            inputModelDims[i] = tensorInfo.GetShape();
+            for (auto symbol: tensorInfo.GetSymbolicDimensions()) {
+                inputSymbols[i].emplace_back(symbol ? symbol : "");
             }
-
-            inBufferLenEachDim.emplace_back(bufferLen);
+            inputTypes.emplace_back(tensorInfo.GetElementType());
+            static_cast<void>(ElementSize(inputTypes.back()));
         }
 
         for (size_t i = 0; i < outputNames.size(); i++) {
             auto outputTypeInfo = session->GetOutputTypeInfo(i);
             auto tensorInfo = outputTypeInfo.GetTensorTypeAndShapeInfo();
-            auto sizeLen = tensorInfo.GetDimensionsCount();
-            auto &dim = outputDims[i];
-            dim.reserve(sizeLen);
-            size_t bufferLen = 1;
 
-            for (size_t j = 0; j < sizeLen; ++j) {
-                auto val = tensorInfo.GetShape()[j];
-                dim.emplace_back(val);
-                if (val > 0) {
-                    bufferLen *= val;
+            outputModelDims[i] = tensorInfo.GetShape();
+            for (auto symbol: tensorInfo.GetSymbolicDimensions()) {
+                outputSymbols[i].emplace_back(symbol ? symbol : "");
+            }
+            outputTypes.emplace_back(tensorInfo.GetElementType());
+            static_cast<void>(ElementSize(outputTypes.back()));
+        }
+
+        SetDynamicDims(dynamicDims);
+
+        _gen_name_pointer();
+    }
+
+    void OnnxModel::SetDynamicDims(const DynamicDims &dims) {
+        if (!session) {
+            dynamicDims = dims;
+            return;
+        }
+
+        for (const auto &[name, shape]: dims.shapes) {
+            if (std::find(inputNames.begin(), inputNames.end(), name) == inputNames.end()) {
+                throw std::invalid_argument("Shape override for unknown input: " + name);
+            }
+        }
+
+        // symbol values: explicit ones first, then the ones implied by shape overrides
+        auto symbols = dims.symbols;
+        inputDims = inputModelDims;
+        for (size_t i = 0; i < inputLen; ++i) {
+            auto it = dims.shapes.find(inputNames[i]);
+            if (it == dims.shapes.end()) {
+                continue;
+            }
+            const auto &shape = it->second;
+            auto &dim = inputDims[i];
+            if (shape.size() != dim.size()) {
+                throw std::invalid_argument("Shape override of " + inputNames[i] + " has rank " +
+                                            std::to_string(shape.size()) + ", expected " +
+                                            std::to_string(dim.size()));
+            }
+            // the batch dimension stays under the benchmark's control
+            for (size_t j = batchSupported ? 1 : 0; j < dim.size(); ++j) {
+                if (dim[j] > 0 && shape[j] != dim[j]) {
+                    throw std::invalid_argument("Shape override of " + inputNames[i] + " changes static dimension " +
+                                                std::to_string(j));
+                }
+                if (dim[j] <= 0 && j < inputSymbols[i].size() && !inputSymbols[i][j].empty()) {
+                    symbols.emplace(inputSymbols[i][j], shape[j]);
+                }
+                dim[j] = shape[j];
+            }
+        }
+
+        inBufferLenEachDim.clear();
+        inBufferBytesEachDim.clear();
+        inBufferStrideEachDim.clear();
+        for (size_t i = 0; i < inputLen; ++i) {
+            auto &dim = inputDims[i];
+            size_t bufferLen = 1;
+            for (size_t j = batchSupported ? 1 : 0; j < dim.size(); ++j) {
+                if (dim[j] <= 0) {
+                    auto symbol = j < inputSymbols[i].size() ? inputSymbols[i][j] : std::string();
+                    auto it = symbols.find(symbol);
+                    if (!symbol.empty() && it != symbols.end()) {
+                        dim[j] = it->second;
+                    } else {
+                        Warning("Dynamic dimension ", j, (symbol.empty() ? "" : " (" + symbol + ")"), " of input ",
+                                inputNames[i], " is not set, using 1. Set it with --shape or --dim");
+                        dim[j] = 1;
+                    }
                 }
+                bufferLen *= static_cast<size_t>(dim[j]);
             }
+            inBufferLenEachDim.emplace_back(bufferLen);
+            inBufferBytesEachDim.emplace_back(bufferLen * ElementSize(inputTypes[i]));
+            inBufferStrideEachDim.emplace_back(AlignTensorBytes(inBufferBytesEachDim.back()));
+        }
 
+        // outputs whose shape can not be derived from the symbols are allocated by ORT on every run
+        outputDims = outputModelDims;
+        outBufferLenEachDim.clear();
+        outBufferBytesEachDim.clear();
+        outBufferStrideEachDim.clear();
+        outputDynamic.assign(outputLen, false);
+        for (size_t i = 0; i < outputLen; ++i) {
+            auto &dim = outputDims[i];
+            size_t bufferLen = 1;
+            for (size_t j = batchSupported ? 1 : 0; j < dim.size(); ++j) {
+                if (dim[j] <= 0) {
+                    auto symbol = j < outputSymbols[i].size() ? outputSymbols[i][j] : std::string();
+                    auto it = symbols.find(symbol);
+                    if (symbol.empty() || it == symbols.end()) {
+                        outputDynamic[i] = true;
+                        break;
+                    }
+                    dim[j] = it->second;
+                }
+                bufferLen *= static_cast<size_t>(dim[j]);
+            }
+            if (outputDynamic[i]) {
+                bufferLen = 0;
+            }
             outBufferLenEachDim.emplace_back(bufferLen);
+            outBufferBytesEachDim.emplace_back(bufferLen * ElementSize(outputTypes[i]));
+            outBufferStrideEachDim.emplace_back(AlignTensorBytes(outBufferBytesEachDim.back()));
         }
 
-        _gen_name_pointer();
+        dynamicDims = dims;
     }
 
     size_t OnnxModel::GetInputBufferSize() const {
         size_t size = 0;
-        for (const auto &value: inBufferLenEachDim) {
+        for (const auto &value: inBufferStrideEachDim) {
             size += value;
         }
         return size;
@@ -166,45 +388,150 @@ namespace OnnxBenchmarks {
 
     size_t OnnxModel::GetOutputBufferSize() const {
         size_t size = 0;
-        for (const auto &value: outBufferLenEachDim) {
+        for (const auto &value: outBufferStrideEachDim) {
+            size += value;
+        }
+        return size;
+    }
+
+    size_t OnnxModel::GetInputDataSize() const {
+        size_t size = 0;
+        for (const auto &value: inBufferBytesEachDim) {
             size += value;
         }
         return size;
     }
 
-    void OnnxModel::Run(float *inBuffer, float *outBuffer, int64_t batch) {
+    void OnnxModel::Run(void *inBuffer, void *outBuffer, int64_t batch) {
         auto inValues = _create_in_values(inBuffer, batch);
         auto outValues = _create_out_values(outBuffer, batch);
         session->Run(Ort::RunOptions{nullptr}, inNamePointers, inValues, inputLen, outNamePointers, outValues,
                      outputLen);
-        Antares::MemoryPool::Free(inValues);
-        Antares::MemoryPool::Free(outValues);
+        _free_values(inValues, inputLen);
+        _free_values(outValues, outputLen);
+    }
+
+    namespace {
+        /// Everything a run in flight refers to, owned by it until its completion callback
+        struct AsyncRunState {
+            std::vector<Ort::Value> inValues;
+            std::vector<Ort::Value> outValues;
+            OnnxModel::RunCallback callback;
+
+            static void OnComplete(void *userData, OrtValue **, size_t, OrtStatus *statusPtr) {
+                std::unique_ptr<AsyncRunState> state(static_cast<AsyncRunState *>(userData));
+                Ort::Status status(statusPtr);
+                std::exception_ptr error;
+                if (!status.IsOK()) {
+                    error = std::make_exception_ptr(std::runtime_error(status.GetErrorMessage()));
+                }
+                // release the tensors before signalling, the caller may reuse the buffers right away
+                auto callback = std::move(state->callback);
+                state.reset();
+                callback(error);
+            }
+        };
+    }
+
+    void OnnxModel::RunAsync(void *inBuffer, void *outBuffer, int64_t batch, RunCallback callback) {
+        auto state = std::make_unique<AsyncRunState>();
+        auto in = _create_in_values(inBuffer, batch);
+        auto out = _create_out_values(outBuffer, batch);
+        state->inValues.reserve(inputLen);
+        state->outValues.reserve(outputLen);
+        for (size_t i = 0; i < inputLen; ++i) {
+            state->inValues.emplace_back(std::move(in[i]));
+        }
+        for (size_t i = 0; i < outputLen; ++i) {
+            state->outValues.emplace_back(std::move(out[i]));
+        }
+        _free_values(in, inputLen);
+        _free_values(out, outputLen);
+        state->callback = std::move(callback);
+
+        // the completion may run before RunAsync returns, so the state is handed over first
+        auto raw = state.release();
+        try {
+            session->RunAsync(Ort::RunOptions{nullptr}, inNamePointers, raw->inValues.data(), inputLen,
+                              outNamePointers, raw->outValues.data(), outputLen, &AsyncRunState::OnComplete, raw);
+        } catch (...) {
+            delete raw;
+            throw;
+        }
+    }
+
+    std::future<void> OnnxModel::RunAsync(void *inBuffer, void *outBuffer, int64_t batch) {
+        auto promise = std::make_shared<std::promise<void>>();
+        auto future = promise->get_future();
+        RunAsync(inBuffer, outBuffer, batch, [promise](std::exception_ptr error) {
+            if (error) {
+                promise->set_exception(error);
+            } else {
+                promise->set_value();
+            }
+        });
+        return future;
     }
 
-    void OnnxModel::RunWithOutIndex(size_t index, float *inBuffer, float *outBuffer, int64_t batch) {
+    void OnnxModel::RunWithOutIndex(size_t index, void *inBuffer, void *outBuffer, int64_t batch) {
         auto inValues = _create_in_values(inBuffer, batch);
         auto outValue = _create_out_value_index(index, outBuffer, batch);
         session->Run(Ort::RunOptions{nullptr}, inNamePointers, inValues, inputLen, &outNamePointers[index], &outValue,
                      1);
-        Antares::MemoryPool::Free(inValues);
+        _free_values(inValues, inputLen);
     }
 
-    void OnnxModel::RunWithOutIndexes(std::vector<size_t> indexes, float *inBuffer, float *outBuffer, int64_t batch) {
+    void OnnxModel::RunWithOutIndexes(std::vector<size_t> indexes, void *inBuffer, void *outBuffer, int64_t batch) {
         auto inValues = _create_in_values(inBuffer, batch);
         auto outValues = (Ort::Value *) Antares::MemoryPool::MallocTemp(indexes.size() * sizeof(Ort::Value),
                                                                         alignof(Ort::Value));
         for (size_t i = 0; i < indexes.size(); ++i) {
             new(outValues + i) Ort::Value(_create_out_value_index(indexes[i], outBuffer, batch));
-            outBuffer += batch * outBufferLenEachDim[indexes[i]];
+            outBuffer = static_cast<std::byte *>(outBuffer) + batch * outBufferStrideEachDim[indexes[i]];
         }
         auto names = _get_outnames_by_indexes(indexes);
         session->Run(Ort::RunOptions{nullptr}, inNamePointers, inValues, inputLen, names, outValues,
                      indexes.size());
-        Antares::MemoryPool::Free(inValues);
-        Antares::MemoryPool::Free(outValues);
+        _free_values(inValues, inputLen);
+        _free_values(outValues, indexes.size());
         Antares::MemoryPool::Free(names);
     }
 
+    std::string OnnxModel::EndProfiling() {
+        Ort::AllocatorWithDefaultOptions allocator;
+        return session->EndProfilingAllocated(allocator).get();
+    }
+
+    PreparedRun OnnxModel::Prepare(void *inBuffer, void *outBuffer, int64_t batch) {
+        return {*this, inBuffer, outBuffer, batch};
+    }
+
+    PreparedRun::PreparedRun(OnnxModel &model, void *inBuffer, void *outBuffer, int64_t batch)
+            : session(model.session.get()), binding(*model.session) {
+        auto in = model._create_in_values(inBuffer, batch);
+        auto out = model._create_out_values(outBuffer, batch);
+        inValues.reserve(model.inputLen);
+        outValues.reserve(model.outputLen);
+        for (size_t i = 0; i < model.inputLen; ++i) {
+            inValues.emplace_back(std::move(in[i]));
+            binding.BindInput(model.inNamePointers[i], inValues.back());
+        }
+        for (size_t i = 0; i < model.outputLen; ++i) {
+            outValues.emplace_back(std::move(out[i]));
+            if (model.outputDynamic[i]) {
+                binding.BindOutput(model.outNamePointers[i], GetMemoryInfo());
+            } else {
+                binding.BindOutput(model.outNamePointers[i], outValues.back());
+            }
+        }
+        OnnxModel::_free_values(in, model.inputLen);
+        OnnxModel::_free_values(out, model.outputLen);
+    }
+
+    void PreparedRun::Run() {
+        session->Run(runOptions, binding);
+    }
+
     void OnnxModel::_gen_name_pointer() {
         inNamePointers = new const char *[inputLen];
         outNamePointers = new const char *[outputLen];
@@ -228,9 +555,10 @@ namespace OnnxBenchmarks {
         return answer;
     }
 
-    Ort::Value *OnnxModel::_create_in_values(float *inBuffer, size_t batchNum) const {
+    Ort::Value *OnnxModel::_create_in_values(void *inBuffer, size_t batchNum) const {
         auto valueBuffer = (Ort::Value *) Antares::MemoryPool::MallocTemp(inputLen * sizeof(Ort::Value),
                                                                           alignof(Ort::Value));
+        auto data = static_cast<std::byte *>(inBuffer);
         for (size_t i = 0; i < inputLen; ++i) {
             if (batchSupported) {
                 auto dimsArray = Antares::MemoryPool::NewTempArray<int64_t>(inputDims[i].size());
@@ -239,46 +567,44 @@ namespace OnnxBenchmarks {
                     dimsArray[j] = inputDims[i][j];
                 }
                 new(valueBuffer + i) Ort::Value(
-                        Ort::Value::CreateTensor<float>(GetMemoryInfo(), inBuffer, batchNum * inBufferLenEachDim[i],
-                                                        dimsArray, inputDims[i].size()));
+                        Ort::Value::CreateTensor(GetMemoryInfo(), data, batchNum * inBufferBytesEachDim[i],
+                                                 dimsArray, inputDims[i].size(), inputTypes[i]));
                 Antares::MemoryPool::DeleteArray(dimsArray, inputDims[i].size());
             } else {
                 new(valueBuffer + i) Ort::Value(
-                        Ort::Value::CreateTensor<float>(GetMemoryInfo(), inBuffer, batchNum * inBufferLenEachDim[i],
-                                                        inputDims[i].data(), inputDims[i].size()));
+                        Ort::Value::CreateTensor(GetMemoryInfo(), data, batchNum * inBufferBytesEachDim[i],
+                                                 inputDims[i].data(), inputDims[i].size(), inputTypes[i]));
             }
-            inBuffer += batchNum * inBufferLenEachDim[i];
+            data += batchNum * inBufferStrideEachDim[i];
         }
 
         return valueBuffer;
     }
 
-    Ort::Value *OnnxModel::_create_out_values(float *outBuffer, size_t batchNum) const {
+    Ort::Value *OnnxModel::_create_out_values(void *outBuffer, size_t batchNum) const {
         auto valueBuffer = (Ort::Value *) Antares::MemoryPool::MallocTemp(outputLen * sizeof(Ort::Value),
                                                                           alignof(Ort::Value));
+        auto data = static_cast<std::byte *>(outBuffer);
         for (size_t i = 0; i < outputLen; ++i) {
-            if (batchSupported) {
-                auto dimsArray = Antares::MemoryPool::NewTempArray<int64_t>(outputDims[i].size());
-                dimsArray[0] = static_cast<int64_t>(batchNum);
-                for (size_t j = 1; j < outputDims[i].size(); ++j) {
-                    dimsArray[j] = outputDims[i][j];
-                }
-                new(valueBuffer + i) Ort::Value(
-                        Ort::Value::CreateTensor<float>(GetMemoryInfo(), outBuffer, batchNum * outBufferLenEachDim[i],
-                                                        dimsArray, outputDims[i].size()));
-                Antares::MemoryPool::DeleteArray(dimsArray, outputDims[i].size());
-            } else {
-                new(valueBuffer + i) Ort::Value(
-                        Ort::Value::CreateTensor<float>(GetMemoryInfo(), outBuffer, batchNum * outBufferLenEachDim[i],
-                                                        outputDims[i].data(), outputDims[i].size()));
-            }
-            outBuffer += batchNum * outBufferLenEachDim[i];
+            new(valueBuffer + i) Ort::Value(_create_out_value_index(i, data, batchNum));
+            data += batchNum * outBufferStrideEachDim[i];
         }
 
         return valueBuffer;
     }
 
-    Ort::Value OnnxModel::_create_out_value_index(size_t index, float *outBuffer, size_t batchNum) const {
+    void OnnxModel::_free_values(Ort::Value *values, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            values[i].~Value();
+        }
+        Antares::MemoryPool::Free(values);
+    }
+
+    Ort::Value OnnxModel::_create_out_value_index(size_t index, void *outBuffer, size_t batchNum) const {
+        if (outputDynamic[index]) {
+            // ORT allocates it during Run
+            return Ort::Value{nullptr};
+        }
         if (batchSupported) {
             auto dimsArray = Antares::MemoryPool::NewTempArray<int64_t>(outputDims[index].size());
             auto size = outputDims[index].size();
@@ -289,13 +615,11 @@ namespace OnnxBenchmarks {
             for (size_t j = 1; j < outputDims[index].size(); ++j) {
                 dimsArray[j] = outputDims[index][j];
             }
-            return Ort::Value::CreateTensor<float>(GetMemoryInfo(), outBuffer, batchNum * outBufferLenEachDim[index],
-                                                   dimsArray, outputDims[index].size());
+            return Ort::Value::CreateTensor(GetMemoryInfo(), outBuffer, batchNum * outBufferBytesEachDim[index],
+                                            dimsArray, outputDims[index].size(), outputTypes[index]);
         } else {
-            return Ort::Value::CreateTensor<float>(GetMemoryInfo(), outBuffer, batchNum * outBufferLenEachDim[index],
-                                                   outputDims[index].data(), outputDims[index].size());
+            return Ort::Value::CreateTensor(GetMemoryInfo(), outBuffer, batchNum * outBufferBytesEachDim[index],
+                                            outputDims[index].data(), outputDims[index].size(), outputTypes[index]);
         }
     }
-
-
 }
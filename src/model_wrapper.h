@@ -27,23 +27,116 @@
 #define TESTPROJECT_MODEL_WRAPPER_H
 
 #include "onnxruntime/onnxruntime_cxx_api.h"
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <future>
+#include <map>
 
 
 namespace OnnxBenchmarks {
     class BenchMark;
 
+    struct SessionConfig {
+        /// 0 means hardware concurrency
+        int intraOpThreads = 0;
+        /// 0 means hardware concurrency
+        int interOpThreads = 0;
+        /// Run on the global thread pools of the shared Env instead of per-session threads
+        bool useGlobalThreadPools = false;
+        GraphOptimizationLevel optimizationLevel = ORT_ENABLE_ALL;
+        /// ORT_PARALLEL runs independent branches of the graph on the inter-op threads
+        ExecutionMode executionMode = ORT_SEQUENTIAL;
+        /// -1 keeps ORT's default (spinning), 0/1 sets whether idle intra-op and inter-op threads spin
+        int allowSpinning = -1;
+        bool denormalAsZero = false;
+        /// An execution provider registered before the CPU one: "xnnpack", "dnnl" or "openvino";
+        /// empty (or "cpu") for the CPU provider only
+        std::string executionProvider;
+        std::map<std::string, std::string> providerOptions;
+        /// Save the optimized graph here while loading (.ort extension: ORT format), empty to skip
+        std::string optimizedModelPath;
+        /// Write an ORT profile (trace JSON) with this file prefix, empty to disable profiling
+        std::string profilePrefix;
+        bool memArena = true;
+        bool memPattern = true;
+        /// -1 keeps the session's own CPU arena; 0 (kNextPowerOfTwo) or 1 (kSameAsRequested) registers an
+        /// arena with that extend strategy on the Env for the lifetime of the model, so only one such
+        /// model may exist per Env at a time
+        int arenaExtendStrategy = -1;
+        /// ORT intra-op thread affinities (see IntraOpAffinityString); empty places the threads by
+        /// GetThreadPlacement() from slot 1, next to a caller in slot 0
+        std::string intraOpThreadAffinities;
+        /// Leave the intra-op threads unpinned whatever the placement, e.g. for an unpinned baseline
+        bool unpinnedThreads = false;
+    };
+
+    /// The execution provider (as named in SessionConfig) is built into the linked ORT
+    bool ExecutionProviderAvailable(const std::string &provider);
+
+    /// Values for dynamic non-batch dimensions
+    struct DynamicDims {
+        /// Full shapes by input name, e.g. input_ids -> {1, 128}. The batch dimension of batch-capable
+        /// models is ignored, the benchmarks choose the batch size.
+        std::map<std::string, std::vector<int64_t>> shapes;
+        /// Symbolic dimension values by name, e.g. sequence_length -> 128, applied to inputs and outputs
+        std::map<std::string, int64_t> symbols;
+    };
+
+    class OnnxModel;
+
+    /// Input and output tensors bound once to fixed buffers and a fixed batch size through an IoBinding.
+    /// Run() reuses them, so repeated calls do no allocation on our side; only ORT's own execution remains.
+    class PreparedRun {
+        Ort::Session *session;
+        std::vector<Ort::Value> inValues;
+        std::vector<Ort::Value> outValues;
+        Ort::IoBinding binding;
+        Ort::RunOptions runOptions{nullptr};
+
+        friend class OnnxModel;
+
+        PreparedRun(OnnxModel &model, void *inBuffer, void *outBuffer, int64_t batch);
+
+    public:
+        PreparedRun(PreparedRun &&) = default;
+
+        PreparedRun &operator=(PreparedRun &&) = default;
+
+        void Run();
+    };
+
     class OnnxModel {
-        Ort::Env env;
+        std::shared_ptr<Ort::Env> env;
+        SessionConfig sessionConfig;
+        /// The file given to Load
+        std::string loadedPath;
         Ort::SessionOptions session_options;
         std::unique_ptr<Ort::Session> session;
+        bool envAllocatorRegistered = false;
         size_t inputLen = 0;
         size_t outputLen = 0;
+        std::vector<std::vector<int64_t>> inputModelDims;
+        std::vector<std::vector<int64_t>> outputModelDims;
+        std::vector<std::vector<std::string>> inputSymbols;
+        std::vector<std::vector<std::string>> outputSymbols;
+        /// Model dims with the dynamic non-batch dimensions resolved
         std::vector<std::vector<int64_t>> inputDims;
         std::vector<std::vector<int64_t>> outputDims;
+        /// Outputs whose shape is unknown before running, ORT allocates them and they take no buffer space
+        std::vector<bool> outputDynamic;
+        DynamicDims dynamicDims;
         std::vector<std::string> inputNames;
         std::vector<std::string> outputNames;
+        std::vector<ONNXTensorElementDataType> inputTypes;
+        std::vector<ONNXTensorElementDataType> outputTypes;
         std::vector<size_t> inBufferLenEachDim;
         std::vector<size_t> outBufferLenEachDim;
+        std::vector<size_t> inBufferBytesEachDim;
+        std::vector<size_t> outBufferBytesEachDim;
+        /// The bytes above rounded up to TensorAlignment
+        std::vector<size_t> inBufferStrideEachDim;
+        std::vector<size_t> outBufferStrideEachDim;
 
         BenchMark *benchMark = nullptr;
 
@@ -55,14 +148,55 @@ namespace OnnxBenchmarks {
     public:
         OnnxModel();
 
+        /// Sessions given the same `sharedEnv` share its global thread pools when configured to.
+        explicit OnnxModel(const SessionConfig &config, std::shared_ptr<Ort::Env> sharedEnv = nullptr);
+
         ~OnnxModel();
 
+        /// An Env owning global intra-op/inter-op thread pools, for models using `useGlobalThreadPools`
+        static std::shared_ptr<Ort::Env> CreateEnvWithGlobalThreadPools(int intraOpThreads, int interOpThreads);
+
         void Initialize(size_t argc, char **argv);
 
+        void Load(const char *modelPath);
+
+        /// Resolve dynamic non-batch dimensions and recompute the buffer sizes. Can be called again with
+        /// other values (e.g. for a sweep); before Load, the values are kept and applied by Load.
+        /// Input dimensions left unset are taken as 1 with a warning.
+        void SetDynamicDims(const DynamicDims &dims);
+
+        [[nodiscard]] const DynamicDims &GetDynamicDims() const {
+            return dynamicDims;
+        }
+
+        [[nodiscard]] const auto &GetInputSymbols() const {
+            return inputSymbols;
+        }
+
+        [[nodiscard]] const auto &GetOutputSymbols() const {
+            return outputSymbols;
+        }
+
         void RegisterBenchmark(BenchMark *inBenchMark) {
             benchMark = inBenchMark;
         }
 
+        /// The config the session was created with, to create another session like it; without the
+        /// optimizedModelPath, so a copy does not write the model cache again
+        [[nodiscard]] const SessionConfig &GetConfig() const {
+            return sessionConfig;
+        }
+
+        /// The model file of the session, which may be a cached optimized copy of the one on the command line
+        [[nodiscard]] const std::string &GetModelPath() const {
+            return loadedPath;
+        }
+
+        /// The Env of the session, to create more sessions sharing its global thread pools
+        [[nodiscard]] const std::shared_ptr<Ort::Env> &GetEnv() const {
+            return env;
+        }
+
         Ort::Session &GetSession() {
             return *session;
         }
@@ -87,28 +221,118 @@ namespace OnnxBenchmarks {
             return outputNames;
         }
 
+        [[nodiscard]] const auto &GetInputTypes() const {
+            return inputTypes;
+        }
+
+        [[nodiscard]] const auto &GetOutputTypes() const {
+            return outputTypes;
+        }
+
+        /// Dims as declared by the model, -1 (or 0) for dynamic ones
+        [[nodiscard]] const auto &GetInputModelDims() const {
+            return inputModelDims;
+        }
+
+        [[nodiscard]] const auto &GetOutputModelDims() const {
+            return outputModelDims;
+        }
+
+        [[nodiscard]] const auto &GetInputDims() const {
+            return inputDims;
+        }
+
+        [[nodiscard]] const auto &GetOutputDims() const {
+            return outputDims;
+        }
+
+        /// Bytes of all inputs for one batch item, padding included: a buffer of `batch` items takes `batch`
+        /// times this
         [[nodiscard]] size_t GetInputBufferSize() const;
 
+        /// Bytes of all outputs for one batch item, padding included
         [[nodiscard]] size_t GetOutputBufferSize() const;
 
+        /// Bytes of all inputs for one batch item without padding, e.g. one dataset sample
+        [[nodiscard]] size_t GetInputDataSize() const;
+
+        /// Bytes of each input for one batch item
+        [[nodiscard]] const auto &GetInputBufferSizes() const {
+            return inBufferBytesEachDim;
+        }
+
+        /// Bytes of each output for one batch item
+        [[nodiscard]] const auto &GetOutputBufferSizes() const {
+            return outBufferBytesEachDim;
+        }
+
+        /// Space of each input per batch item in a buffer, its size rounded up to TensorAlignment. A buffer of
+        /// `batch` items holds each input batched (`batch` times its size), one input after another, input i
+        /// starting at `batch` times the strides before it, so every input is aligned.
+        [[nodiscard]] const auto &GetInputBufferStrides() const {
+            return inBufferStrideEachDim;
+        }
+
+        /// Space of each output per batch item, laid out like the inputs
+        [[nodiscard]] const auto &GetOutputBufferStrides() const {
+            return outBufferStrideEachDim;
+        }
+
+        /// Elements of each input for one batch item
+        [[nodiscard]] const auto &GetInputElementCounts() const {
+            return inBufferLenEachDim;
+        }
+
+        /// Elements of each output for one batch item
+        [[nodiscard]] const auto &GetOutputElementCounts() const {
+            return outBufferLenEachDim;
+        }
+
         [[nodiscard]] bool IsBatchSupported() const { return batchSupported; }
 
-        void Run(float *inBuffer, float *outBuffer, int64_t batch);
+        /// Some output has a shape unknown before running, so it takes no space in the output buffer
+        [[nodiscard]] bool HasDynamicOutputs() const {
+            return std::find(outputDynamic.begin(), outputDynamic.end(), true) != outputDynamic.end();
+        }
+
+        void Run(void *inBuffer, void *outBuffer, int64_t batch);
+
+        /// Completion of an asynchronous run, with the error if it failed. It is called on an ORT intra-op
+        /// thread, so it should hand over rather than do work.
+        using RunCallback = std::function<void(std::exception_ptr)>;
+
+        /// Start a run on ORT's intra-op thread pool (Session::RunAsync) and return at once; the buffers must
+        /// stay valid until `callback`. Needs a session with an intra-op pool of more than one thread.
+        void RunAsync(void *inBuffer, void *outBuffer, int64_t batch, RunCallback callback);
+
+        /// RunAsync completing a future
+        std::future<void> RunAsync(void *inBuffer, void *outBuffer, int64_t batch);
 
-        void RunWithOutIndex(size_t index, float *inBuffer, float *outBuffer, int64_t batch);
+        void RunWithOutIndex(size_t index, void *inBuffer, void *outBuffer, int64_t batch);
 
-        void RunWithOutIndexes(std::vector<size_t> indexes, float *inBuffer, float *outBuffer, int64_t batch);
+        void RunWithOutIndexes(std::vector<size_t> indexes, void *inBuffer, void *outBuffer, int64_t batch);
+
+        /// Stop profiling (see SessionConfig::profilePrefix) and return the path of the written profile
+        std::string EndProfiling();
+
+        /// Bind the buffers and batch size once for repeated runs, the buffers must outlive the result.
+        PreparedRun Prepare(void *inBuffer, void *outBuffer, int64_t batch);
 
     private:
+        friend class PreparedRun;
+
         void _gen_name_pointer();
 
         const char **_get_outnames_by_indexes(const std::vector<size_t> &indexes);
 
-        Ort::Value *_create_in_values(float *inBuffer, size_t batchNum) const;
+        Ort::Value *_create_in_values(void *inBuffer, size_t batchNum) const;
+
+        Ort::Value *_create_out_values(void *outBuffer, size_t batchNum) const;
 
-        Ort::Value *_create_out_values(float *outBuffer, size_t batchNum) const;
+        Ort::Value _create_out_value_index(size_t index, void *outBuffer, size_t batchNum) const;
 
-        Ort::Value _create_out_value_index(size_t index, float *outBuffer, size_t batchNum) const;
+        /// Destroy and free values from _create_in_values/_create_out_values
+        static void _free_values(Ort::Value *values, size_t count);
     };
 }
 #endif //TESTPROJECT_MODEL_WRAPPER_H
@@ -0,0 +1,270 @@
+//
+// Created by antares on 5/8/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "onnx_prune.h"
+#include "dataset.h"
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include <string_view>
+
+namespace OnnxBenchmarks {
+    namespace {
+        // field numbers of onnx.proto
+        constexpr uint32_t ModelGraph = 7;
+        constexpr uint32_t GraphNode = 1;
+        constexpr uint32_t GraphOutput = 12;
+        constexpr uint32_t NodeInput = 1;
+        constexpr uint32_t NodeOutput = 2;
+        constexpr uint32_t NodeAttribute = 5;
+        constexpr uint32_t AttributeGraph = 6;
+        constexpr uint32_t AttributeGraphs = 11;
+        constexpr uint32_t ValueInfoNameField = 1;
+
+        constexpr uint32_t WireVarint = 0;
+        constexpr uint32_t WireFixed64 = 1;
+        constexpr uint32_t WireLengthDelimited = 2;
+        constexpr uint32_t WireFixed32 = 5;
+
+        /// One field of a protobuf message: `whole` spans the key as well, the payload is the content of
+        /// a length-delimited field
+        struct Field {
+            uint32_t number = 0;
+            uint32_t wireType = 0;
+            std::string_view whole;
+            std::string_view payload;
+        };
+
+        class FieldReader {
+            std::string_view data;
+            size_t offset = 0;
+
+            uint64_t _varint() {
+                uint64_t value = 0;
+                for (unsigned shift = 0; shift < 64; shift += 7) {
+                    if (offset >= data.size()) {
+                        throw std::runtime_error("Truncated protobuf varint");
+                    }
+                    auto byte = static_cast<uint8_t>(data[offset++]);
+                    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                    if ((byte & 0x80) == 0) {
+                        return value;
+                    }
+                }
+                throw std::runtime_error("Malformed protobuf varint");
+            }
+
+            void _skip(uint64_t bytes) {
+                if (bytes > data.size() - offset) {
+                    throw std::runtime_error("Truncated protobuf field");
+                }
+                offset += bytes;
+            }
+
+        public:
+            explicit FieldReader(std::string_view inData) : data(inData) {}
+
+            [[nodiscard]] bool Done() const { return offset >= data.size(); }
+
+            Field Next() {
+                Field field;
+                auto begin = offset;
+                auto key = _varint();
+                field.number = static_cast<uint32_t>(key >> 3);
+                field.wireType = static_cast<uint32_t>(key & 7);
+                switch (field.wireType) {
+                    case WireVarint:
+                        _varint();
+                        break;
+                    case WireFixed64:
+                        _skip(8);
+                        break;
+                    case WireLengthDelimited: {
+                        auto length = _varint();
+                        auto payloadBegin = offset;
+                        _skip(length);
+                        field.payload = data.substr(payloadBegin, length);
+                        break;
+                    }
+                    case WireFixed32:
+                        _skip(4);
+                        break;
+                    default:
+                        throw std::runtime_error("Unsupported protobuf wire type " + std::to_string(field.wireType));
+                }
+                field.whole = data.substr(begin, offset - begin);
+                return field;
+            }
+        };
+
+        void WriteVarint(std::string &out, uint64_t value) {
+            while (value >= 0x80) {
+                out += static_cast<char>((value & 0x7f) | 0x80);
+                value >>= 7;
+            }
+            out += static_cast<char>(value);
+        }
+
+        struct Node {
+            std::vector<std::string> inputs;
+            std::vector<std::string> outputs;
+            bool hasSubgraph = false;
+        };
+
+        Node ParseNode(std::string_view payload) {
+            Node node;
+            FieldReader reader(payload);
+            while (!reader.Done()) {
+                auto field = reader.Next();
+                if (field.wireType != WireLengthDelimited) {
+                    continue;
+                }
+                if (field.number == NodeInput) {
+                    node.inputs.emplace_back(field.payload);
+                } else if (field.number == NodeOutput) {
+                    node.outputs.emplace_back(field.payload);
+                } else if (field.number == NodeAttribute) {
+                    FieldReader attribute(field.payload);
+                    while (!attribute.Done()) {
+                        auto member = attribute.Next();
+                        if (member.number == AttributeGraph || member.number == AttributeGraphs) {
+                            node.hasSubgraph = true;
+                        }
+                    }
+                }
+            }
+            return node;
+        }
+
+        std::string ValueInfoName(std::string_view payload) {
+            FieldReader reader(payload);
+            while (!reader.Done()) {
+                auto field = reader.Next();
+                if (field.number == ValueInfoNameField && field.wireType == WireLengthDelimited) {
+                    return std::string(field.payload);
+                }
+            }
+            return {};
+        }
+
+        std::string PruneGraph(std::string_view graph, const std::set<std::string> &keep, PruneResult &result) {
+            std::vector<Node> nodes;
+            std::set<std::string> outputs;
+            bool hasSubgraph = false;
+            FieldReader reader(graph);
+            while (!reader.Done()) {
+                auto field = reader.Next();
+                if (field.number == GraphNode && field.wireType == WireLengthDelimited) {
+                    auto &node = nodes.emplace_back(ParseNode(field.payload));
+                    hasSubgraph = hasSubgraph || node.hasSubgraph;
+                } else if (field.number == GraphOutput && field.wireType == WireLengthDelimited) {
+                    outputs.emplace(ValueInfoName(field.payload));
+                }
+            }
+            for (const auto &name: keep) {
+                if (outputs.count(name) == 0) {
+                    throw std::invalid_argument("The model has no output " + name);
+                }
+            }
+
+            // nodes are topologically sorted, so walking them backwards sees every consumer before its producers
+            std::vector<bool> keepNode(nodes.size(), true);
+            if (!hasSubgraph) {
+                std::set<std::string> needed(keep.begin(), keep.end());
+                for (size_t i = nodes.size(); i-- > 0;) {
+                    const auto &node = nodes[i];
+                    keepNode[i] = false;
+                    for (const auto &output: node.outputs) {
+                        keepNode[i] = keepNode[i] || needed.count(output) > 0;
+                    }
+                    if (keepNode[i]) {
+                        needed.insert(node.inputs.begin(), node.inputs.end());
+                    }
+                }
+            }
+            result.nodesPruned = !hasSubgraph;
+            for (auto kept: keepNode) {
+                ++(kept ? result.keptNodes : result.removedNodes);
+            }
+
+            std::string pruned;
+            pruned.reserve(graph.size());
+            size_t nodeIndex = 0;
+            FieldReader writer(graph);
+            while (!writer.Done()) {
+                auto field = writer.Next();
+                if (field.number == GraphNode && field.wireType == WireLengthDelimited) {
+                    if (!keepNode[nodeIndex++]) {
+                        continue;
+                    }
+                } else if (field.number == GraphOutput && field.wireType == WireLengthDelimited) {
+                    if (keep.count(ValueInfoName(field.payload)) == 0) {
+                        continue;
+                    }
+                }
+                pruned += field.whole;
+            }
+            return pruned;
+        }
+    }
+
+    PruneResult PruneOnnxModel(const std::string &inPath, const std::vector<std::string> &keepOutputs,
+                               const std::string &outPath) {
+        if (keepOutputs.empty()) {
+            throw std::invalid_argument("Keep at least one output of " + inPath);
+        }
+        MappedFile file(inPath);
+        std::string_view model(reinterpret_cast<const char *>(file.Data()), file.Size());
+        std::set<std::string> keep(keepOutputs.begin(), keepOutputs.end());
+
+        PruneResult result;
+        bool foundGraph = false;
+        std::string pruned;
+        pruned.reserve(model.size());
+        FieldReader reader(model);
+        while (!reader.Done()) {
+            auto field = reader.Next();
+            if (field.number == ModelGraph && field.wireType == WireLengthDelimited) {
+                auto graph = PruneGraph(field.payload, keep, result);
+                WriteVarint(pruned, (ModelGraph << 3) | WireLengthDelimited);
+                WriteVarint(pruned, graph.size());
+                pruned += graph;
+                foundGraph = true;
+            } else {
+                pruned += field.whole;
+            }
+        }
+        if (!foundGraph) {
+            throw std::runtime_error(inPath + " has no graph, is it an ONNX model?");
+        }
+
+        std::ofstream out(outPath, std::ios::binary | std::ios::trunc);
+        out.write(pruned.data(), static_cast<std::streamsize>(pruned.size()));
+        if (!out.flush()) {
+            throw std::runtime_error("Can not write " + outPath);
+        }
+        return result;
+    }
+}
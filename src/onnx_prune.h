@@ -0,0 +1,51 @@
+//
+// Created by antares on 5/8/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_ONNX_PRUNE_H
+#define TESTPROJECT_ONNX_PRUNE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace OnnxBenchmarks {
+    struct PruneResult {
+        size_t keptNodes = 0;
+        size_t removedNodes = 0;
+        /// False when the graph has subgraphs (If/Loop/Scan), whose implicit inputs we can not see; then
+        /// only the graph outputs are dropped and ORT is left to skip the dead nodes
+        bool nodesPruned = false;
+    };
+
+    /// Write a copy of the ONNX model at `inPath` to `outPath` that only has the outputs `keepOutputs`
+    /// and the nodes they depend on. The protobuf is edited on the wire, every other field is copied
+    /// unchanged (unused initializers are dropped by ORT when loading). External data files are not copied,
+    /// their relative paths must resolve from `outPath`'s directory as well.
+    /// Throws std::invalid_argument for unknown outputs and std::runtime_error for malformed models.
+    PruneResult PruneOnnxModel(const std::string &inPath, const std::vector<std::string> &keepOutputs,
+                               const std::string &outPath);
+}
+
+#endif //TESTPROJECT_ONNX_PRUNE_H
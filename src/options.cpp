@@ -0,0 +1,571 @@
+//
+// Created by antares on 4/5/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "options.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace OnnxBenchmarks {
+    namespace {
+        std::vector<std::string> SplitString(const std::string &str, char delimiter) {
+            std::vector<std::string> answer;
+            size_t begin = 0;
+            while (begin <= str.size()) {
+                auto end = str.find(delimiter, begin);
+                if (end == std::string::npos) {
+                    end = str.size();
+                }
+                if (end > begin) {
+                    answer.emplace_back(str.substr(begin, end - begin));
+                }
+                begin = end + 1;
+            }
+            return answer;
+        }
+
+        double ParseDouble(const std::string &key, const std::string &value) {
+            size_t pos = 0;
+            double answer;
+            try {
+                answer = std::stod(value, &pos);
+            } catch (const std::exception &) {
+                pos = 0;
+            }
+            if (pos == 0 || pos != value.size()) {
+                throw std::invalid_argument("Invalid number for --" + key + ": " + value);
+            }
+            return answer;
+        }
+
+        size_t ParseSize(const std::string &key, const std::string &value) {
+            auto answer = ParseDouble(key, value);
+            if (answer < 0 || static_cast<double>(static_cast<size_t>(answer)) != answer) {
+                throw std::invalid_argument("Expect a non-negative integer for --" + key + ": " + value);
+            }
+            return static_cast<size_t>(answer);
+        }
+
+        /// "1x128" -> {1, 128}
+        std::vector<int64_t> ParseShape(const std::string &key, const std::string &value) {
+            std::vector<int64_t> answer;
+            for (const auto &item: SplitString(value, 'x')) {
+                answer.emplace_back(static_cast<int64_t>(ParseSize(key, item)));
+            }
+            if (answer.empty()) {
+                throw std::invalid_argument("Empty shape for --" + key);
+            }
+            return answer;
+        }
+
+        /// "name:value" -> {name, value}, the name may itself contain ':'
+        std::pair<std::string, std::string> SplitNamed(const std::string &key, const std::string &value) {
+            auto colon = value.rfind(':');
+            if (colon == std::string::npos || colon == 0) {
+                throw std::invalid_argument("Expect NAME:VALUE for --" + key + ": " + value);
+            }
+            return {value.substr(0, colon), value.substr(colon + 1)};
+        }
+
+        std::vector<size_t> ParseSizeList(const std::string &key, const std::string &value) {
+            std::vector<size_t> answer;
+            for (const auto &item: SplitString(value, ',')) {
+                answer.emplace_back(ParseSize(key, item));
+            }
+            if (answer.empty()) {
+                throw std::invalid_argument("Empty list for --" + key);
+            }
+            return answer;
+        }
+    }
+
+    BenchmarkOptions ParseOptions(int argc, char **argv) {
+        if (argc <= 1) {
+            throw std::length_error("Not enough arguments");
+        }
+
+        BenchmarkOptions options;
+        options.modelPath = argv[1];
+
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.rfind("--", 0) != 0) {
+                throw std::invalid_argument("Unexpected argument: " + arg);
+            }
+            auto eq = arg.find('=');
+            auto key = arg.substr(2, eq == std::string::npos ? std::string::npos : eq - 2);
+            auto value = eq == std::string::npos ? std::string() : arg.substr(eq + 1);
+
+            if (key == "scenario") {
+                options.scenarios = SplitString(value, ',');
+            } else if (key == "int-range") {
+                options.intRange = ParseSize(key, value);
+            } else if (key == "warmup-cv") {
+                options.warmupCv = ParseDouble(key, value);
+            } else if (key == "warmup-max-seconds") {
+                options.warmupMaxSeconds = ParseDouble(key, value);
+            } else if (key == "precision") {
+                options.precision = ParseDouble(key, value);
+            } else if (key == "measure-max-seconds") {
+                options.measureMaxSeconds = ParseDouble(key, value);
+            } else if (key == "dataset") {
+                options.datasetPath = value;
+            } else if (key == "prefetch-depth") {
+                options.prefetchDepth = ParseSize(key, value);
+            } else if (key == "model-cache") {
+                options.modelCacheDir = value;
+            } else if (key == "cache-format") {
+                if (value == "ort") {
+                    options.cacheFormat = CacheFormat::Ort;
+                } else if (value == "onnx") {
+                    options.cacheFormat = CacheFormat::Onnx;
+                } else {
+                    throw std::invalid_argument("Unknown cache format: " + value);
+                }
+            } else if (key == "startup-repeats") {
+                options.startupRepeats = ParseSize(key, value);
+            } else if (key == "first-calls") {
+                options.firstCalls = ParseSize(key, value);
+            } else if (key == "profile-calls") {
+                options.profileCalls = ParseSize(key, value);
+            } else if (key == "profile-batches") {
+                options.profileBatches = ParseSizeList(key, value);
+            } else if (key == "profile-top") {
+                options.profileTopNodes = ParseSize(key, value);
+            } else if (key == "memory-variants") {
+                options.memoryVariants = SplitString(value, ',');
+            } else if (key == "memory-batches") {
+                options.memoryBatches = ParseSizeList(key, value);
+            } else if (key == "pin") {
+                if (value == "none") {
+                    options.placement = PlacementPolicy::None;
+                } else if (value == "compact") {
+                    options.placement = PlacementPolicy::Compact;
+                } else if (value == "scatter") {
+                    options.placement = PlacementPolicy::Scatter;
+                } else if (value == "numa") {
+                    options.placement = PlacementPolicy::Numa;
+                } else {
+                    throw std::invalid_argument("Unknown placement policy: " + value);
+                }
+            } else if (key == "numa-callers") {
+                options.numaCallers = ParseSize(key, value);
+            } else if (key == "mix") {
+                options.mixModels.clear();
+                for (const auto &item: SplitString(value, ',')) {
+                    auto [path, weight] = SplitNamed(key, item);
+                    auto share = ParseDouble(key, weight);
+                    if (share <= 0) {
+                        throw std::invalid_argument("Expect a positive weight for --" + key + ": " + item);
+                    }
+                    options.mixModels.emplace_back(path, share);
+                }
+            } else if (key == "mix-callers") {
+                options.mixCallers = ParseSize(key, value);
+            } else if (key == "mix-intra-threads") {
+                options.mixIntraThreads = ParseSize(key, value);
+            } else if (key == "mix-pools") {
+                options.mixPerSessionThreadPools = false;
+                options.mixGlobalThreadPools = false;
+                for (const auto &item: SplitString(value, ',')) {
+                    if (item == "session") {
+                        options.mixPerSessionThreadPools = true;
+                    } else if (item == "global") {
+                        options.mixGlobalThreadPools = true;
+                    } else {
+                        throw std::invalid_argument("Unknown thread pool kind: " + item);
+                    }
+                }
+            } else if (key == "mix-seconds") {
+                options.mixSeconds = ParseDouble(key, value);
+            } else if (key == "matrix") {
+                options.configMatrix = value;
+            } else if (key == "matrix-batches") {
+                options.matrixBatches = ParseSizeList(key, value);
+            } else if (key == "async-in-flight") {
+                options.asyncInFlight = ParseSizeList(key, value);
+            } else if (key == "async-executor-threads") {
+                options.asyncExecutorThreads = ParseSize(key, value);
+            } else if (key == "output-subsets") {
+                options.outputSubsets.clear();
+                for (const auto &item: SplitString(value, ',')) {
+                    options.outputSubsets.emplace_back(SplitString(item, '+'));
+                }
+            } else if (key == "export-pruned") {
+                options.exportPrunedDir = value;
+            } else if (key == "ipc-socket") {
+                options.ipcSocket = value;
+            } else if (key == "serve-seconds") {
+                options.serveSeconds = ParseDouble(key, value);
+            } else if (key == "client-threads") {
+                options.clientThreads = ParseSizeList(key, value);
+            } else if (key == "client-depth") {
+                options.clientDepth = ParseSize(key, value);
+            } else if (key == "client-batch") {
+                options.clientBatch = ParseSize(key, value);
+            } else if (key == "client-seconds") {
+                options.clientSeconds = ParseDouble(key, value);
+            } else if (key == "image-size") {
+                auto shape = ParseShape(key, value);
+                if (shape.size() != 2) {
+                    throw std::invalid_argument("Expect HxW for --image-size: " + value);
+                }
+                options.imageHeight = static_cast<size_t>(shape[0]);
+                options.imageWidth = static_cast<size_t>(shape[1]);
+            } else if (key == "simd") {
+                options.simdLevel = value;
+            } else if (key == "preprocess-batches") {
+                options.preprocessBatches = ParseSizeList(key, value);
+            } else if (key == "slo") {
+                auto [name, milliseconds] = SplitNamed(key, value);
+                if (name.size() < 2 || name[0] != 'p') {
+                    throw std::invalid_argument("Expect pPERCENTILE:MS for --slo: " + value);
+                }
+                options.sloPercentile = ParseDouble(key, name.substr(1));
+                options.sloMilliseconds = ParseDouble(key, milliseconds);
+            } else if (key == "slo-max-batch") {
+                options.sloMaxBatch = ParseSize(key, value);
+            } else if (key == "slo-max-concurrency") {
+                options.sloMaxConcurrency = ParseSize(key, value);
+            } else if (key == "slo-seconds") {
+                options.sloSeconds = ParseDouble(key, value);
+            } else if (key == "scaling-threads") {
+                options.scalingThreads = ParseSizeList(key, value);
+            } else if (key == "scaling-batch") {
+                options.scalingBatch = ParseSize(key, value);
+            } else if (key == "scaling-intra-threads") {
+                options.scalingIntraThreads = ParseSize(key, value);
+            } else if (key == "scaling-seconds") {
+                options.scalingSeconds = ParseDouble(key, value);
+            } else if (key == "scaling-knee") {
+                options.scalingKnee = ParseDouble(key, value);
+            } else if (key == "cache-states") {
+                options.cacheStates = SplitString(value, ',');
+            } else if (key == "cache-batches") {
+                options.cacheBatches = ParseSizeList(key, value);
+            } else if (key == "state-map") {
+                options.stateMap = SplitString(value, ',');
+            } else if (key == "token-input") {
+                options.tokenInput = value;
+            } else if (key == "decode-prompts") {
+                options.decodePrompts = ParseSizeList(key, value);
+            } else if (key == "decode-tokens") {
+                options.decodeTokens = ParseSize(key, value);
+            } else if (key == "decode-sequences") {
+                options.decodeSequences = ParseSizeList(key, value);
+            } else if (key == "decode-seconds") {
+                options.decodeSeconds = ParseDouble(key, value);
+            } else if (key == "perf-counters") {
+                options.perfCounterScenarios = value.empty() ? std::vector<std::string>{"all"}
+                                                             : SplitString(value, ',');
+            } else if (key == "json") {
+                options.jsonPath = value;
+            } else if (key == "csv") {
+                options.csvPath = value;
+            } else if (key == "compare") {
+                options.comparePath = value;
+            } else if (key == "regression-threshold") {
+                options.regressionThreshold = ParseDouble(key, value);
+            } else if (key == "alpha") {
+                options.significance = ParseDouble(key, value);
+            } else if (key == "shape") {
+                for (const auto &item: SplitString(value, ',')) {
+                    auto [name, shape] = SplitNamed(key, item);
+                    options.shapes[name] = ParseShape(key, shape);
+                }
+            } else if (key == "dim") {
+                for (const auto &item: SplitString(value, ',')) {
+                    auto [name, dim] = SplitNamed(key, item);
+                    options.dims[name] = static_cast<int64_t>(ParseSize(key, dim));
+                }
+            } else if (key == "sweep-dim") {
+                // NAME:MIN:MAX, doubling from MIN to MAX
+                auto [head, maxValue] = SplitNamed(key, value);
+                auto [name, minValue] = SplitNamed(key, head);
+                auto from = ParseSize(key, minValue);
+                auto to = ParseSize(key, maxValue);
+                if (from == 0 || from > to) {
+                    throw std::invalid_argument("Invalid range for --" + key + ": " + value);
+                }
+                options.sweepDim = name;
+                options.sweepDimValues.clear();
+                for (auto v = from; v <= to; v *= 2) {
+                    options.sweepDimValues.emplace_back(static_cast<int64_t>(v));
+                }
+            } else if (key == "sweep-values") {
+                options.sweepDimValues.clear();
+                for (auto v: ParseSizeList(key, value)) {
+                    options.sweepDimValues.emplace_back(static_cast<int64_t>(v));
+                }
+            } else if (key == "arrival") {
+                if (value == "poisson") {
+                    options.arrival = ArrivalProcess::Poisson;
+                } else if (value == "constant") {
+                    options.arrival = ArrivalProcess::Constant;
+                } else {
+                    throw std::invalid_argument("Unknown arrival process: " + value);
+                }
+            } else if (key == "rate") {
+                options.rate = ParseDouble(key, value);
+            } else if (key == "open-loop-seconds") {
+                options.openLoopSeconds = ParseDouble(key, value);
+            } else if (key == "open-loop-batch") {
+                options.openLoopBatch = ParseSize(key, value);
+            } else if (key == "max-batch") {
+                options.maxBatch = ParseSize(key, value);
+            } else if (key == "max-wait-us") {
+                options.maxWaitMicroseconds = ParseSize(key, value);
+            } else if (key == "batcher-workers") {
+                options.batcherWorkers = ParseSize(key, value);
+            } else if (key == "producers") {
+                options.producers = ParseSize(key, value);
+            } else if (key == "requests-per-producer") {
+                options.requestsPerProducer = ParseSize(key, value);
+            } else if (key == "sessions") {
+                options.sessionCounts = ParseSizeList(key, value);
+            } else if (key == "intra-threads") {
+                options.intraOpThreads = ParseSizeList(key, value);
+            } else if (key == "callers") {
+                options.callerCounts = ParseSizeList(key, value);
+            } else if (key == "thread-pools") {
+                options.sweepPerSessionThreadPools = false;
+                options.sweepGlobalThreadPools = false;
+                for (const auto &item: SplitString(value, ',')) {
+                    if (item == "session") {
+                        options.sweepPerSessionThreadPools = true;
+                    } else if (item == "global") {
+                        options.sweepGlobalThreadPools = true;
+                    } else {
+                        throw std::invalid_argument("Unknown thread pool kind: " + item);
+                    }
+                }
+            } else if (key == "sweep-seconds") {
+                options.sweepSeconds = ParseDouble(key, value);
+            } else if (key == "sweep-batch") {
+                options.sweepBatch = ParseSize(key, value);
+            } else {
+                throw std::invalid_argument("Unknown option: " + arg);
+            }
+        }
+
+        if (options.scenarios.empty()) {
+            throw std::invalid_argument("No scenario to run");
+        }
+        if (options.intRange == 0) {
+            throw std::invalid_argument("Integer input range must be positive");
+        }
+        if (options.warmupCv <= 0 || options.warmupMaxSeconds < 0 || options.precision <= 0 ||
+            options.measureMaxSeconds <= 0) {
+            throw std::invalid_argument("Warm-up and precision targets must be positive");
+        }
+        if (options.prefetchDepth == 0) {
+            throw std::invalid_argument("Prefetch depth must be positive");
+        }
+        if (options.profileCalls == 0) {
+            throw std::invalid_argument("Profiled calls must be positive");
+        }
+        if (options.startupRepeats == 0) {
+            throw std::invalid_argument("Startup repeats must be positive");
+        }
+        if (options.regressionThreshold < 0 || options.significance <= 0 || options.significance >= 1) {
+            throw std::invalid_argument("Regression threshold must be non-negative and alpha in (0, 1)");
+        }
+        if (options.rate < 0 || options.openLoopSeconds <= 0 || options.openLoopBatch == 0) {
+            throw std::invalid_argument("Open-loop rate, duration and batch must be positive");
+        }
+        if (options.maxBatch == 0 || options.batcherWorkers == 0 || options.requestsPerProducer == 0) {
+            throw std::invalid_argument("Batcher max batch, workers and requests must be positive");
+        }
+        if (options.sweepSeconds <= 0 || options.sweepBatch == 0) {
+            throw std::invalid_argument("Sweep duration and batch must be positive");
+        }
+        if (options.sloPercentile <= 0 || options.sloPercentile > 100 || options.sloMilliseconds <= 0 ||
+            options.sloMaxBatch == 0 || options.sloSeconds <= 0) {
+            throw std::invalid_argument("SLO percentile must be in (0, 100], latency, batch and duration positive");
+        }
+        if (options.scalingBatch == 0 || options.scalingIntraThreads == 0 || options.scalingSeconds <= 0 ||
+            options.scalingKnee < 0) {
+            throw std::invalid_argument("Scaling batch, intra-op threads and duration must be positive");
+        }
+        if (options.mixSeconds <= 0 || (!options.mixPerSessionThreadPools && !options.mixGlobalThreadPools)) {
+            throw std::invalid_argument("Mix duration must be positive and --mix-pools name at least one kind");
+        }
+        if (options.stateMap.empty() || options.tokenInput.empty() || options.decodeTokens < 2 ||
+            options.decodeSeconds <= 0) {
+            throw std::invalid_argument("Decoding needs a state mapping, a token input, at least 2 tokens and a "
+                                        "positive duration");
+        }
+        for (const auto &name: options.perfCounterScenarios) {
+            if (name != "all" &&
+                std::find(options.scenarios.begin(), options.scenarios.end(), name) == options.scenarios.end()) {
+                throw std::invalid_argument("--perf-counters names a scenario that does not run: " + name);
+            }
+        }
+        if (options.imageHeight == 0 || options.imageWidth == 0) {
+            throw std::invalid_argument("Image size must be positive");
+        }
+        if (options.clientDepth == 0 || options.clientBatch == 0 || options.clientSeconds <= 0 ||
+            options.serveSeconds < 0) {
+            throw std::invalid_argument("Client depth, batch and duration must be positive");
+        }
+        for (const auto *list: {&options.sessionCounts, &options.intraOpThreads, &options.callerCounts,
+                                &options.profileBatches, &options.memoryBatches,
+                                &options.clientThreads, &options.preprocessBatches,
+                                &options.scalingThreads, &options.cacheBatches,
+                                &options.decodePrompts, &options.decodeSequences}) {
+            if (std::find(list->begin(), list->end(), 0) != list->end()) {
+                throw std::invalid_argument("Session, thread, caller counts and batch sizes must be positive");
+            }
+        }
+
+        return options;
+    }
+
+    bool NeedsGlobalThreadPools(const BenchmarkOptions &options) {
+        auto selected = [&options](const char *name) {
+            return std::find(options.scenarios.begin(), options.scenarios.end(), name) != options.scenarios.end();
+        };
+        return (selected("mix") && options.mixGlobalThreadPools) ||
+               (selected("sessionpool") && options.sweepGlobalThreadPools);
+    }
+
+    void PrintUsage(const char *program) {
+        std::cout
+                << "Usage: " << program << " <model.onnx> [options]\n"
+                << "\n"
+                << "Options:\n"
+                << "  --scenario=a,b,...        scenarios to run in order (default: single,multi)\n"
+                << "                            single    single thread, one request at a time\n"
+                << "                            multi     closed-loop, all tasks pushed to the thread pool at once\n"
+                << "                            openloop  open-loop arrivals at a target rate\n"
+                << "                            batcher   dynamic batching vs per-request Run\n"
+                << "                            sessionpool  sweep sessions x intra-op threads x caller threads\n"
+                << "                            prepared  Run vs PreparedRun (tensors bound once)\n"
+                << "                            shapes    sweep a symbolic dimension (--sweep-dim)\n"
+                << "                            startup   cold/warm loads and first calls, model cache on/off\n"
+                << "                            profile   per-operator and per-node time from an ORT profile\n"
+                << "                            memory    RSS, arena growth and allocations per call, A/B options\n"
+                << "                            numa      a session replica per NUMA node vs one unpinned session\n"
+                << "                            mix       several models at once with weighted traffic (--mix)\n"
+                << "                            matrix    every combination of session options in --matrix, ranked\n"
+                << "                            async     RunAsync coroutines vs a blocked thread per request\n"
+                << "                            outputs   subsets of outputs vs all: latency, memory, nodes skipped\n"
+                << "                            serve     serve the model on --ipc-socket to client processes\n"
+                << "                            client    drive a serve process: end-to-end vs in-process latency\n"
+                << "                            preprocess  SIMD image preprocessing kernels, preprocess + infer\n"
+                << "                            slo       best batch size x concurrency within the --slo latency\n"
+                << "                            scaling   throughput and parallel efficiency over caller threads\n"
+                << "                            cache     hot vs rotating buffers vs flushed caches, side by side\n"
+                << "                            decode    autoregressive generation feeding the state back\n"
+                << "  --int-range=N             random integer inputs are drawn from [0, N) (default: 100)\n"
+                << "  --warmup-cv=CV            warm up a batch shape until the latency CV < CV (default: 0.05)\n"
+                << "  --warmup-max-seconds=S    longest warm-up of a batch shape (default: 10)\n"
+                << "  --precision=R             measure until the 95% CI is within R of the mean (default: 0.01)\n"
+                << "  --measure-max-seconds=S   time budget of a measurement (default: 10)\n"
+                << "  --dataset=PATH            read inputs from a .npy/raw file or a directory of them\n"
+                << "  --prefetch-depth=N        single: dataset batches prefetched ahead (default: 8)\n"
+                << "  --model-cache=DIR         load the model through an optimized-model cache in DIR\n"
+                << "  --cache-format=ort|onnx   format of cached optimized models (default: ort)\n"
+                << "  --startup-repeats=N       startup: warm loads per configuration (default: 5)\n"
+                << "  --first-calls=N           startup: calls timed one by one after the first (default: 10)\n"
+                << "  --profile-calls=N         profile, outputs: calls profiled per batch size/subset (default: 100)\n"
+                << "  --profile-batches=a,b,... profile: batch sizes (default: 1,8,64)\n"
+                << "  --profile-top=N           profile: nodes listed in the per-node table (default: 15)\n"
+                << "  --memory-variants=a,b,... memory: default, no-pattern, no-arena, no-arena-no-pattern,\n"
+                << "                            same-as-requested (arena extend strategy) (default: all)\n"
+                << "  --memory-batches=a,b,...  memory: batch sizes (default: 1,8,64)\n"
+                << "  --pin=none|compact|scatter|numa  pin caller and ORT intra-op threads: compact fills node\n"
+                << "                            by node, scatter spreads over cores and nodes, numa binds\n"
+                << "                            threads to nodes rather than CPUs (default: none)\n"
+                << "  --numa-callers=N          numa: caller threads per NUMA node (default: 1)\n"
+                << "  --mix=MODEL:W,...         mix: models and their share of the requests\n"
+                << "  --mix-callers=N           mix: caller threads, 0 = hardware concurrency (default: 0)\n"
+                << "  --mix-intra-threads=N     mix: intra-op threads per session, 0 = cores / models (default: 0)\n"
+                << "  --mix-pools=session,global  mix: per-session and/or shared global thread pools (default: both)\n"
+                << "  --mix-seconds=S           mix: duration of each pool kind (default: 5)\n"
+                << "  --matrix=FILE|SPEC        matrix: JSON file or 'axis=a,b;axis=c' with the axes optimization,\n"
+                << "                            execution_mode, intra_threads, inter_threads, spinning,\n"
+                << "                            denormal_as_zero and provider (cpu, xnnpack, dnnl, openvino)\n"
+                << "  --matrix-batches=a,b,...  matrix: batch sizes measured in every cell (default: 1)\n"
+                << "  --async-in-flight=a,b,... async: requests in flight (default: 1, 4 and 16 x core count)\n"
+                << "  --async-executor-threads=N  async: threads resuming the coroutines (default: 2)\n"
+                << "  --output-subsets=a+b,c    outputs: output subsets, '+' joins names (default: each output)\n"
+                << "  --export-pruned=DIR       outputs: write a model pruned to every subset and time its load\n"
+                << "  --ipc-socket=PATH         serve, client: Unix domain socket (default: /tmp/onnxbenchmark.sock)\n"
+                << "  --serve-seconds=S         serve: how long to serve, 0 = until interrupted (default: 0)\n"
+                << "  --client-threads=a,b,...  client: connections, one thread each (default: 1)\n"
+                << "  --client-depth=N          client: requests in flight per connection (default: 1)\n"
+                << "  --client-batch=N          client: batch size of a request (default: 1)\n"
+                << "  --client-seconds=S        client: duration per thread count (default: 5)\n"
+                << "  --image-size=HxW          preprocess: source image size (default: 480x640)\n"
+                << "  --simd=auto|scalar|sse4.1|avx2|avx512  preprocess: level of the pipeline (default: auto)\n"
+                << "  --preprocess-batches=a,b  preprocess: batch sizes of preprocess + infer (default: 1)\n"
+                << "  --slo=pP:MS               slo: P-th percentile latency objective in ms (default: p99:20)\n"
+                << "  --slo-max-batch=N         slo: largest batch size searched (default: 256)\n"
+                << "  --slo-max-concurrency=N   slo: most concurrent callers, 0 = hardware concurrency (default: 0)\n"
+                << "  --slo-seconds=S           slo: duration of every probe (default: 2)\n"
+                << "  --scaling-threads=a,b,... scaling: caller threads (default: 1, 2, 4, ... CPUs and the cores)\n"
+                << "  --scaling-batch=N         scaling: batch size of every call (default: 1)\n"
+                << "  --scaling-intra-threads=N scaling: intra-op threads of the shared session (default: 1)\n"
+                << "  --scaling-seconds=S       scaling: duration of every point (default: 3)\n"
+                << "  --scaling-knee=R          scaling: flattened once a thread adds < R of one (default: 0.5)\n"
+                << "  --cache-states=a,b,...    cache: hot, rotate and/or flush (default: all)\n"
+                << "  --cache-batches=a,b,...   cache: batch sizes (default: 1)\n"
+                << "  --state-map=OUT:IN,...    decode: outputs fed back as inputs, '*' matches any text\n"
+                << "                            (default: present.*:past_key_values.*)\n"
+                << "  --token-input=NAME        decode: input of the token ids (default: input_ids)\n"
+                << "  --decode-prompts=a,b,...  decode: prompt lengths (default: 32)\n"
+                << "  --decode-tokens=N         decode: tokens generated per sequence (default: 64)\n"
+                << "  --decode-sequences=a,b,.. decode: sequences decoded concurrently (default: 1)\n"
+                << "  --decode-seconds=S        decode: duration of every point (default: 5)\n"
+                << "  --perf-counters[=a,b,...] count cycles, instructions, IPC, LLC and branch misses and memory\n"
+                << "                            traffic per call and per input for these scenarios (default: all)\n"
+                << "  --json=PATH               write all results with model/ORT/host metadata as JSON\n"
+                << "  --csv=PATH                write all results as CSV\n"
+                << "  --compare=BASELINE.json   compare with an earlier --json run, exit 2 on regressions\n"
+                << "  --regression-threshold=R  relative median latency growth counted as regression (default: 0.05)\n"
+                << "  --alpha=P                 significance level of the Mann-Whitney test (default: 0.01)\n"
+                << "  --shape=NAME:AxB,...      full shape of named inputs, e.g. input_ids:1x128\n"
+                << "  --dim=SYMBOL:N,...        value of symbolic dimensions, e.g. sequence_length:128\n"
+                << "  --sweep-dim=SYMBOL:MIN:MAX  shapes: sweep SYMBOL over MIN, 2*MIN, ... MAX\n"
+                << "  --sweep-values=a,b,...    shapes: explicit values of the swept dimension\n"
+                << "  --arrival=poisson|constant  inter-arrival distribution of openloop (default: poisson)\n"
+                << "  --rate=QPS                openloop arrival rate, 0 sweeps up to saturation (default: 0)\n"
+                << "  --open-loop-seconds=S     duration of each openloop rate (default: 5)\n"
+                << "  --open-loop-batch=N       batch size of each openloop request (default: 1)\n"
+                << "  --max-batch=N             batcher: largest coalesced batch (default: 32)\n"
+                << "  --max-wait-us=N           batcher: longest wait of the oldest request (default: 1000)\n"
+                << "  --batcher-workers=N       batcher: batches in flight at once (default: 1)\n"
+                << "  --producers=N             batcher: producer threads, 0 = hardware concurrency (default: 0)\n"
+                << "  --requests-per-producer=N batcher: requests sent by each producer (default: 200)\n"
+                << "  --sessions=a,b,...        sessionpool: session counts K\n"
+                << "  --intra-threads=a,b,...   sessionpool: intra-op threads M of each per-session pool\n"
+                << "  --callers=a,b,...         sessionpool: caller threads (default: K and core count)\n"
+                << "  --thread-pools=session,global  sessionpool: per-session and/or global ORT thread pools\n"
+                << "  --sweep-seconds=S         duration of each sweep point (default: 2)\n"
+                << "  --sweep-batch=N           batch size of each sweep call (default: 1)\n"
+                << std::flush;
+    }
+}
@@ -0,0 +1,253 @@
+//
+// Created by antares on 4/5/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_OPTIONS_H
+#define TESTPROJECT_OPTIONS_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace OnnxBenchmarks {
+    enum class ArrivalProcess {
+        Poisson,
+        Constant,
+    };
+
+    enum class CacheFormat {
+        /// Optimized graph saved as ONNX
+        Onnx,
+        /// ORT format (flatbuffer), the fastest to load
+        Ort,
+    };
+
+    /// How caller and intra-op threads are pinned to CPUs, see ThreadPlacement
+    enum class PlacementPolicy {
+        None,
+        Compact,
+        Scatter,
+        /// Bound to NUMA nodes rather than single CPUs
+        Numa,
+    };
+
+    /// Command line options, `onnxbenchmark <model.onnx> [--key=value ...]`
+    struct BenchmarkOptions {
+        std::string modelPath;
+
+        /// Scenarios to run in order, see `--help`
+        std::vector<std::string> scenarios{"single", "multi"};
+
+        /// Random integer inputs (e.g. token ids) are drawn from [0, intRange)
+        size_t intRange = 100;
+
+        // adaptive warm-up and repeat counts
+        /// Warm-up of a batch shape ends once the coefficient of variation of recent calls is below this
+        double warmupCv = 0.05;
+        double warmupMaxSeconds = 10;
+        /// Measurements run until the 95% confidence interval of the mean is within this fraction of it
+        double precision = 0.01;
+        /// Time budget of a measurement that does not reach the precision
+        double measureMaxSeconds = 10;
+
+        /// Inputs are read from this .npy/raw file or directory instead of random data, see Dataset
+        std::string datasetPath;
+        /// Batches the single scenario keeps ready ahead of the timed loop when reading a dataset
+        size_t prefetchDepth = 8;
+
+        /// Load the model through an optimized-model cache in this directory, see ModelCache
+        std::string modelCacheDir;
+        CacheFormat cacheFormat = CacheFormat::Ort;
+
+        // startup benchmark
+        size_t startupRepeats = 5;
+        /// Calls after the first inference that are timed one by one
+        size_t firstCalls = 10;
+
+        // per-operator profile
+        size_t profileCalls = 100;
+        /// Batch sizes profiled, empty picks 1, 8 and 64 (only 1 without batch support)
+        std::vector<size_t> profileBatches;
+        /// Nodes listed in the per-node table
+        size_t profileTopNodes = 15;
+
+        // memory footprint
+        /// Session option variants compared by the memory scenario, see PrintUsage
+        std::vector<std::string> memoryVariants{"default", "no-pattern", "no-arena", "no-arena-no-pattern",
+                                                "same-as-requested"};
+        /// Batch sizes of the memory scenario, empty picks 1, 8 and 64 (only 1 without batch support)
+        std::vector<size_t> memoryBatches;
+
+        // CPU placement
+        PlacementPolicy placement = PlacementPolicy::None;
+        /// Caller threads per NUMA node of the numa scenario
+        size_t numaCallers = 1;
+
+        // co-located model mix
+        /// Models of the mix scenario with their share of the requests
+        std::vector<std::pair<std::string, double>> mixModels;
+        /// Caller threads of the mix, 0 means hardware concurrency
+        size_t mixCallers = 0;
+        /// Intra-op threads of every session with per-session pools, 0 splits the cores evenly
+        size_t mixIntraThreads = 0;
+        bool mixPerSessionThreadPools = true;
+        bool mixGlobalThreadPools = true;
+        double mixSeconds = 5;
+
+        // session option matrix
+        /// JSON file or inline `axis=a,b;axis=c` spec of the matrix scenario, see LoadConfigMatrix
+        std::string configMatrix;
+        /// Batch sizes measured in every cell, empty picks 1
+        std::vector<size_t> matrixBatches;
+
+        // asynchronous runs
+        /// Requests in flight compared by the async scenario, empty picks 1, 4 and 16 times the core count
+        std::vector<size_t> asyncInFlight;
+        /// Threads resuming the coroutines of the async scenario
+        size_t asyncExecutorThreads = 2;
+
+        // output subsets
+        /// Output subsets compared with all outputs, empty picks each single output
+        std::vector<std::vector<std::string>> outputSubsets;
+        /// Directory the model pruned to every subset is written to, empty to skip the pruned load times
+        std::string exportPrunedDir;
+
+        // IPC server and client
+        /// Unix domain socket of the serve and client scenarios
+        std::string ipcSocket = "/tmp/onnxbenchmark.sock";
+        /// How long the serve scenario serves, 0 until SIGINT/SIGTERM
+        double serveSeconds = 0;
+        /// Connections (one per thread) compared by the client scenario, empty picks 1
+        std::vector<size_t> clientThreads;
+        /// Requests in flight per connection, the slots of its ring
+        size_t clientDepth = 1;
+        size_t clientBatch = 1;
+        double clientSeconds = 5;
+
+        // image preprocessing
+        /// Size of the uint8 source images, resized to the model's image input
+        size_t imageHeight = 480;
+        size_t imageWidth = 640;
+        /// Instruction set of the preprocessing pipeline, see ParseSimdLevel
+        std::string simdLevel = "auto";
+        /// Batch sizes of the preprocess + infer pipelines, empty picks 1
+        std::vector<size_t> preprocessBatches;
+
+        // SLO search
+        /// The latency objective: the sloPercentile percentile of the latency per call within sloMilliseconds
+        double sloPercentile = 99;
+        double sloMilliseconds = 20;
+        size_t sloMaxBatch = 256;
+        /// Largest concurrency searched, 0 means hardware concurrency
+        size_t sloMaxConcurrency = 0;
+        /// Duration of every probed configuration
+        double sloSeconds = 2;
+
+        // thread scaling
+        /// Caller thread counts, empty picks powers of two up to the logical CPUs plus the physical core count
+        std::vector<size_t> scalingThreads;
+        size_t scalingBatch = 1;
+        /// Intra-op threads of the session the callers share
+        size_t scalingIntraThreads = 1;
+        double scalingSeconds = 3;
+        /// Scaling has flattened once a thread adds less than this fraction of the single-thread throughput
+        double scalingKnee = 0.5;
+
+        // cache states
+        /// hot (the same buffers every call), rotate (a pool of buffers larger than the LLC) and flush
+        /// (the caches are evicted between calls)
+        std::vector<std::string> cacheStates{"hot", "rotate", "flush"};
+        /// Batch sizes measured in every state, empty picks 1
+        std::vector<size_t> cacheBatches;
+
+        // stateful decoding
+        /// OUTPUT:INPUT name patterns with at most one '*' each, the outputs fed back as inputs at the next step
+        std::vector<std::string> stateMap{"present.*:past_key_values.*"};
+        std::string tokenInput = "input_ids";
+        /// Prompt lengths, the first step runs the whole prompt
+        std::vector<size_t> decodePrompts{32};
+        /// Tokens generated per sequence: one from the prompt step, then one per decode step
+        size_t decodeTokens = 64;
+        /// Sequences decoded at the same time, one caller thread each
+        std::vector<size_t> decodeSequences{1};
+        double decodeSeconds = 5;
+
+        // hardware counters
+        /// Scenarios whose points get hardware event counts (perf_event_open), "all" for every scenario
+        std::vector<std::string> perfCounterScenarios;
+
+        // machine-readable results
+        std::string jsonPath;
+        std::string csvPath;
+        /// Results file of an earlier run to compare against, regressions make the run fail
+        std::string comparePath;
+        /// Smallest relative growth of the median latency counted as a regression
+        double regressionThreshold = 0.05;
+        /// Significance level of the Mann-Whitney test of a regression
+        double significance = 0.01;
+
+        // dynamic dimensions, see DynamicDims
+        std::map<std::string, std::vector<int64_t>> shapes;
+        std::map<std::string, int64_t> dims;
+        /// Symbolic dimension swept by the shapes scenario, over sweepDimValues
+        std::string sweepDim;
+        std::vector<int64_t> sweepDimValues;
+
+        // open-loop load generator
+        ArrivalProcess arrival = ArrivalProcess::Poisson;
+        /// Target arrival rate in requests per second, 0 sweeps the rate up to saturation
+        double rate = 0;
+        double openLoopSeconds = 5;
+        size_t openLoopBatch = 1;
+
+        // dynamic batching
+        size_t maxBatch = 32;
+        size_t maxWaitMicroseconds = 1000;
+        size_t batcherWorkers = 1;
+        /// Producer threads of the dynamic batching scenario, 0 means hardware concurrency
+        size_t producers = 0;
+        size_t requestsPerProducer = 200;
+
+        // session pool / thread partitioning sweep, empty lists pick powers of two up to the core count
+        std::vector<size_t> sessionCounts;
+        std::vector<size_t> intraOpThreads;
+        std::vector<size_t> callerCounts;
+        bool sweepGlobalThreadPools = false;
+        bool sweepPerSessionThreadPools = true;
+        double sweepSeconds = 2;
+        size_t sweepBatch = 1;
+    };
+
+    /// Some selected scenario runs sessions on the global thread pools of a shared Env
+    bool NeedsGlobalThreadPools(const BenchmarkOptions &options);
+
+    /// Parse argv into options, throws std::invalid_argument on malformed or unknown options.
+    BenchmarkOptions ParseOptions(int argc, char **argv);
+
+    void PrintUsage(const char *program);
+}
+
+#endif //TESTPROJECT_OPTIONS_H
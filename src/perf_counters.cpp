@@ -0,0 +1,346 @@
+//
+// Created by antares on 5/14/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "perf_counters.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace OnnxBenchmarks {
+    namespace {
+        int PerfEventOpen(perf_event_attr &attr, pid_t tid, int cpu) {
+            return static_cast<int>(syscall(SYS_perf_event_open, &attr, tid, cpu, -1, PERF_FLAG_FD_CLOEXEC));
+        }
+
+        std::string ReadLine(const std::filesystem::path &path) {
+            std::ifstream file(path);
+            std::string line;
+            std::getline(file, line);
+            return line;
+        }
+
+        std::string OpenError(int error) {
+            std::string answer = std::strerror(error);
+            if (error == EACCES || error == EPERM) {
+                answer += " (perf_event_paranoid " + ReadLine("/proc/sys/kernel/perf_event_paranoid") + ")";
+            } else if (error == ENOENT || error == EOPNOTSUPP) {
+                answer += " (no such event on this PMU, e.g. in a VM)";
+            } else if (error == ENOSYS) {
+                answer += " (perf_event_open blocked, e.g. by a container's seccomp profile)";
+            }
+            return answer;
+        }
+
+        /// Sum of the counter over its fds, each scaled up by enabled/running time if it was multiplexed,
+        /// negative when the counter is not open
+        double ReadCounter(const std::vector<int> &fds) {
+            if (fds.empty()) {
+                return -1;
+            }
+            double total = 0;
+            for (auto fd: fds) {
+                // value, time enabled, time running
+                uint64_t values[3]{};
+                if (read(fd, values, sizeof(values)) != static_cast<ssize_t>(sizeof(values)) || values[2] == 0) {
+                    continue;
+                }
+                total += static_cast<double>(values[0]) * static_cast<double>(values[1]) /
+                         static_cast<double>(values[2]);
+            }
+            return total;
+        }
+
+        /// Encode "event=0x04,umask=0x03" into a config by the PMU's format files ("config:0-7"), false when
+        /// a term does not go into `config`
+        bool EncodePmuEvent(const std::filesystem::path &pmu, const std::string &event, uint64_t &config) {
+            config = 0;
+            size_t begin = 0;
+            while (begin < event.size()) {
+                auto end = event.find(',', begin);
+                if (end == std::string::npos) {
+                    end = event.size();
+                }
+                auto term = event.substr(begin, end - begin);
+                begin = end + 1;
+                auto eq = term.find('=');
+                auto value = eq == std::string::npos ? 1 : std::stoull(term.substr(eq + 1), nullptr, 0);
+                auto format = ReadLine(pmu / "format" / term.substr(0, eq));
+                // "config:0-7" or "config:23", the low bit is all that is needed
+                unsigned low;
+                if (std::sscanf(format.c_str(), "config:%u", &low) == 1) {
+                    config |= value << low;
+                } else {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /// The first CPU of every package, from an uncore PMU's cpumask ("0,18")
+        std::vector<int> PmuCpus(const std::filesystem::path &pmu) {
+            std::vector<int> cpus;
+            std::istringstream list(ReadLine(pmu / "cpumask"));
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                int first;
+                if (std::sscanf(item.c_str(), "%d", &first) == 1) {
+                    cpus.emplace_back(first);
+                }
+            }
+            return cpus;
+        }
+    }
+
+    HardwareCounts HardwareCounts::Since(const HardwareCounts &earlier) const {
+        auto difference = [](double now, double then) { return now >= 0 && then >= 0 ? now - then : -1; };
+        HardwareCounts answer;
+        answer.cycles = difference(cycles, earlier.cycles);
+        answer.instructions = difference(instructions, earlier.instructions);
+        answer.llcMisses = difference(llcMisses, earlier.llcMisses);
+        answer.branchMisses = difference(branchMisses, earlier.branchMisses);
+        answer.memoryBytes = difference(memoryBytes, earlier.memoryBytes);
+        answer.seconds = seconds - earlier.seconds;
+        return answer;
+    }
+
+    HardwareCounts HardwareCounts::Plus(const HardwareCounts &other) const {
+        auto sum = [](double a, double b) { return a >= 0 && b >= 0 ? a + b : -1; };
+        HardwareCounts answer;
+        answer.cycles = sum(cycles, other.cycles);
+        answer.instructions = sum(instructions, other.instructions);
+        answer.llcMisses = sum(llcMisses, other.llcMisses);
+        answer.branchMisses = sum(branchMisses, other.branchMisses);
+        answer.memoryBytes = sum(memoryBytes, other.memoryBytes);
+        answer.seconds = seconds + other.seconds;
+        return answer;
+    }
+
+    HardwareCounts HardwareCounts::PerUnit(double n) const {
+        auto divide = [n](double count) { return count >= 0 ? count / n : -1; };
+        HardwareCounts answer;
+        answer.cycles = divide(cycles);
+        answer.instructions = divide(instructions);
+        answer.llcMisses = divide(llcMisses);
+        answer.branchMisses = divide(branchMisses);
+        answer.memoryBytes = divide(memoryBytes);
+        answer.seconds = seconds / n;
+        return answer;
+    }
+
+    PerfCounters *&ActivePerfCounters() {
+        static PerfCounters *counters = nullptr;
+        return counters;
+    }
+
+    HardwareCounts ReadActiveCounts() {
+        auto *counters = ActivePerfCounters();
+        return counters ? counters->Read() : HardwareCounts{};
+    }
+
+    CountingWindow::CountingWindow() : counters(ActivePerfCounters()) {
+        if (counters) {
+            counters->Enable();
+        }
+    }
+
+    CountingWindow::~CountingWindow() {
+        if (counters && !paused) {
+            counters->Disable();
+        }
+    }
+
+    PerfCounters::PerfCounters() {
+        std::vector<int> threads;
+        std::error_code error;
+        for (const auto &entry: std::filesystem::directory_iterator("/proc/self/task", error)) {
+            threads.emplace_back(std::stoi(entry.path().filename().string()));
+        }
+        _open_thread_counter(cycles, "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, threads);
+        _open_thread_counter(instructions, "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,
+                             threads);
+        _open_thread_counter(llcMisses, "llc-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, threads);
+        _open_thread_counter(branchMisses, "branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,
+                             threads);
+        _open_memory_counters();
+    }
+
+    PerfCounters::~PerfCounters() {
+        for (auto *counter: {&cycles, &instructions, &llcMisses, &branchMisses}) {
+            for (auto fd: counter->fds) {
+                close(fd);
+            }
+        }
+        for (const auto &counter: memoryTraffic) {
+            for (auto fd: counter.fds) {
+                close(fd);
+            }
+        }
+    }
+
+    void PerfCounters::_open_thread_counter(Counter &counter, const char *name, uint32_t type, uint64_t config,
+                                            const std::vector<int> &threads) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // threads started later by a counted thread get a copy, read() sums the copies
+        attr.inherit = 1;
+        // counting starts with the first window, enabling the parent enables the inherited copies too
+        attr.disabled = 1;
+        // user space only, which perf_event_paranoid 2 still allows
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        int firstError = 0;
+        for (auto tid: threads) {
+            auto fd = PerfEventOpen(attr, tid, -1);
+            if (fd >= 0) {
+                counter.fds.emplace_back(fd);
+            } else if (firstError == 0 && errno != ESRCH) {
+                // ESRCH: the thread exited since the listing
+                firstError = errno;
+            }
+        }
+        if (counter.fds.empty()) {
+            missing.emplace_back(std::string(name) + ": " + OpenError(firstError != 0 ? firstError : ESRCH));
+        }
+    }
+
+    void PerfCounters::_open_memory_counters() {
+        std::error_code error;
+        for (const auto &entry: std::filesystem::directory_iterator("/sys/bus/event_source/devices", error)) {
+            const auto &pmu = entry.path();
+            if (pmu.filename().string().rfind("uncore_imc", 0) != 0) {
+                continue;
+            }
+            for (const char *event: {"cas_count_read", "cas_count_write"}) {
+                Counter counter;
+                uint64_t config;
+                auto type = ReadLine(pmu / "type");
+                auto scale = ReadLine(pmu / "events" / (std::string(event) + ".scale"));
+                auto unit = ReadLine(pmu / "events" / (std::string(event) + ".unit"));
+                if (type.empty() || !EncodePmuEvent(pmu, ReadLine(pmu / "events" / event), config)) {
+                    continue;
+                }
+                // the scale turns CAS counts (64-byte lines) into the unit, MiB on current kernels
+                counter.scale = (scale.empty() ? 64. : std::stod(scale)) * (unit == "MiB" ? 1024. * 1024. : 1.);
+                perf_event_attr attr{};
+                attr.size = sizeof(attr);
+                attr.type = static_cast<uint32_t>(std::stoul(type));
+                attr.config = config;
+                attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                attr.disabled = 1;
+                for (auto cpu: PmuCpus(pmu)) {
+                    auto fd = PerfEventOpen(attr, -1, cpu);
+                    if (fd < 0) {
+                        missing.emplace_back("memory bandwidth: " + OpenError(errno));
+                        for (auto opened: counter.fds) {
+                            close(opened);
+                        }
+                        for (const auto &other: memoryTraffic) {
+                            for (auto opened: other.fds) {
+                                close(opened);
+                            }
+                        }
+                        memoryTraffic.clear();
+                        return;
+                    }
+                    counter.fds.emplace_back(fd);
+                }
+                memoryTraffic.emplace_back(std::move(counter));
+            }
+        }
+        if (memoryTraffic.empty()) {
+            missing.emplace_back("memory bandwidth: no uncore memory controller PMU (uncore_imc)");
+        }
+    }
+
+    void PerfCounters::_ioctl_all(unsigned long request) const {
+        for (const auto *counter: {&cycles, &instructions, &llcMisses, &branchMisses}) {
+            for (auto fd: counter->fds) {
+                ioctl(fd, request, 0);
+            }
+        }
+        for (const auto &counter: memoryTraffic) {
+            for (auto fd: counter.fds) {
+                ioctl(fd, request, 0);
+            }
+        }
+    }
+
+    void PerfCounters::Enable() {
+        std::lock_guard lock(mutex);
+        if (depth++ == 0) {
+            enabledAt = std::chrono::steady_clock::now();
+            _ioctl_all(PERF_EVENT_IOC_ENABLE);
+        }
+    }
+
+    void PerfCounters::Disable() {
+        std::lock_guard lock(mutex);
+        if (depth > 0 && --depth == 0) {
+            _ioctl_all(PERF_EVENT_IOC_DISABLE);
+            enabledSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - enabledAt).count();
+            ++windows;
+        }
+    }
+
+    size_t PerfCounters::Windows() const {
+        std::lock_guard lock(mutex);
+        return windows;
+    }
+
+    bool PerfCounters::Available() const {
+        return !cycles.fds.empty() || !instructions.fds.empty() || !llcMisses.fds.empty() ||
+               !branchMisses.fds.empty();
+    }
+
+    HardwareCounts PerfCounters::Read() const {
+        HardwareCounts counts;
+        counts.cycles = ReadCounter(cycles.fds);
+        counts.instructions = ReadCounter(instructions.fds);
+        counts.llcMisses = ReadCounter(llcMisses.fds);
+        counts.branchMisses = ReadCounter(branchMisses.fds);
+        if (!memoryTraffic.empty()) {
+            counts.memoryBytes = 0;
+            for (const auto &counter: memoryTraffic) {
+                counts.memoryBytes += ReadCounter(counter.fds) * counter.scale;
+            }
+        }
+        std::lock_guard lock(mutex);
+        counts.seconds = enabledSeconds;
+        if (depth > 0) {
+            counts.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - enabledAt).count();
+        }
+        return counts;
+    }
+}
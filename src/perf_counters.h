@@ -0,0 +1,169 @@
+//
+// Created by antares on 5/14/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_PERF_COUNTERS_H
+#define TESTPROJECT_PERF_COUNTERS_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace OnnxBenchmarks {
+    /// Hardware event counts, each negative when its counter could not be opened
+    struct HardwareCounts {
+        double cycles = -1;
+        double instructions = -1;
+        /// Last-level cache misses (the generic cache-misses event)
+        double llcMisses = -1;
+        double branchMisses = -1;
+        /// Bytes read and written by the memory controllers, machine-wide rather than this process alone
+        double memoryBytes = -1;
+        /// Wall time the counters were enabled
+        double seconds = 0;
+
+        [[nodiscard]] bool Collected() const {
+            return cycles >= 0 || instructions >= 0 || llcMisses >= 0 || branchMisses >= 0 || memoryBytes >= 0;
+        }
+
+        /// Instructions per cycle, negative when either count is missing
+        [[nodiscard]] double Ipc() const {
+            return cycles > 0 && instructions >= 0 ? instructions / cycles : -1;
+        }
+
+        /// Bytes per second of memory traffic, negative when not counted
+        [[nodiscard]] double MemoryBandwidth() const {
+            return memoryBytes >= 0 && seconds > 0 ? memoryBytes / seconds : -1;
+        }
+
+        /// Counts (and time) since `earlier`, missing counts stay missing
+        [[nodiscard]] HardwareCounts Since(const HardwareCounts &earlier) const;
+
+        /// Counts (and time) of both, e.g. two windows of one point; missing counts stay missing
+        [[nodiscard]] HardwareCounts Plus(const HardwareCounts &other) const;
+
+        /// Every count and the time divided by `n`, e.g. per call; ratios such as Ipc() are unchanged
+        [[nodiscard]] HardwareCounts PerUnit(double n) const;
+    };
+
+    /// Counts user-space cycles, instructions, LLC misses and branch misses with perf_event_open on every
+    /// thread of the process at construction, ORT's thread pools included. The counters are inherited, so
+    /// threads started later by any of them are counted as well. Memory traffic is counted machine-wide on
+    /// Intel's uncore memory controllers (cas_count_read/write) where the PMU exposes them and perf allows
+    /// CPU-wide events. Counters that cannot be opened (no PMU in a VM, perf_event_paranoid, a container's
+    /// seccomp profile) are left out and reported by Missing().
+    ///
+    /// The counters start disabled and only count inside Enable()/Disable() windows, which the measurement
+    /// helpers open around their timed calls (see CountingWindow), so warm-up and setup are not counted.
+    class PerfCounters {
+        struct Counter {
+            std::vector<int> fds;
+            /// Multiplies the raw count, e.g. MiB per CAS count
+            double scale = 1;
+        };
+
+        Counter cycles, instructions, llcMisses, branchMisses;
+        std::vector<Counter> memoryTraffic;
+        std::vector<std::string> missing;
+        mutable std::mutex mutex;
+        /// Open windows, nested or on several threads; the counters run while it is positive
+        size_t depth = 0;
+        size_t windows = 0;
+        std::chrono::steady_clock::time_point enabledAt;
+        double enabledSeconds = 0;
+
+        void _ioctl_all(unsigned long request) const;
+
+        void _open_thread_counter(Counter &counter, const char *name, uint32_t type, uint64_t config,
+                                  const std::vector<int> &threads);
+
+        void _open_memory_counters();
+
+    public:
+        PerfCounters();
+
+        PerfCounters(const PerfCounters &) = delete;
+
+        PerfCounters &operator=(const PerfCounters &) = delete;
+
+        ~PerfCounters();
+
+        /// At least one per-thread counter is open
+        [[nodiscard]] bool Available() const;
+
+        /// Why each counter that is not open failed, e.g. "cycles: Permission denied (perf_event_paranoid 3)"
+        [[nodiscard]] const std::vector<std::string> &Missing() const { return missing; }
+
+        /// Start counting, windows may nest
+        void Enable();
+
+        /// Stop counting once every window is closed
+        void Disable();
+
+        /// Windows closed so far, to tell whether anything was counted between two reads
+        [[nodiscard]] size_t Windows() const;
+
+        /// Counts of all windows so far, scaled up for the time a counter was multiplexed out
+        [[nodiscard]] HardwareCounts Read() const;
+    };
+
+    /// The counters the measurement helpers count into, nullptr while none are collected
+    PerfCounters *&ActivePerfCounters();
+
+    /// Read() of the active counters, every count missing without them
+    HardwareCounts ReadActiveCounts();
+
+    /// Enables the active counters (if any) for its lifetime, Pause()/Resume() leave untimed work out
+    class CountingWindow {
+        PerfCounters *counters;
+        bool paused = false;
+
+    public:
+        CountingWindow();
+
+        CountingWindow(const CountingWindow &) = delete;
+
+        CountingWindow &operator=(const CountingWindow &) = delete;
+
+        ~CountingWindow();
+
+        void Pause() {
+            if (counters && !paused) {
+                counters->Disable();
+                paused = true;
+            }
+        }
+
+        void Resume() {
+            if (counters && paused) {
+                counters->Enable();
+                paused = false;
+            }
+        }
+    };
+}
+
+#endif //TESTPROJECT_PERF_COUNTERS_H
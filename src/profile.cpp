@@ -0,0 +1,110 @@
+//
+// Created by antares on 4/27/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "profile.h"
+#include "json.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace OnnxBenchmarks {
+    namespace {
+        constexpr std::string_view KernelSuffix = "_kernel_time";
+
+        struct RunSpan {
+            double begin;
+            double end;
+        };
+    }
+
+    std::vector<RunProfile> ParseOrtProfile(const std::string &path, const std::vector<int> &groupOfRun,
+                                            size_t groupCount) {
+        auto trace = JsonValue::ParseFile(path);
+        const auto &events = trace.IsArray() ? trace.AsArray() : trace.At("traceEvents").AsArray();
+
+        std::vector<RunSpan> runs;
+        for (const auto &event: events) {
+            auto cat = event.Find("cat");
+            auto name = event.Find("name");
+            if (cat && name && cat->AsString() == "Session" && name->AsString() == "model_run") {
+                auto ts = event.At("ts").AsNumber();
+                runs.emplace_back(RunSpan{ts, ts + event.At("dur").AsNumber()});
+            }
+        }
+        std::sort(runs.begin(), runs.end(), [](const RunSpan &a, const RunSpan &b) { return a.begin < b.begin; });
+        if (runs.size() != groupOfRun.size()) {
+            throw std::runtime_error("Profile " + path + " holds " + std::to_string(runs.size()) + " runs, expected " +
+                                     std::to_string(groupOfRun.size()));
+        }
+
+        std::vector<RunProfile> profiles(groupCount);
+        for (size_t i = 0; i < runs.size(); ++i) {
+            if (groupOfRun[i] >= 0) {
+                auto &profile = profiles.at(static_cast<size_t>(groupOfRun[i]));
+                ++profile.runs;
+                profile.runMicroseconds += runs[i].end - runs[i].begin;
+            }
+        }
+
+        for (const auto &event: events) {
+            auto cat = event.Find("cat");
+            if (!cat || cat->AsString() != "Node") {
+                continue;
+            }
+            const auto &name = event.At("name").AsString();
+            if (name.size() <= KernelSuffix.size() ||
+                name.compare(name.size() - KernelSuffix.size(), KernelSuffix.size(), KernelSuffix) != 0) {
+                continue;
+            }
+            auto ts = event.At("ts").AsNumber();
+            auto it = std::upper_bound(runs.begin(), runs.end(), ts,
+                                       [](double t, const RunSpan &run) { return t < run.begin; });
+            if (it == runs.begin() || ts > (it - 1)->end) {
+                continue;
+            }
+            auto group = groupOfRun[static_cast<size_t>(it - 1 - runs.begin())];
+            if (group < 0) {
+                continue;
+            }
+
+            auto &profile = profiles[static_cast<size_t>(group)];
+            auto node = name.substr(0, name.size() - KernelSuffix.size());
+            std::string op = "unknown";
+            if (auto args = event.Find("args")) {
+                if (auto opName = args->Find("op_name")) {
+                    op = opName->AsString();
+                }
+            }
+            auto dur = event.At("dur").AsNumber();
+            auto &opEntry = profile.ops[op];
+            opEntry.microseconds += dur;
+            ++opEntry.calls;
+            auto &nodeEntry = profile.nodes[node];
+            nodeEntry.microseconds += dur;
+            ++nodeEntry.calls;
+            profile.nodeOps[node] = op;
+        }
+        return profiles;
+    }
+}
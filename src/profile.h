@@ -0,0 +1,57 @@
+//
+// Created by antares on 4/27/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_PROFILE_H
+#define TESTPROJECT_PROFILE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace OnnxBenchmarks {
+    struct ProfileEntry {
+        double microseconds = 0;
+        size_t calls = 0;
+    };
+
+    /// Kernel time of a group of runs, aggregated per op type and per node
+    struct RunProfile {
+        size_t runs = 0;
+        /// Wall time of the runs as seen by the session
+        double runMicroseconds = 0;
+        std::map<std::string, ProfileEntry> ops;
+        std::map<std::string, ProfileEntry> nodes;
+        /// Op type of every node
+        std::map<std::string, std::string> nodeOps;
+    };
+
+    /// Parse an ORT profile (Chrome trace JSON). The n-th `model_run` of the trace belongs to group
+    /// `groupOfRun[n]` (negative to ignore it, e.g. for warm-up runs), and every node event is attributed
+    /// to the run whose time span contains it.
+    std::vector<RunProfile> ParseOrtProfile(const std::string &path, const std::vector<int> &groupOfRun,
+                                            size_t groupCount);
+}
+
+#endif //TESTPROJECT_PROFILE_H
@@ -0,0 +1,409 @@
+//
+// Created by antares on 4/25/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "results.h"
+#include "benchmarks.h"
+#include "benchmark_utils.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+namespace OnnxBenchmarks {
+    namespace {
+        JsonValue HistogramToJson(const LatencyHistogram &histogram) {
+            auto ms = NanosecondsToMilliseconds;
+            JsonValue json;
+            json["count"] = histogram.Count();
+            json["min_ms"] = ms(histogram.Min());
+            json["mean_ms"] = histogram.Mean() / 1e6;
+            json["p50_ms"] = ms(histogram.Percentile(50));
+            json["p90_ms"] = ms(histogram.Percentile(90));
+            json["p99_ms"] = ms(histogram.Percentile(99));
+            json["p999_ms"] = ms(histogram.Percentile(99.9));
+            json["max_ms"] = ms(histogram.Max());
+            // [bucket index, count] pairs, enough to rebuild the distribution for comparisons
+            auto &buckets = json["buckets"] = JsonValue::Array{};
+            for (size_t i = 0; i < LatencyHistogram::BucketCount; ++i) {
+                if (auto count = histogram.CountAt(i)) {
+                    buckets.Push(JsonValue::Array{static_cast<uint64_t>(i), count});
+                }
+            }
+            return json;
+        }
+
+        LatencyHistogram HistogramFromJson(const JsonValue &json) {
+            LatencyHistogram histogram;
+            for (const auto &bucket: json.At("buckets").AsArray()) {
+                const auto &pair = bucket.AsArray();
+                if (pair.size() != 2 || pair[0].AsNumber() < 0 ||
+                    pair[0].AsNumber() >= static_cast<double>(LatencyHistogram::BucketCount)) {
+                    throw std::runtime_error("Malformed histogram bucket");
+                }
+                auto index = static_cast<size_t>(pair[0].AsNumber());
+                auto low = LatencyHistogram::LowestEquivalent(index);
+                histogram.Record(low + (LatencyHistogram::HighestEquivalent(index) - low) / 2,
+                                 static_cast<uint64_t>(pair[1].AsNumber()));
+            }
+            return histogram;
+        }
+
+        std::string CsvField(const std::string &field) {
+            if (field.find_first_of(",\"\n") == std::string::npos) {
+                return field;
+            }
+            std::string quoted = "\"";
+            for (char c: field) {
+                quoted += c == '"' ? "\"\"" : std::string(1, c);
+            }
+            return quoted + "\"";
+        }
+
+        /// The counted events of `counts`, missing ones left out
+        JsonValue CountsToJson(const HardwareCounts &counts) {
+            JsonValue json = JsonValue::Object{};
+            for (auto [name, value]: {std::pair{"cycles", counts.cycles}, {"instructions", counts.instructions},
+                                      {"llc_misses", counts.llcMisses}, {"branch_misses", counts.branchMisses},
+                                      {"memory_bytes", counts.memoryBytes}}) {
+                if (value >= 0) {
+                    json[name] = value;
+                }
+            }
+            return json;
+        }
+
+        /// The counts in the CSV column order, -1 for the ones not collected
+        std::array<double, 5> CountsInCsvOrder(const HardwareCounts &counts) {
+            return {counts.cycles, counts.instructions, counts.llcMisses, counts.branchMisses, counts.memoryBytes};
+        }
+
+        std::string CpuModel() {
+            std::ifstream cpuinfo("/proc/cpuinfo");
+            std::string line;
+            while (std::getline(cpuinfo, line)) {
+                if (line.rfind("model name", 0) == 0) {
+                    auto colon = line.find(':');
+                    if (colon != std::string::npos) {
+                        return line.substr(line.find_first_not_of(' ', colon + 1));
+                    }
+                }
+            }
+            return "unknown";
+        }
+    }
+
+    size_t BenchmarkResult::BatchSize() const {
+        for (const auto &[name, value]: params) {
+            if (name == "batch") {
+                return std::max<size_t>(std::strtoul(value.c_str(), nullptr, 10), 1);
+            }
+        }
+        return 1;
+    }
+
+    std::string BenchmarkResult::Key() const {
+        std::string key = scenario;
+        for (const auto &[name, value]: params) {
+            key += " " + name + "=" + value;
+        }
+        return key + " [" + metric + "]";
+    }
+
+    void ResultsReport::Add(BenchmarkResult result) {
+        bool samePoint = !results.empty() && results.back().scenario == result.scenario &&
+                         results.back().params == result.params;
+        if (samePoint) {
+            result.memory = results.back().memory;
+        } else {
+            result.memory = ReadMemoryUsage();
+            ResetPeakRss();
+        }
+        if (perfCounters != nullptr) {
+            auto windows = perfCounters->Windows();
+            if (!result.counters.Collected() && windows != lastWindows) {
+                auto calls = static_cast<double>(std::max<uint64_t>(result.latency.Count(), 1));
+                result.counters = perfCounters->Read().Since(lastCounts).PerUnit(calls);
+            } else if (!result.counters.Collected() && samePoint) {
+                // another metric of the same calls
+                result.counters = results.back().counters;
+            }
+            if (windows != lastWindows) {
+                lastCounts = perfCounters->Read();
+                lastWindows = windows;
+            }
+        }
+        results.emplace_back(std::move(result));
+    }
+
+    void ResultsReport::CountHardwareEvents(const PerfCounters *counters) {
+        perfCounters = counters;
+        if (perfCounters != nullptr) {
+            lastCounts = perfCounters->Read();
+            lastWindows = perfCounters->Windows();
+        }
+    }
+
+    JsonValue ResultsReport::ToJson() const {
+        JsonValue json;
+        json["metadata"] = metadata;
+        auto &array = json["results"] = JsonValue::Array{};
+        for (const auto &result: results) {
+            JsonValue entry;
+            entry["scenario"] = result.scenario;
+            auto &params = entry["params"] = JsonValue::Object{};
+            for (const auto &[name, value]: result.params) {
+                params[name] = value;
+            }
+            entry["metric"] = result.metric;
+            entry["throughput"] = result.throughput;
+            entry["relative_ci95"] = result.relativeHalfWidth;
+            entry["latency"] = HistogramToJson(result.latency);
+            auto &memory = entry["memory"];
+            memory["rss_bytes"] = static_cast<uint64_t>(result.memory.rss);
+            memory["peak_rss_bytes"] = static_cast<uint64_t>(result.memory.peakRss);
+            memory["heap_bytes"] = static_cast<uint64_t>(result.memory.heapInUse);
+            if (result.allocationsPerCall >= 0) {
+                memory["allocations_per_call"] = result.allocationsPerCall;
+                memory["allocated_bytes_per_call"] = result.allocatedBytesPerCall;
+            }
+            if (result.counters.Collected()) {
+                auto &counters = entry["counters"];
+                counters["per_call"] = CountsToJson(result.counters);
+                counters["per_input"] = CountsToJson(result.counters.PerUnit(
+                        static_cast<double>(result.BatchSize())));
+                if (result.counters.Ipc() >= 0) {
+                    counters["ipc"] = result.counters.Ipc();
+                }
+                if (result.counters.MemoryBandwidth() >= 0) {
+                    counters["memory_bytes_per_second"] = result.counters.MemoryBandwidth();
+                }
+            }
+            array.Push(std::move(entry));
+        }
+        if (!details.IsNull()) {
+            json["details"] = details;
+        }
+        return json;
+    }
+
+    void ResultsReport::WriteJson(const std::string &path) const {
+        std::ofstream file(path);
+        if (!file) {
+            throw std::runtime_error("Can not write " + path);
+        }
+        ToJson().Dump(file);
+    }
+
+    void ResultsReport::WriteCsv(const std::string &path) const {
+        std::ofstream file(path);
+        if (!file) {
+            throw std::runtime_error("Can not write " + path);
+        }
+        auto ms = NanosecondsToMilliseconds;
+        file << std::setprecision(9);
+        file << "scenario,params,metric,count,min_ms,mean_ms,p50_ms,p90_ms,p99_ms,p999_ms,max_ms,throughput,"
+                "relative_ci95,rss_bytes,peak_rss_bytes,heap_bytes,allocations_per_call,allocated_bytes_per_call";
+        for (const char *unit: {"call", "input"}) {
+            for (const char *name: {"cycles", "instructions", "llc_misses", "branch_misses", "memory_bytes"}) {
+                file << ',' << name << "_per_" << unit;
+            }
+        }
+        file << ",ipc,memory_bytes_per_second\n";
+        for (const auto &result: results) {
+            std::string params;
+            for (const auto &[name, value]: result.params) {
+                params += (params.empty() ? "" : ";") + name + "=" + value;
+            }
+            const auto &h = result.latency;
+            file << CsvField(result.scenario) << ',' << CsvField(params) << ',' << CsvField(result.metric) << ','
+                 << h.Count() << ',' << ms(h.Min()) << ',' << h.Mean() / 1e6 << ',' << ms(h.Percentile(50)) << ','
+                 << ms(h.Percentile(90)) << ',' << ms(h.Percentile(99)) << ',' << ms(h.Percentile(99.9)) << ','
+                 << ms(h.Max()) << ',' << result.throughput << ',' << result.relativeHalfWidth << ','
+                 << result.memory.rss << ',' << result.memory.peakRss << ',' << result.memory.heapInUse << ',';
+            if (result.allocationsPerCall >= 0) {
+                file << result.allocationsPerCall << ',' << result.allocatedBytesPerCall;
+            } else {
+                file << ',';
+            }
+            // hardware counts as in the JSON counters, empty where not collected
+            std::array<double, 12> counts;
+            counts.fill(-1);
+            if (result.counters.Collected()) {
+                auto perCall = CountsInCsvOrder(result.counters);
+                auto perInput = CountsInCsvOrder(result.counters.PerUnit(static_cast<double>(result.BatchSize())));
+                std::copy(perCall.begin(), perCall.end(), counts.begin());
+                std::copy(perInput.begin(), perInput.end(), counts.begin() + perCall.size());
+                counts[10] = result.counters.Ipc();
+                counts[11] = result.counters.MemoryBandwidth();
+            }
+            for (auto value: counts) {
+                file << ',';
+                if (value >= 0) {
+                    file << value;
+                }
+            }
+            file << '\n';
+        }
+    }
+
+    ResultsReport ResultsReport::LoadJson(const std::string &path) {
+        auto json = JsonValue::ParseFile(path);
+        ResultsReport report;
+        if (auto metadata = json.Find("metadata")) {
+            report.metadata = *metadata;
+        }
+        for (const auto &entry: json.At("results").AsArray()) {
+            BenchmarkResult result;
+            result.scenario = entry.At("scenario").AsString();
+            for (const auto &[name, value]: entry.At("params").AsObject()) {
+                result.params.emplace_back(name, value.AsString());
+            }
+            result.metric = entry.At("metric").AsString();
+            result.throughput = entry.At("throughput").AsNumber();
+            if (auto ci = entry.Find("relative_ci95")) {
+                result.relativeHalfWidth = ci->AsNumber();
+            }
+            if (auto memory = entry.Find("memory")) {
+                result.memory.rss = static_cast<size_t>(memory->At("rss_bytes").AsNumber());
+                result.memory.peakRss = static_cast<size_t>(memory->At("peak_rss_bytes").AsNumber());
+                result.memory.heapInUse = static_cast<size_t>(memory->At("heap_bytes").AsNumber());
+                if (auto allocations = memory->Find("allocations_per_call")) {
+                    result.allocationsPerCall = allocations->AsNumber();
+                    result.allocatedBytesPerCall = memory->At("allocated_bytes_per_call").AsNumber();
+                }
+            }
+            result.latency = HistogramFromJson(entry.At("latency"));
+            report.results.emplace_back(std::move(result));
+        }
+        return report;
+    }
+
+    JsonValue HostMetadata() {
+        JsonValue json;
+        char hostname[256] = {};
+        gethostname(hostname, sizeof(hostname) - 1);
+        json["hostname"] = hostname;
+        struct utsname uts{};
+        if (uname(&uts) == 0) {
+            json["kernel"] = std::string(uts.sysname) + " " + uts.release;
+            json["machine"] = uts.machine;
+        }
+        json["cpu"] = CpuModel();
+        json["logical_cores"] = static_cast<uint64_t>(std::thread::hardware_concurrency());
+
+        auto now = std::time(nullptr);
+        std::tm utc{};
+        gmtime_r(&now, &utc);
+        char timestamp[32];
+        std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+        json["time"] = timestamp;
+        return json;
+    }
+
+    double MannWhitneyGreaterPValue(const LatencyHistogram &current, const LatencyHistogram &baseline) {
+        auto n1 = static_cast<double>(current.Count());
+        auto n2 = static_cast<double>(baseline.Count());
+        if (n1 == 0 || n2 == 0) {
+            return 1;
+        }
+
+        // U counts the pairs in which the current sample is larger, ties count one half
+        double u = 0;
+        double baselineBelow = 0;
+        double tieTerm = 0;
+        for (size_t i = 0; i < LatencyHistogram::BucketCount; ++i) {
+            auto c = static_cast<double>(current.CountAt(i));
+            auto b = static_cast<double>(baseline.CountAt(i));
+            u += c * (baselineBelow + b / 2);
+            baselineBelow += b;
+            auto t = c + b;
+            tieTerm += t * t * t - t;
+        }
+
+        auto n = n1 + n2;
+        auto mean = n1 * n2 / 2;
+        auto variance = n1 * n2 / 12 * ((n + 1) - tieTerm / (n * (n - 1)));
+        if (variance <= 0) {
+            return 1;
+        }
+        // continuity correction towards the null hypothesis
+        auto z = (u - mean - 0.5) / std::sqrt(variance);
+        return 0.5 * std::erfc(z / std::sqrt(2.));
+    }
+
+    size_t CompareResults(const ResultsReport &baseline, const ResultsReport &current, double threshold,
+                          double alpha) {
+        Logging("Comparison with baseline (regression: median +", threshold * 100, "% at p < ", alpha, "):");
+        Logging("  ", std::left, std::setw(56), "point", std::right, std::setw(12), "base p50", std::setw(12),
+                "p50 ms", std::setw(10), "change", std::setw(12), "p-value", "  verdict");
+
+        size_t regressions = 0;
+        for (const auto &result: current.Results()) {
+            auto key = result.Key();
+            auto it = std::find_if(baseline.Results().begin(), baseline.Results().end(),
+                                   [&key](const BenchmarkResult &r) { return r.Key() == key; });
+            if (it == baseline.Results().end()) {
+                Logging("  ", std::left, std::setw(56), key, std::right, "  not in baseline");
+                continue;
+            }
+
+            auto base = static_cast<double>(it->latency.Percentile(50));
+            auto now = static_cast<double>(result.latency.Percentile(50));
+            auto change = base > 0 ? now / base - 1 : 0.;
+            const char *verdict = "unchanged";
+            double p;
+            if (change >= 0) {
+                p = MannWhitneyGreaterPValue(result.latency, it->latency);
+                if (change > threshold && p < alpha) {
+                    verdict = "REGRESSION";
+                    ++regressions;
+                }
+            } else {
+                p = MannWhitneyGreaterPValue(it->latency, result.latency);
+                if (-change > threshold && p < alpha) {
+                    verdict = "improved";
+                }
+            }
+            Logging("  ", std::left, std::setw(56), key, std::right, std::setw(12), base / 1e6, std::setw(12),
+                    now / 1e6, std::setw(9), change * 100, "%", std::setw(12), p, "  ", verdict);
+        }
+        for (const auto &result: baseline.Results()) {
+            auto key = result.Key();
+            if (std::none_of(current.Results().begin(), current.Results().end(),
+                             [&key](const BenchmarkResult &r) { return r.Key() == key; })) {
+                Logging("  ", std::left, std::setw(56), key, std::right, "  not measured in this run");
+            }
+        }
+        Logging(regressions, " regression(s) found");
+        return regressions;
+    }
+}
@@ -0,0 +1,118 @@
+//
+// Created by antares on 4/25/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_RESULTS_H
+#define TESTPROJECT_RESULTS_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "json.h"
+#include "latency_histogram.h"
+#include "memory_stats.h"
+#include "perf_counters.h"
+
+namespace OnnxBenchmarks {
+    /// One measurement point of a scenario
+    struct BenchmarkResult {
+        std::string scenario;
+        /// Configuration of the point, e.g. {"batch", "8"}; together with scenario and metric it
+        /// identifies the point across runs
+        std::vector<std::pair<std::string, std::string>> params;
+        std::string metric = "latency per call";
+        LatencyHistogram latency;
+        /// Inputs per second, 0 when the scenario does not measure it
+        double throughput = 0;
+        /// Achieved half-width of the 95% confidence interval of the mean latency relative to the mean,
+        /// 0 when the scenario does not track it
+        double relativeHalfWidth = 0;
+        /// Taken by ResultsReport::Add, the peak RSS is the one since the previous point
+        MemoryUsage memory{};
+        /// Heap allocations per call, negative when not counted
+        double allocationsPerCall = -1;
+        double allocatedBytesPerCall = -1;
+        /// Hardware counts per call. Unless the scenario sets them, ResultsReport::Add takes them while it
+        /// counts hardware events: the counting windows (the timed calls) since the previous point divided
+        /// by the calls in `latency`. Negative where not counted.
+        HardwareCounts counters{};
+
+        /// The "batch" param, 1 without one
+        [[nodiscard]] size_t BatchSize() const;
+
+        [[nodiscard]] std::string Key() const;
+    };
+
+    /// All results of a run plus metadata (model, ORT, host), written as JSON or CSV.
+    class ResultsReport {
+        JsonValue metadata;
+        std::vector<BenchmarkResult> results;
+        /// Scenario output that is not a latency distribution, e.g. profiles
+        JsonValue details;
+        const PerfCounters *perfCounters = nullptr;
+        HardwareCounts lastCounts;
+        size_t lastWindows = 0;
+
+    public:
+        JsonValue &Metadata() { return metadata; }
+
+        [[nodiscard]] const std::vector<BenchmarkResult> &Results() const { return results; }
+
+        /// Free-form section `key` of the JSON report, not used in comparisons
+        JsonValue &Details(std::string_view key) { return details[key]; }
+
+        /// Records the memory usage of the point and resets the peak RSS for the next one; further metrics
+        /// of the same point share the first one's snapshot.
+        void Add(BenchmarkResult result);
+
+        /// Take hardware counts from `counters` for the points added from now on, nullptr stops
+        void CountHardwareEvents(const PerfCounters *counters);
+
+        /// The histograms are kept as their non-empty buckets, so a saved report can be compared against
+        [[nodiscard]] JsonValue ToJson() const;
+
+        void WriteJson(const std::string &path) const;
+
+        /// One row per result with percentiles in milliseconds; metadata is not included
+        void WriteCsv(const std::string &path) const;
+
+        static ResultsReport LoadJson(const std::string &path);
+    };
+
+    /// Host name, kernel, CPU model, logical core count and the UTC time of the call
+    JsonValue HostMetadata();
+
+    /// One-sided Mann-Whitney U test with tie correction on two latency histograms (samples in the same
+    /// bucket are ties): the p-value of "a sample of `current` tends to be larger than one of `baseline`",
+    /// from the normal approximation.
+    double MannWhitneyGreaterPValue(const LatencyHistogram &current, const LatencyHistogram &baseline);
+
+    /// Match the results of both reports by key and log a comparison table. A point regressed when its
+    /// median latency grew by more than `threshold` (relative) and the growth is significant at `alpha`.
+    /// Returns the number of regressed points.
+    size_t CompareResults(const ResultsReport &baseline, const ResultsReport &current, double threshold,
+                          double alpha);
+}
+
+#endif //TESTPROJECT_RESULTS_H
@@ -0,0 +1,58 @@
+//
+// Created by antares on 4/12/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "session_pool.h"
+#include "cpu_topology.h"
+#include <thread>
+
+namespace OnnxBenchmarks {
+    SessionPool::SessionPool(const std::string &modelPath, size_t sessionCount, const SessionConfig &config,
+                             const DynamicDims &dims, std::shared_ptr<Ort::Env> globalEnv) {
+        if (sessionCount == 0) {
+            throw std::invalid_argument("Session pool needs at least one session");
+        }
+        if (config.useGlobalThreadPools) {
+            if (!globalEnv) {
+                throw std::logic_error("Global thread pools need the Env created in main");
+            }
+            env = std::move(globalEnv);
+        }
+        models.reserve(sessionCount);
+        for (size_t i = 0; i < sessionCount; ++i) {
+            // caller i takes slot i, the intra-op threads of the sessions follow all callers, so that
+            // sessions do not share CPUs while K * M fits the cores
+            auto sessionConfig = config;
+            if (!config.useGlobalThreadPools && sessionConfig.intraOpThreadAffinities.empty()) {
+                size_t threads = config.intraOpThreads > 0 ? static_cast<size_t>(config.intraOpThreads)
+                                                           : std::thread::hardware_concurrency();
+                sessionConfig.intraOpThreadAffinities = GetThreadPlacement().IntraOpAffinities(
+                        threads, sessionCount + i * (threads - 1));
+            }
+            auto &model = models.emplace_back(std::make_unique<OnnxModel>(sessionConfig, env));
+            model->SetDynamicDims(dims);
+            model->Load(modelPath.c_str());
+        }
+    }
+}
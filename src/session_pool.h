@@ -0,0 +1,55 @@
+//
+// Created by antares on 4/12/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_SESSION_POOL_H
+#define TESTPROJECT_SESSION_POOL_H
+
+#include "model_wrapper.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace OnnxBenchmarks {
+    /// K independent sessions of one model. Caller threads are assigned a session by index, so that
+    /// each session only serves a fixed subset of callers and its intra-op threads are not oversubscribed.
+    class SessionPool {
+        std::shared_ptr<Ort::Env> env;
+        std::vector<std::unique_ptr<OnnxModel>> models;
+
+    public:
+        /// With `config.useGlobalThreadPools`, all sessions run on the global pools of `globalEnv`, whose
+        /// size was fixed when it was created (ORT keeps one Env per process, so it must be the one created
+        /// in main) and `config.intraOpThreads` is ignored; otherwise each session gets its own
+        /// `config.intraOpThreads`.
+        SessionPool(const std::string &modelPath, size_t sessionCount, const SessionConfig &config,
+                    const DynamicDims &dims = {}, std::shared_ptr<Ort::Env> globalEnv = nullptr);
+
+        [[nodiscard]] size_t Size() const { return models.size(); }
+
+        OnnxModel &Get(size_t callerIndex) { return *models[callerIndex % models.size()]; }
+    };
+}
+
+#endif //TESTPROJECT_SESSION_POOL_H
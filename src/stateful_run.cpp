@@ -0,0 +1,297 @@
+//
+// Created by antares on 5/14/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "stateful_run.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace OnnxBenchmarks {
+    namespace {
+        const Ort::MemoryInfo &CpuMemoryInfo() {
+            static Ort::MemoryInfo memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+            return memoryInfo;
+        }
+
+        /// `name` against a pattern with at most one '*', what the '*' stands for goes to `capture`
+        bool MatchPattern(const std::string &pattern, const std::string &name, std::string &capture) {
+            auto star = pattern.find('*');
+            if (star == std::string::npos) {
+                capture.clear();
+                return pattern == name;
+            }
+            auto prefixSize = star;
+            auto suffixSize = pattern.size() - star - 1;
+            if (name.size() < prefixSize + suffixSize || name.compare(0, prefixSize, pattern, 0, prefixSize) != 0 ||
+                name.compare(name.size() - suffixSize, suffixSize, pattern, star + 1, suffixSize) != 0) {
+                return false;
+            }
+            capture = name.substr(prefixSize, name.size() - prefixSize - suffixSize);
+            return true;
+        }
+
+        void StoreInteger(ONNXTensorElementDataType type, void *buffer, size_t index, int64_t value,
+                          const std::string &name) {
+            switch (type) {
+                case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64:
+                    static_cast<int64_t *>(buffer)[index] = value;
+                    break;
+                case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32:
+                    static_cast<int32_t *>(buffer)[index] = static_cast<int32_t>(value);
+                    break;
+                default:
+                    throw std::invalid_argument("Input " + name + " should be int32 or int64, not " +
+                                                ElementTypeName(type));
+            }
+        }
+    }
+
+    DecoderLayout::DecoderLayout(const OnnxModel &model, const std::vector<std::string> &stateMap,
+                                 const std::string &tokenInput) {
+        const auto &inNames = model.GetInputNames();
+        const auto &outNames = model.GetOutputNames();
+        const auto &inTypes = model.GetInputTypes();
+        const auto &outTypes = model.GetOutputTypes();
+        const auto &inDims = model.GetInputModelDims();
+        const auto &outDims = model.GetOutputModelDims();
+        const auto &inSymbols = model.GetInputSymbols();
+        const auto &symbols = model.GetDynamicDims().symbols;
+        inputs.resize(inNames.size());
+        stateOutputs.assign(outNames.size(), false);
+
+        for (const auto &entry: stateMap) {
+            auto colon = entry.find(':');
+            if (colon == std::string::npos) {
+                throw std::invalid_argument("State mapping is not OUTPUT:INPUT: " + entry);
+            }
+            auto outPattern = entry.substr(0, colon);
+            auto inPattern = entry.substr(colon + 1);
+            for (size_t o = 0; o < outNames.size(); ++o) {
+                std::string capture;
+                if (stateOutputs[o] || !MatchPattern(outPattern, outNames[o], capture)) {
+                    continue;
+                }
+                auto inName = inPattern;
+                if (auto star = inName.find('*'); star != std::string::npos) {
+                    inName.replace(star, 1, capture);
+                }
+                auto it = std::find(inNames.begin(), inNames.end(), inName);
+                if (it == inNames.end()) {
+                    throw std::invalid_argument("Output " + outNames[o] + " maps to " + inName +
+                                                ", which is not an input");
+                }
+                auto i = static_cast<size_t>(it - inNames.begin());
+                if (inputs[i].role == Role::State) {
+                    throw std::invalid_argument("Input " + inName + " is fed by more than one output");
+                }
+                if (inTypes[i] != outTypes[o] || inDims[i].size() != outDims[o].size()) {
+                    throw std::invalid_argument("Output " + outNames[o] + " does not match the type and rank of " +
+                                                inName);
+                }
+                inputs[i].role = Role::State;
+                inputs[i].stateOutput = o;
+                stateOutputs[o] = true;
+                ++stateCount;
+            }
+        }
+        if (stateCount == 0) {
+            throw std::invalid_argument("No output of the model matches the state mapping");
+        }
+
+        bool tokensFound = false;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            auto &input = inputs[i];
+            const auto &name = inNames[i];
+            input.dims = inDims[i];
+            if (input.role != Role::State) {
+                if (name == tokenInput) {
+                    input.role = Role::Tokens;
+                    tokensFound = true;
+                } else if (name == "attention_mask") {
+                    input.role = Role::AttentionMask;
+                } else if (name == "position_ids") {
+                    input.role = Role::PositionIds;
+                }
+            }
+            if (input.role == Role::Tokens || input.role == Role::AttentionMask || input.role == Role::PositionIds) {
+                if (input.dims.size() != 2 || input.dims[1] > 0) {
+                    throw std::invalid_argument("Input " + name + " should be [batch, length] with a dynamic length");
+                }
+                input.sequenceDim = 1;
+            }
+
+            std::vector<int> unresolved;
+            for (size_t j = 0; j < input.dims.size(); ++j) {
+                if (input.dims[j] > 0 || static_cast<int>(j) == input.sequenceDim) {
+                    continue;
+                }
+                if (j == 0) {
+                    // one sequence per run
+                    input.dims[j] = 1;
+                    continue;
+                }
+                auto symbol = j < inSymbols[i].size() ? inSymbols[i][j] : std::string();
+                auto it = symbols.find(symbol);
+                if (!symbol.empty() && it != symbols.end()) {
+                    input.dims[j] = it->second;
+                } else if (input.role == Role::State) {
+                    unresolved.emplace_back(static_cast<int>(j));
+                } else {
+                    input.dims[j] = 1;
+                }
+            }
+            if (input.role == Role::State) {
+                if (unresolved.size() != 1) {
+                    throw std::invalid_argument("Can not tell the past length dimension of " + name +
+                                                ", set its other dynamic dimensions with --dim");
+                }
+                input.sequenceDim = unresolved.front();
+            }
+
+            if (input.sequenceDim >= 0) {
+                input.dims[static_cast<size_t>(input.sequenceDim)] = -1;
+                input.bytesPerPosition = ElementSize(inTypes[i]);
+                for (auto dim: input.dims) {
+                    input.bytesPerPosition *= dim > 0 ? static_cast<size_t>(dim) : 1;
+                }
+            }
+        }
+        if (!tokensFound) {
+            throw std::invalid_argument("Token input " + tokenInput + " is not an input of the model");
+        }
+    }
+
+    size_t DecoderLayout::StateBytes(size_t length) const {
+        size_t bytes = 0;
+        for (const auto &input: inputs) {
+            if (input.role == Role::State) {
+                bytes += input.bytesPerPosition * length;
+            }
+        }
+        return bytes;
+    }
+
+    StatefulRun::StatefulRun(OnnxModel &inModel, const DecoderLayout &inLayout, size_t inMaxLength,
+                             size_t intRange)
+            : model(inModel), layout(inLayout), maxLength(inMaxLength), binding(inModel.GetSession()) {
+        const auto &inputs = layout.Inputs();
+        const auto &names = model.GetInputNames();
+        const auto &types = model.GetInputTypes();
+        stateBuffers.resize(inputs.size());
+        feedBuffers.resize(inputs.size());
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            const auto &input = inputs[i];
+            auto &feed = feedBuffers[i];
+            switch (input.role) {
+                case DecoderLayout::Role::State:
+                    for (auto &buffer: stateBuffers[i]) {
+                        buffer = TensorBuffer(input.bytesPerPosition * maxLength);
+                    }
+                    break;
+                case DecoderLayout::Role::Tokens:
+                    feed = TensorBuffer(input.bytesPerPosition * maxLength);
+                    FillRandom(types[i], feed.Data(), maxLength, intRange);
+                    break;
+                case DecoderLayout::Role::AttentionMask:
+                case DecoderLayout::Role::PositionIds:
+                    feed = TensorBuffer(input.bytesPerPosition * maxLength);
+                    for (size_t position = 0; position < maxLength; ++position) {
+                        auto value = input.role == DecoderLayout::Role::AttentionMask ? 1
+                                                                                      : static_cast<int64_t>(position);
+                        StoreInteger(types[i], feed.Data(), position, value, names[i]);
+                    }
+                    break;
+                case DecoderLayout::Role::Other: {
+                    // the same zeros on every step, bound once
+                    size_t count = 1;
+                    for (auto dim: input.dims) {
+                        count *= static_cast<size_t>(dim);
+                    }
+                    feed = TensorBuffer(count * ElementSize(types[i]));
+                    std::fill_n(feed.Data(), feed.Size(), std::byte{0});
+                    binding.BindInput(names[i].c_str(),
+                                      Ort::Value::CreateTensor(CpuMemoryInfo(), feed.Data(), feed.Size(),
+                                                               input.dims.data(), input.dims.size(), types[i]));
+                    break;
+                }
+            }
+        }
+        for (size_t o = 0; o < model.GetOutputNums(); ++o) {
+            if (!layout.IsStateOutput(o)) {
+                binding.BindOutput(model.GetOutputNames()[o].c_str(), CpuMemoryInfo());
+            }
+        }
+    }
+
+    void StatefulRun::Step(size_t tokens) {
+        if (length + tokens > maxLength) {
+            throw std::length_error("Sequence of " + std::to_string(length + tokens) + " positions, room for " +
+                                    std::to_string(maxLength));
+        }
+        const auto &inputs = layout.Inputs();
+        const auto &names = model.GetInputNames();
+        const auto &types = model.GetInputTypes();
+        auto total = length + tokens;
+        // the tensors point into the buffers, nothing is copied
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            const auto &input = inputs[i];
+            if (input.role == DecoderLayout::Role::Other) {
+                continue;
+            }
+            auto dims = input.dims;
+            auto sequenceDim = static_cast<size_t>(input.sequenceDim);
+            std::byte *data;
+            size_t positions;
+            switch (input.role) {
+                case DecoderLayout::Role::State:
+                    data = stateBuffers[i][current].Data();
+                    positions = length;
+                    break;
+                case DecoderLayout::Role::AttentionMask:
+                    data = feedBuffers[i].Data();
+                    positions = total;
+                    break;
+                default:
+                    // the new tokens and their positions
+                    data = feedBuffers[i].Data(length * input.bytesPerPosition);
+                    positions = tokens;
+                    break;
+            }
+            dims[sequenceDim] = static_cast<int64_t>(positions);
+            binding.BindInput(names[i].c_str(),
+                              Ort::Value::CreateTensor(CpuMemoryInfo(), data, positions * input.bytesPerPosition,
+                                                       dims.data(), dims.size(), types[i]));
+            if (input.role == DecoderLayout::Role::State) {
+                dims[sequenceDim] = static_cast<int64_t>(total);
+                binding.BindOutput(model.GetOutputNames()[input.stateOutput].c_str(),
+                                   Ort::Value::CreateTensor(CpuMemoryInfo(), stateBuffers[i][1 - current].Data(),
+                                                            total * input.bytesPerPosition, dims.data(),
+                                                            dims.size(), types[i]));
+            }
+        }
+        model.GetSession().Run(runOptions, binding);
+        current = 1 - current;
+        length = total;
+    }
+}
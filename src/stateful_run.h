@@ -0,0 +1,114 @@
+//
+// Created by antares on 5/14/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_STATEFUL_RUN_H
+#define TESTPROJECT_STATEFUL_RUN_H
+
+#include "model_wrapper.h"
+#include "tensor_utils.h"
+#include <array>
+#include <string>
+#include <vector>
+
+namespace OnnxBenchmarks {
+    /// How the inputs of an autoregressive model are fed at every step. Besides the state inputs, fed from
+    /// the outputs of the previous step, it recognises the token input and "attention_mask"/"position_ids"
+    /// (all [batch, length]); other inputs get zeros.
+    class DecoderLayout {
+    public:
+        enum class Role {
+            Tokens, AttentionMask, PositionIds, State, Other
+        };
+
+        struct Input {
+            Role role = Role::Other;
+            /// Model dims for one sequence (batch 1), the dimension growing with the sequence left at -1
+            std::vector<int64_t> dims;
+            /// The dimension growing with the sequence: 1 for tokens, mask and positions, the past length of
+            /// a state input, -1 for other inputs
+            int sequenceDim = -1;
+            /// Output feeding a state input
+            size_t stateOutput = 0;
+            /// Bytes per position along sequenceDim
+            size_t bytesPerPosition = 0;
+        };
+
+    private:
+        std::vector<Input> inputs;
+        std::vector<bool> stateOutputs;
+        size_t stateCount = 0;
+
+    public:
+        /// `stateMap` entries are "OUTPUT:INPUT" name patterns with at most one '*', e.g.
+        /// "present.*:past_key_values.*". The past length is the one dynamic dimension (besides the batch) of
+        /// a state input not set by --dim. Throws std::invalid_argument when the model does not fit.
+        DecoderLayout(const OnnxModel &model, const std::vector<std::string> &stateMap,
+                      const std::string &tokenInput);
+
+        [[nodiscard]] const std::vector<Input> &Inputs() const { return inputs; }
+
+        /// The output is fed back into a state input
+        [[nodiscard]] bool IsStateOutput(size_t index) const { return stateOutputs[index]; }
+
+        [[nodiscard]] size_t StateCount() const { return stateCount; }
+
+        /// Bytes of one sequence's state at `length` positions
+        [[nodiscard]] size_t StateBytes(size_t length) const;
+    };
+
+    /// One sequence generated step by step on a shared session. Every state input has two buffers sized for
+    /// `maxLength` positions: one holds the past fed in, ORT writes the present into the other, and the two
+    /// swap roles for the next step, so the state is never copied. Token ids, mask and positions are laid out
+    /// once for the whole sequence and every step points into them. Outputs that are not state (e.g. logits)
+    /// are allocated by ORT.
+    class StatefulRun {
+        OnnxModel &model;
+        const DecoderLayout &layout;
+        size_t maxLength;
+        size_t length = 0;
+        /// Which of the two state buffers holds the past
+        size_t current = 0;
+        std::vector<std::array<TensorBuffer, 2>> stateBuffers;
+        /// Buffers of the other inputs, by input index
+        std::vector<TensorBuffer> feedBuffers;
+        Ort::IoBinding binding;
+        Ort::RunOptions runOptions{nullptr};
+
+    public:
+        /// Token ids are drawn from [0, intRange)
+        StatefulRun(OnnxModel &inModel, const DecoderLayout &inLayout, size_t inMaxLength, size_t intRange);
+
+        /// Start a new sequence; the buffers are kept
+        void Reset() { length = 0; }
+
+        /// Run `tokens` new positions (the prompt on the first step, then 1 per generated token) and keep the
+        /// state. Throws std::length_error beyond maxLength.
+        void Step(size_t tokens);
+
+        [[nodiscard]] size_t Length() const { return length; }
+    };
+}
+
+#endif //TESTPROJECT_STATEFUL_RUN_H
@@ -0,0 +1,273 @@
+//
+// Created by antares on 4/18/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "tensor_utils.h"
+#include "benchmarks.h"
+#include "model_wrapper.h"
+#include "lockfree-threadpool/src/MemoryPool/src/MemoryPool.h"
+#include <cstring>
+#include <utility>
+
+namespace OnnxBenchmarks {
+    size_t ElementSize(ONNXTensorElementDataType type) {
+        switch (type) {
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT:
+                return sizeof(float);
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8:
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8:
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_BOOL:
+                return 1;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT16:
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT16:
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16:
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_BFLOAT16:
+                return 2;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32:
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT32:
+                return 4;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64:
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT64:
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE:
+                return 8;
+            default:
+                throw std::invalid_argument(std::string("Unsupported tensor element type: ") + ElementTypeName(type));
+        }
+    }
+
+    const char *ElementTypeName(ONNXTensorElementDataType type) {
+        switch (type) {
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT:
+                return "float";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8:
+                return "uint8";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8:
+                return "int8";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT16:
+                return "uint16";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT16:
+                return "int16";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32:
+                return "int32";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64:
+                return "int64";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_STRING:
+                return "string";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_BOOL:
+                return "bool";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16:
+                return "float16";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE:
+                return "double";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT32:
+                return "uint32";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT64:
+                return "uint64";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_BFLOAT16:
+                return "bfloat16";
+            default:
+                return "unknown";
+        }
+    }
+
+    const char *NpyDescr(ONNXTensorElementDataType type) {
+        switch (type) {
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT:
+                return "<f4";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8:
+                return "|u1";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8:
+                return "|i1";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT16:
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_BFLOAT16:
+                return "<u2";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT16:
+                return "<i2";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32:
+                return "<i4";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64:
+                return "<i8";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_BOOL:
+                return "|b1";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16:
+                return "<f2";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE:
+                return "<f8";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT32:
+                return "<u4";
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT64:
+                return "<u8";
+            default:
+                return nullptr;
+        }
+    }
+
+    uint16_t FloatToHalf(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        uint32_t sign = (bits >> 16) & 0x8000u;
+        uint32_t exponent = (bits >> 23) & 0xffu;
+        uint32_t mantissa = bits & 0x7fffffu;
+
+        if (exponent == 0xffu) {
+            // inf / nan
+            return static_cast<uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+        }
+        int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+        if (halfExponent >= 0x1f) {
+            return static_cast<uint16_t>(sign | 0x7c00u);
+        }
+        if (halfExponent <= 0) {
+            if (halfExponent < -10) {
+                return static_cast<uint16_t>(sign);
+            }
+            // subnormal
+            mantissa |= 0x800000u;
+            auto shift = static_cast<uint32_t>(14 - halfExponent);
+            uint32_t half = mantissa >> shift;
+            uint32_t rest = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            if (rest > halfway || (rest == halfway && (half & 1u))) {
+                ++half;
+            }
+            return static_cast<uint16_t>(sign | half);
+        }
+        uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+        uint32_t rest = mantissa & 0x1fffu;
+        if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) {
+            ++half; // may carry into the exponent, which is still correct
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint16_t FloatToBFloat16(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        if ((bits & 0x7fffffffu) > 0x7f800000u) {
+            return static_cast<uint16_t>((bits >> 16) | 0x40u);
+        }
+        bits += 0x7fffu + ((bits >> 16) & 1u);
+        return static_cast<uint16_t>(bits >> 16);
+    }
+
+    namespace {
+        template<typename T>
+        void FillIntegers(void *buffer, size_t count, size_t range, int64_t offset = 0) {
+            auto data = static_cast<T *>(buffer);
+            for (size_t i = 0; i < count; i++) {
+                data[i] = static_cast<T>(static_cast<int64_t>(RandomNumber(range)) + offset);
+            }
+        }
+    }
+
+    void FillRandom(ONNXTensorElementDataType type, void *buffer, size_t count, size_t intRange) {
+        auto randomFloat = [] { return RandomNumber<float>(10000) / 5000.f - 1.f; };
+        switch (type) {
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT: {
+                auto data = static_cast<float *>(buffer);
+                for (size_t i = 0; i < count; i++) data[i] = randomFloat();
+                break;
+            }
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE: {
+                auto data = static_cast<double *>(buffer);
+                for (size_t i = 0; i < count; i++) data[i] = randomFloat();
+                break;
+            }
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16: {
+                auto data = static_cast<uint16_t *>(buffer);
+                for (size_t i = 0; i < count; i++) data[i] = FloatToHalf(randomFloat());
+                break;
+            }
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_BFLOAT16: {
+                auto data = static_cast<uint16_t *>(buffer);
+                for (size_t i = 0; i < count; i++) data[i] = FloatToBFloat16(randomFloat());
+                break;
+            }
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_BOOL:
+                FillIntegers<uint8_t>(buffer, count, 2);
+                break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8:
+                FillIntegers<int8_t>(buffer, count, 256, -128);
+                break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8:
+                FillIntegers<uint8_t>(buffer, count, std::min<size_t>(intRange, 256));
+                break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT16:
+                FillIntegers<int16_t>(buffer, count, std::min<size_t>(intRange, 32768));
+                break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT16:
+                FillIntegers<uint16_t>(buffer, count, std::min<size_t>(intRange, 65536));
+                break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32:
+                FillIntegers<int32_t>(buffer, count, intRange);
+                break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT32:
+                FillIntegers<uint32_t>(buffer, count, intRange);
+                break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64:
+                FillIntegers<int64_t>(buffer, count, intRange);
+                break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT64:
+                FillIntegers<uint64_t>(buffer, count, intRange);
+                break;
+            default:
+                throw std::invalid_argument(std::string("Unsupported tensor element type: ") + ElementTypeName(type));
+        }
+    }
+
+    void FillRandomInput(const OnnxModel &model, void *buffer, size_t batch, size_t intRange) {
+        auto data = static_cast<std::byte *>(buffer);
+        for (size_t i = 0; i < model.GetInputNums(); ++i) {
+            auto type = model.GetInputTypes()[i];
+            auto count = model.GetInputElementCounts()[i] * batch;
+            FillRandom(type, data, count, intRange);
+            data += model.GetInputBufferStrides()[i] * batch;
+        }
+    }
+
+    TensorBuffer::TensorBuffer(size_t inBytes) : bytes(inBytes) {
+        if (bytes > 0) {
+            data = Antares::MemoryPool::NewArray<uint64_t>((bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        }
+    }
+
+    TensorBuffer::TensorBuffer(TensorBuffer &&other) noexcept
+            : data(std::exchange(other.data, nullptr)), bytes(std::exchange(other.bytes, 0)) {}
+
+    TensorBuffer &TensorBuffer::operator=(TensorBuffer &&other) noexcept {
+        if (this != &other) {
+            this->~TensorBuffer();
+            data = std::exchange(other.data, nullptr);
+            bytes = std::exchange(other.bytes, 0);
+        }
+        return *this;
+    }
+
+    TensorBuffer::~TensorBuffer() {
+        if (data) {
+            Antares::MemoryPool::DeleteArray(data, (bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+            data = nullptr;
+        }
+    }
+}
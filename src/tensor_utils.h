@@ -0,0 +1,91 @@
+//
+// Created by antares on 4/18/23.
+// MIT License
+//
+// Copyright (c) 2023 Antares
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef TESTPROJECT_TENSOR_UTILS_H
+#define TESTPROJECT_TENSOR_UTILS_H
+
+#include "onnxruntime/onnxruntime_cxx_api.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace OnnxBenchmarks {
+    class OnnxModel;
+
+    /// Bytes of one element, throws std::invalid_argument for types we can not put in a flat buffer (e.g. string)
+    size_t ElementSize(ONNXTensorElementDataType type);
+
+    const char *ElementTypeName(ONNXTensorElementDataType type);
+
+    /// numpy's dtype descr of the type as written in .npy headers (e.g. "<f4"), nullptr for types numpy lacks;
+    /// bfloat16 is stored as its bits, "<u2"
+    const char *NpyDescr(ONNXTensorElementDataType type);
+
+    /// IEEE 754 binary16 bits of `value`, round to nearest even
+    uint16_t FloatToHalf(float value);
+
+    /// bfloat16 bits of `value`, round to nearest even
+    uint16_t FloatToBFloat16(float value);
+
+    /// Fill `count` elements of `type` with random values: floats in [-1, 1), integers in [0, intRange)
+    /// (signed 8-bit types in [-128, 128)), booleans 0/1.
+    void FillRandom(ONNXTensorElementDataType type, void *buffer, size_t count, size_t intRange = 100);
+
+    /// Fill a whole input buffer of `batch` items in the model's layout, each input with its own type
+    void FillRandomInput(const OnnxModel &model, void *buffer, size_t batch, size_t intRange = 100);
+
+    /// Tensors laid out one after another in a buffer each start on a multiple of this many bytes
+    constexpr size_t TensorAlignment = 64;
+
+    /// `bytes` rounded up to TensorAlignment, the space a tensor takes in a buffer layout
+    constexpr size_t AlignTensorBytes(size_t bytes) {
+        return (bytes + TensorAlignment - 1) / TensorAlignment * TensorAlignment;
+    }
+
+    /// A heap buffer for tensor data, aligned for every element type. With the padded layout of OnnxModel
+    /// (see GetInputBufferStrides) every tensor in it is aligned as well.
+    class TensorBuffer {
+        uint64_t *data = nullptr;
+        size_t bytes = 0;
+
+    public:
+        TensorBuffer() = default;
+
+        explicit TensorBuffer(size_t inBytes);
+
+        TensorBuffer(TensorBuffer &&other) noexcept;
+
+        TensorBuffer &operator=(TensorBuffer &&other) noexcept;
+
+        ~TensorBuffer();
+
+        [[nodiscard]] std::byte *Data() const { return reinterpret_cast<std::byte *>(data); }
+
+        [[nodiscard]] std::byte *Data(size_t offset) const { return Data() + offset; }
+
+        [[nodiscard]] size_t Size() const { return bytes; }
+    };
+}
+
+#endif //TESTPROJECT_TENSOR_UTILS_H